@@ -3,20 +3,17 @@
 import pyminst
 import matplotlib.pyplot as plt
 import numpy as np
-import struct
 
 class MyCallback(pyminst.Callback):
     def __init__(self):
         super().__init__()
         self.labels = [ 'T-shirt', 'Trouser', 'Pullover', 'Dress', 'Coat', 'Sandal', 'Shirt', 'Sneaker', 'Bag', 'Ankle Boot' ]
 
-    def eval(self, sample: bytes, label: bytes):
-        label_idx = struct.unpack('B', label)[0]
-        label_str = self.labels[label_idx]
+    def eval(self, samples: np.ndarray, labels: np.ndarray):
+        label_str = self.labels[labels[0]]
 
-        s = np.frombuffer(sample, dtype=np.uint8).reshape(28, 28)
         plt.title(label_str)
-        plt.imshow(s)
+        plt.imshow(samples[0])
         plt.show()
 
         pass
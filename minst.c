@@ -1,7 +1,41 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define MINST_HAVE_MMAP 1
+#define MINST_HAVE_THREADS 1
+#define MINST_HAVE_CLOCK_GETTIME 1
+#endif
+
+#if defined(__linux__) || defined(__FreeBSD__)
+#define MINST_HAVE_FALLOCATE 1
+#endif
+
 #include "minst.h"
+#include "minst_kernels.h"
 
+#include <math.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MINST_HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef MINST_HAVE_THREADS
+#include <pthread.h>
+#endif
+
+#ifdef MINST_HAVE_ZLIB
+#include <zlib.h>
+
+/* The size of the buffer used to inflate gzip compressed files, which is large enough to read in big blocks. */
+#define MINST_GZ_BUFFER_SIZE (1024u * 1024u)
+#endif
 
 const struct minst_format minst_fashion_train_sample_format = { MINST_TYPE_U8, 3, { 60000, 28, 28, 1 } };
 
@@ -37,6 +71,16 @@ minst_strerror(const enum minst_error err)
       return "sampler function error";
     case MINST_ERR_SEEK:
       return "failed to seek file location";
+    case MINST_ERR_MAP:
+      return "failed to map file into memory";
+    case MINST_ERR_INVALID_ARGUMENT:
+      return "invalid argument";
+    case MINST_ERR_THREAD:
+      return "failed to create thread";
+    case MINST_ERR_WRITE:
+      return "failed to write file";
+    case MINST_ERR_LABEL_RANGE:
+      return "label out of range";
   }
 
   return "unknown error";
@@ -50,16 +94,8 @@ struct magic
 };
 
 static enum minst_error
-minst_read_magic(FILE* file, struct magic* m)
+minst_read_magic(const uint8_t* data, struct magic* m)
 {
-  uint8_t data[4];
-  unsigned long read_size;
-
-  read_size = fread(data, sizeof(data), 1, file);
-  if (read_size != 1) {
-    return MINST_ERR_MISSING_DATA;
-  }
-
   switch (data[2]) {
     case 0x08:
       m->type = MINST_TYPE_U8;
@@ -88,16 +124,22 @@ minst_read_magic(FILE* file, struct magic* m)
   return MINST_ERR_NONE;
 }
 
+/* Checks a header that is already in memory. This is shared by the standard I/O path, which reads the header into a
+ * buffer first, and the memory mapped path, which checks the header in place. */
 static enum minst_error
-minst_check_format(FILE* file, const struct minst_format* format)
+minst_check_header(const uint8_t* header, const size_t header_size, const struct minst_format* format)
 {
   struct magic m;
   enum minst_error err;
   uint32_t dim_size;
   uint32_t dim_idx;
-  uint8_t read_buf[4];
+  const uint8_t* read_buf;
+
+  if (header_size < 4) {
+    return MINST_ERR_MISSING_DATA;
+  }
 
-  err = minst_read_magic(file, &m);
+  err = minst_read_magic(header, &m);
   if (err != MINST_ERR_NONE) {
     return err;
   }
@@ -107,15 +149,16 @@ minst_check_format(FILE* file, const struct minst_format* format)
   }
 
   if (m.rank != format->rank) {
-    printf("HERE (line=%d)\n", __LINE__);
     return MINST_ERR_SHAPE;
   }
 
+  if (header_size < 4 + ((size_t)m.rank) * 4) {
+    return MINST_ERR_MISSING_DATA;
+  }
+
   for (dim_idx = 0; dim_idx < m.rank; dim_idx++) {
 
-    if (fread(&read_buf[0], sizeof(read_buf), 1, file) != 1) {
-      return MINST_ERR_TYPE;
-    }
+    read_buf = header + 4 + dim_idx * 4;
 
     dim_size = 0;
 
@@ -125,7 +168,6 @@ minst_check_format(FILE* file, const struct minst_format* format)
     dim_size |= ((uint32_t)read_buf[3]);
 
     if (format->shape[dim_idx] != dim_size) {
-      printf("HERE (line=%d) (shape=%d)\n", __LINE__, dim_size);
       return MINST_ERR_SHAPE;
     }
   }
@@ -133,6 +175,25 @@ minst_check_format(FILE* file, const struct minst_format* format)
   return MINST_ERR_NONE;
 }
 
+static enum minst_error
+minst_check_format(FILE* file, const struct minst_format* format)
+{
+  uint8_t header[4 + 255 * 4];
+  size_t header_size;
+
+  if (fread(header, 4, 1, file) != 1) {
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  header_size = 4;
+
+  if (header[3] > 0) {
+    header_size += fread(header + 4, 4, header[3], file) * 4;
+  }
+
+  return minst_check_header(header, header_size, format);
+}
+
 static uint32_t
 minst_type_size(enum minst_type type)
 {
@@ -172,199 +233,6077 @@ minst_element_offset(const struct minst_format* format, const uint32_t element_i
   return offset;
 }
 
-struct default_sampler
+static uint32_t
+minst_read_u32_be(const uint8_t* data)
 {
-  uint32_t* indices;
+  return (((uint32_t)data[0]) << 24u) | (((uint32_t)data[1]) << 16u) | (((uint32_t)data[2]) << 8u) |
+         ((uint32_t)data[3]);
+}
 
-  uint32_t idx;
-};
+enum minst_error
+minst_read_format(const char* path, struct minst_format* format)
+{
+  uint8_t header[4 + 255 * 4];
+  size_t header_size;
+  struct magic m;
+  enum minst_error err;
+  uint32_t dim_idx;
+#ifdef MINST_HAVE_ZLIB
+  gzFile file;
+  int read_size;
+
+  /* zlib reads files that are not compressed as they are */
+  file = gzopen(path, "rb");
+  if (file == NULL) {
+    return MINST_ERR_OPEN_SAMPLES;
+  }
+
+  header_size = (gzread(file, header, 4) == 4) ? 4 : 0;
+
+  if ((header_size == 4) && (header[3] > 0)) {
+    read_size = gzread(file, header + 4, 4u * header[3]);
+    if (read_size > 0) {
+      header_size += (size_t)read_size;
+    }
+  }
+
+  gzclose(file);
+#else
+  FILE* file;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return MINST_ERR_OPEN_SAMPLES;
+  }
+
+  header_size = (fread(header, 4, 1, file) == 1) ? 4 : 0;
+
+  if ((header_size == 4) && (header[3] > 0)) {
+    header_size += fread(header + 4, 4, header[3], file) * 4;
+  }
+
+  fclose(file);
+#endif
+
+  if (header_size < 4) {
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  err = minst_read_magic(header, &m);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  if ((m.rank == 0) || (m.rank > MINST_MAX_RANK)) {
+    return MINST_ERR_SHAPE;
+  }
+
+  if (header_size < 4 + ((size_t)m.rank) * 4) {
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  format->type = m.type;
+  format->rank = m.rank;
+
+  for (dim_idx = 0; dim_idx < MINST_MAX_RANK; dim_idx++) {
+    format->shape[dim_idx] = (dim_idx < m.rank) ? minst_read_u32_be(header + 4 + dim_idx * 4) : 1;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* The multiplier of the PCG32 generator, 6364136223846793005, built from two halves to stay within C89. */
+#define MINST_RNG_MULTIPLIER ((((uint64_t)0x5851F42Du) << 32) | ((uint64_t)0x4C957F2Du))
+
+void
+minst_rng_seed(struct minst_rng* rng, const uint64_t seed, const uint64_t stream)
+{
+  rng->state = 0;
+  rng->inc = (stream << 1) | 1u;
+  minst_rng_next(rng);
+  rng->state += seed;
+  minst_rng_next(rng);
+}
+
+uint32_t
+minst_rng_next(struct minst_rng* rng)
+{
+  uint64_t old_state;
+  uint32_t xorshifted;
+  uint32_t rot;
+
+  old_state = rng->state;
+
+  rng->state = old_state * MINST_RNG_MULTIPLIER + rng->inc;
+
+  xorshifted = (uint32_t)(((old_state >> 18) ^ old_state) >> 27);
+
+  rot = (uint32_t)(old_state >> 59);
+
+  return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+}
+
+uint32_t
+minst_rng_bounded(struct minst_rng* rng, const uint32_t bound)
+{
+  uint64_t m;
+  uint32_t threshold;
+
+  /* Lemire's multiply-shift method, which only divides in the rare case that the result would be biased */
+  m = ((uint64_t)minst_rng_next(rng)) * bound;
+
+  if (((uint32_t)m) < bound) {
+
+    threshold = (0u - bound) % bound;
+
+    while (((uint32_t)m) < threshold) {
+      m = ((uint64_t)minst_rng_next(rng)) * bound;
+    }
+  }
+
+  return (uint32_t)(m >> 32);
+}
 
 static uint32_t
-minst_rand(uint32_t min_v, uint32_t max_v)
+minst_mix32(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return x;
+}
+
+void
+minst_permutation_init(struct minst_permutation* perm,
+                       const uint32_t num_elements,
+                       const uint64_t seed,
+                       const uint64_t epoch)
+{
+  struct minst_rng rng;
+  uint32_t i;
+
+  perm->num_elements = num_elements;
+
+  /* the smallest domain of 2^(2 * half_bits) elements that holds all of the indices */
+  perm->half_bits = 0;
+
+  while ((perm->half_bits < 16) && ((((uint64_t)1) << (2 * perm->half_bits)) < num_elements)) {
+    perm->half_bits++;
+  }
+
+  minst_rng_seed(&rng, seed, epoch);
+
+  for (i = 0; i < 4; i++) {
+    perm->keys[i] = minst_rng_next(&rng);
+  }
+}
+
+uint32_t
+minst_permute(const struct minst_permutation* perm, const uint32_t idx)
 {
-  return (((uint32_t)rand()) % (max_v - min_v)) + min_v;
+  uint32_t mask;
+  uint32_t left;
+  uint32_t right;
+  uint32_t tmp;
+  uint32_t i;
+
+  if (perm->half_bits == 0) {
+    return idx;
+  }
+
+  mask = (((uint32_t)1) << perm->half_bits) - 1;
+
+  left = idx >> perm->half_bits;
+  right = idx & mask;
+
+  /* A balanced Feistel network is a bijection on the power of two domain. Results outside of [0, num_elements) are fed
+   * back in (cycle walking) until one lands inside, which keeps it a bijection on the smaller range. The domain is less
+   * than four times the number of elements, so this takes less than four passes on average. */
+  for (;;) {
+
+    for (i = 0; i < 4; i++) {
+      tmp = right;
+      right = left ^ (minst_mix32(right ^ perm->keys[i]) & mask);
+      left = tmp;
+    }
+
+    tmp = (left << perm->half_bits) | right;
+
+    if (tmp < perm->num_elements) {
+      return tmp;
+    }
+  }
 }
 
+struct default_sampler
+{
+  enum minst_shuffle_mode mode;
+
+  uint64_t seed;
+
+  uint64_t epoch;
+
+  /* Only used in table mode. */
+  uint32_t* indices;
+
+  /* Only used in counter mode. */
+  struct minst_permutation perm;
+
+  uint32_t num_elements;
+
+  uint32_t idx;
+
+  int ready;
+};
+
 static int
-minst_default_sampler(void* sampler_data, const uint32_t num_elements, uint32_t* element_idx)
+minst_default_sampler_prepare(struct default_sampler* data, const uint32_t num_elements)
 {
-  struct default_sampler* data;
+  struct minst_rng rng;
   uint32_t i;
   uint32_t j;
   uint32_t tmp;
 
-  data = sampler_data;
+  data->num_elements = num_elements;
+  data->idx = 0;
 
-  if (!data->indices) {
+  if (data->mode == MINST_SHUFFLE_COUNTER) {
+    minst_permutation_init(&data->perm, num_elements, data->seed, data->epoch);
+    return 0;
+  }
 
+  if (!data->indices) {
     data->indices = malloc(num_elements * sizeof(uint32_t));
     if (data->indices == NULL) {
       return -1;
     }
+  }
 
-    for (i = 0; i < num_elements; i++) {
-      data->indices[i] = i;
-    }
-
-    for (i = 1; i < num_elements; i++) {
-      j = minst_rand(0, i);
-      tmp = data->indices[i];
-      data->indices[i] = data->indices[j];
-      data->indices[j] = tmp;
-    }
+  /* starting from the identity makes each epoch depend only on the seed and the epoch number */
+  for (i = 0; i < num_elements; i++) {
+    data->indices[i] = i;
   }
 
-  *element_idx = data->indices[data->idx];
+  minst_rng_seed(&rng, data->seed, data->epoch);
+
+  for (i = num_elements; i > 1; i--) {
+    j = minst_rng_bounded(&rng, i);
+    tmp = data->indices[i - 1];
+    data->indices[i - 1] = data->indices[j];
+    data->indices[j] = tmp;
+  }
 
   return 0;
 }
 
-static enum minst_error
-minst_eval_impl(FILE* samples_file,
-                FILE* labels_file,
-                const struct minst_format* sample_format,
-                const struct minst_format* label_format,
-                const uint32_t batch_size,
-                void* callback_data,
-                const minst_callback callback,
-                void* sampler_data,
-                const minst_sampler sampler)
+static int
+minst_default_sampler(void* sampler_data, const uint32_t num_elements, const uint32_t count, uint32_t* element_indices)
 {
-  enum minst_error error;
-  uint32_t num_samples;
-  uint32_t iteration;
-  uint8_t* sample_buffer;
-  uint8_t* label_buffer;
-  uint32_t batch_idx;
-  uint32_t element_idx;
-  long int sample_offset;
-  long int label_offset;
-  uint32_t sample_size;
-  uint32_t label_size;
+  struct default_sampler* data;
+  uint32_t i;
+
+  data = sampler_data;
 
-  error = minst_check_format(samples_file, sample_format);
-  if (error != MINST_ERR_NONE) {
-    return error;
+  if (num_elements == 0) {
+    return -1;
   }
 
-  error = minst_check_format(labels_file, label_format);
-  if (error != MINST_ERR_NONE) {
-    return error;
+  if (!data->ready) {
+
+    if (minst_default_sampler_prepare(data, num_elements) != 0) {
+      return -1;
+    }
+
+    data->ready = 1;
   }
 
-  num_samples = sample_format->shape[0];
+  for (i = 0; i < count; i++) {
 
-  sample_size = minst_element_size(sample_format);
+    /* the last batch of an epoch may run past the end of the permutation */
+    if (data->idx >= data->num_elements) {
+      data->idx = 0;
+    }
 
-  label_size = minst_element_size(label_format);
+    if (data->mode == MINST_SHUFFLE_COUNTER) {
+      element_indices[i] = minst_permute(&data->perm, data->idx);
+    } else {
+      element_indices[i] = data->indices[data->idx];
+    }
 
-  sample_buffer = malloc(batch_size * sample_size);
-  if (sample_buffer == NULL) {
-    return MINST_ERR_OUT_OF_MEMORY;
+    data->idx++;
   }
 
-  label_buffer = malloc(batch_size * label_size);
-  if (label_buffer == NULL) {
-    free(sample_buffer);
-    return MINST_ERR_OUT_OF_MEMORY;
+  return 0;
+}
+
+static void
+minst_default_sampler_next_epoch(struct default_sampler* data)
+{
+  data->epoch++;
+
+  /* the permutation is set up on first use, after that the table (if any) is reused */
+  if (data->ready) {
+    minst_default_sampler_prepare(data, data->num_elements);
   }
+}
 
-  for (iteration = 0; iteration < num_samples; iteration += batch_size) {
+struct sequential_sampler
+{
+  uint32_t idx;
+};
 
-    for (batch_idx = 0; batch_idx < batch_size; batch_idx++) {
+static int
+minst_sequential_sampler(void* sampler_data,
+                         const uint32_t num_elements,
+                         const uint32_t count,
+                         uint32_t* element_indices)
+{
+  struct sequential_sampler* data;
+  uint32_t i;
 
-      if (sampler(sampler_data, num_samples, &element_idx) != 0) {
-        free(sample_buffer);
-        free(label_buffer);
-        return MINST_ERR_SAMPLER;
-      }
+  data = sampler_data;
 
-      sample_offset = minst_element_offset(sample_format, element_idx);
+  if (num_elements == 0) {
+    return -1;
+  }
 
-      if (fseek(samples_file, sample_offset, SEEK_SET) != 0) {
-        free(sample_buffer);
-        free(label_buffer);
-        return MINST_ERR_SEEK;
-      }
+  for (i = 0; i < count; i++) {
 
-      label_offset = minst_element_offset(label_format, element_idx);
+    if (data->idx >= num_elements) {
+      data->idx = 0;
+    }
 
-      if (fseek(labels_file, label_offset, SEEK_SET) != 0) {
-        free(sample_buffer);
-        free(label_buffer);
-        return MINST_ERR_SEEK;
-      }
+    element_indices[i] = data->idx;
 
-      if (fread(sample_buffer + sample_size * batch_idx, sample_size, 1, samples_file) != 1) {
-        free(sample_buffer);
-        free(label_buffer);
-        return MINST_ERR_MISSING_DATA;
-      }
+    data->idx++;
+  }
 
-      if (fread(label_buffer + label_size * batch_idx, label_size, 1, labels_file) != 1) {
-        free(sample_buffer);
-        free(label_buffer);
-        return MINST_ERR_MISSING_DATA;
-      }
-    }
+  return 0;
+}
+
+/* Adapts a sampler that picks one element per call to the batch sampler interface. */
+struct element_sampler
+{
+  void* sampler_data;
+
+  minst_sampler sampler;
+};
+
+static int
+minst_element_sampler(void* sampler_data, const uint32_t num_elements, const uint32_t count, uint32_t* element_indices)
+{
+  struct element_sampler* data;
+  uint32_t i;
+
+  data = sampler_data;
 
-    if (callback(callback_data, sample_buffer, label_buffer) != 0) {
-      free(sample_buffer);
-      free(label_buffer);
-      return MINST_ERR_CALLBACK;
+  for (i = 0; i < count; i++) {
+    if (data->sampler(data->sampler_data, num_elements, &element_indices[i]) != 0) {
+      return -1;
     }
   }
 
-  free(sample_buffer);
-  free(label_buffer);
-  return MINST_ERR_NONE;
+  return 0;
 }
 
-enum minst_error
-minst_eval(const char* samples_path,
-           const char* labels_path,
-           const struct minst_format* sample_format,
-           const struct minst_format* label_format,
-           const uint32_t batch_size,
-           void* callback_data,
-           const minst_callback callback,
-           void* sampler_data,
-           minst_sampler sampler)
+/* The range of the global element order that belongs to one shard. Local indices chosen by the sampler are mapped to
+ * elements by taking the position offset + idx of the global order, which wraps around for padded shards. */
+struct shard
 {
-  FILE* samples_file;
-  FILE* labels_file;
-  enum minst_error err;
-  struct default_sampler def_sampler;
+  uint32_t offset;
 
-  def_sampler.idx = 0;
-  def_sampler.indices = NULL;
+  uint32_t size;
 
-  if (!sampler) {
-    sampler_data = &def_sampler;
-    sampler = minst_default_sampler;
-  }
+  /* whether the global order is a permutation or the order of the file */
+  int shuffle;
 
-  samples_file = fopen(samples_path, "rb");
-  if (samples_file == NULL) {
-    return MINST_ERR_OPEN_SAMPLES;
+  uint64_t seed;
+
+  uint64_t epoch;
+
+  struct minst_permutation perm;
+};
+
+static void
+minst_shard_init(struct shard* sh,
+                 const uint32_t num_elements,
+                 const uint32_t world_size,
+                 const uint32_t rank,
+                 const enum minst_shard_mode mode)
+{
+  if (mode == MINST_SHARD_DROP) {
+    sh->size = num_elements / world_size;
+  } else {
+    sh->size = (num_elements / world_size) + (((num_elements % world_size) != 0) ? 1 : 0);
   }
 
-  labels_file = fopen(labels_path, "rb");
-  if (labels_file == NULL) {
-    fclose(samples_file);
-    return MINST_ERR_OPEN_LABELS;
+  sh->offset = sh->size * rank;
+}
+
+static void
+minst_shard_map(const struct shard* sh, const uint32_t num_elements, const uint32_t count, uint32_t* indices)
+{
+  uint32_t i;
+  uint32_t pos;
+
+  for (i = 0; i < count; i++) {
+
+    pos = (uint32_t)((((uint64_t)sh->offset) + indices[i]) % num_elements);
+
+    indices[i] = sh->shuffle ? minst_permute(&sh->perm, pos) : pos;
   }
+}
+
+/* An opened dataset file. In memory mapped mode the whole file is mapped once and elements are served from the mapping,
+ * otherwise they are read from the file with standard I/O. Gzip compressed files are either inflated into memory once,
+ * or streamed when the file is only read from start to end. */
+struct source
+{
+  FILE* file;
+
+#ifdef MINST_HAVE_ZLIB
+  gzFile gz;
+#endif
+
+  const uint8_t* data;
 
-  err = minst_eval_impl(
-    samples_file, labels_file, sample_format, label_format, batch_size, callback_data, callback, sampler_data, sampler);
+  size_t size;
 
-  /* cleanup */
+  /* whether the data was read into memory, rather than mapped */
+  int preloaded;
 
-  free(def_sampler.indices);
+  /* the offset of the first element, which follows the header */
+  long int payload_offset;
+};
+
+/* Allocates memory aligned to a power of two that is at least the size of a pointer. The memory must be released with
+ * @ref minst_aligned_free. */
+static void*
+minst_aligned_alloc_ex(const size_t size, const size_t alignment)
+{
+#ifdef MINST_HAVE_MMAP
+  void* ptr;
+
+  if (posix_memalign(&ptr, alignment, (size > 0) ? size : 1) != 0) {
+    return NULL;
+  }
+
+  return ptr;
+#else
+  (void)alignment;
+  return malloc(size);
+#endif
+}
 
-  fclose(labels_file);
+/* Allocates memory aligned to @ref MINST_ALIGNMENT bytes. The memory must be released with @ref minst_aligned_free. */
+static void*
+minst_aligned_alloc(const size_t size)
+{
+  return minst_aligned_alloc_ex(size, MINST_ALIGNMENT);
+}
+
+static void
+minst_aligned_free(void* ptr)
+{
+  free(ptr);
+}
+
+/* Reads a clock for the statistics, in seconds. Where there is no monotonic clock, the processor time is used. */
+static double
+minst_now(void)
+{
+#ifdef MINST_HAVE_CLOCK_GETTIME
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  return ((double)t.tv_sec) + ((double)t.tv_nsec) * 1.0e-9;
+#else
+  return ((double)clock()) / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+static void
+minst_stats_add(struct minst_stats* dst, const struct minst_stats* src)
+{
+  uint32_t i;
+
+  dst->open_seconds += src->open_seconds;
+  dst->sampler_seconds += src->sampler_seconds;
+  dst->io_seconds += src->io_seconds;
+  dst->convert_seconds += src->convert_seconds;
+  dst->callback_seconds += src->callback_seconds;
+  dst->bytes_read += src->bytes_read;
+  dst->num_reads += src->num_reads;
+  dst->num_seeks += src->num_seeks;
+  dst->num_batches += src->num_batches;
+
+  for (i = 0; i < MINST_STATS_BUCKETS; i++) {
+    dst->latency_histogram[i] += src->latency_histogram[i];
+  }
+}
+
+/* Counts a batch in the bucket of its latency, where bucket i holds latencies below 2^i microseconds. */
+static void
+minst_stats_latency(struct minst_stats* stats, const double seconds)
+{
+  double limit;
+  uint32_t bucket;
+
+  limit = 1.0e-6;
+
+  for (bucket = 0; (bucket < (MINST_STATS_BUCKETS - 1)) && (seconds >= limit); bucket++) {
+    limit *= 2.0;
+  }
+
+  stats->latency_histogram[bucket]++;
+  stats->num_batches++;
+}
+
+static void
+minst_source_close(struct source* src)
+{
+  if (src->data && src->preloaded) {
+    minst_aligned_free((void*)src->data);
+  }
+#ifdef MINST_HAVE_MMAP
+  else if (src->data) {
+    munmap((void*)src->data, src->size);
+  }
+#endif
+
+  if (src->file) {
+    fclose(src->file);
+  }
+
+#ifdef MINST_HAVE_ZLIB
+  if (src->gz) {
+    gzclose(src->gz);
+  }
+
+  src->gz = NULL;
+#endif
+
+  src->file = NULL;
+  src->data = NULL;
+  src->size = 0;
+  src->preloaded = 0;
+}
+
+/* Reads the whole file into memory with one sequential read. The header is only checked if a format is given. */
+static enum minst_error
+minst_source_preload(struct source* src,
+                     const char* path,
+                     const struct minst_format* format,
+                     const enum minst_error open_error)
+{
+  FILE* file;
+  long int file_size;
+  uint8_t* data;
+  enum minst_error err;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return open_error;
+  }
+
+  if ((fseek(file, 0, SEEK_END) != 0) || ((file_size = ftell(file)) < 0) || (fseek(file, 0, SEEK_SET) != 0)) {
+    fclose(file);
+    return MINST_ERR_SEEK;
+  }
+
+  data = minst_aligned_alloc((size_t)file_size);
+  if (data == NULL) {
+    fclose(file);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  if ((file_size > 0) && (fread(data, (size_t)file_size, 1, file) != 1)) {
+    minst_aligned_free(data);
+    fclose(file);
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  fclose(file);
+
+  src->data = data;
+  src->size = (size_t)file_size;
+  src->preloaded = 1;
+
+  err = format ? minst_check_header(src->data, src->size, format) : MINST_ERR_NONE;
+  if (err != MINST_ERR_NONE) {
+    minst_source_close(src);
+    return err;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+#ifdef MINST_HAVE_MMAP
+
+/* Maps the whole file into memory. The header is only checked if a format is given. */
+static enum minst_error
+minst_source_map(struct source* src,
+                 const char* path,
+                 const struct minst_format* format,
+                 const enum minst_error open_error)
+{
+  int fd;
+  struct stat st;
+  void* data;
+  enum minst_error err;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return open_error;
+  }
+
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return open_error;
+  }
+
+  if (st.st_size == 0) {
+    close(fd);
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  /* the mapping stays valid after the descriptor is closed */
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return MINST_ERR_MAP;
+  }
+
+  src->data = data;
+  src->size = (size_t)st.st_size;
+
+  err = format ? minst_check_header(src->data, src->size, format) : MINST_ERR_NONE;
+  if (err != MINST_ERR_NONE) {
+    minst_source_close(src);
+    return err;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+#endif /* MINST_HAVE_MMAP */
+
+#ifdef MINST_HAVE_ZLIB
+
+/* Checks whether or not a file starts with the gzip magic number. IDX files always start with two zero bytes, so the
+ * two can not be confused. */
+static int
+minst_is_gzip(const char* path)
+{
+  FILE* file;
+  uint8_t magic[2];
+  int result;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return 0;
+  }
+
+  result = (fread(magic, 2, 1, file) == 1) && (magic[0] == 0x1F) && (magic[1] == 0x8B);
+
+  fclose(file);
+
+  return result;
+}
+
+/* Opens a gzip compressed file. Unless the file is streamed, it is inflated into aligned memory right away, so that
+ * elements can be read in any order without inflating any part of the file twice. */
+static enum minst_error
+minst_source_open_gz(struct source* src,
+                     const char* path,
+                     const struct minst_format* format,
+                     const int stream,
+                     const enum minst_error open_error)
+{
+  uint8_t header[4 + 255 * 4];
+  size_t header_size;
+  size_t size;
+  size_t chunk_size;
+  uint8_t* data;
+  int read_size;
+  enum minst_error err;
+
+  src->gz = gzopen(path, "rb");
+  if (src->gz == NULL) {
+    return open_error;
+  }
+
+  gzbuffer(src->gz, MINST_GZ_BUFFER_SIZE);
+
+  if (gzread(src->gz, header, 4) != 4) {
+    minst_source_close(src);
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  header_size = 4;
+
+  if (header[3] > 0) {
+    read_size = gzread(src->gz, header + 4, 4u * header[3]);
+    if (read_size > 0) {
+      header_size += (size_t)read_size;
+    }
+  }
+
+  err = minst_check_header(header, header_size, format);
+  if (err != MINST_ERR_NONE) {
+    minst_source_close(src);
+    return err;
+  }
+
+  if (stream) {
+    return MINST_ERR_NONE;
+  }
+
+  size = (size_t)minst_element_offset(format, format->shape[0]);
+
+  data = minst_aligned_alloc(size);
+  if (data == NULL) {
+    minst_source_close(src);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  memcpy(data, header, header_size);
+
+  while (header_size < size) {
+
+    /* gzread takes the size as an int */
+    chunk_size = size - header_size;
+    if (chunk_size > 0x40000000u) {
+      chunk_size = 0x40000000u;
+    }
+
+    read_size = gzread(src->gz, data + header_size, (unsigned int)chunk_size);
+    if (read_size <= 0) {
+      minst_aligned_free(data);
+      minst_source_close(src);
+      return MINST_ERR_MISSING_DATA;
+    }
+
+    header_size += (size_t)read_size;
+  }
+
+  gzclose(src->gz);
+
+  src->gz = NULL;
+  src->data = data;
+  src->size = size;
+  src->preloaded = 1;
+
+  return MINST_ERR_NONE;
+}
+
+#endif /* MINST_HAVE_ZLIB */
+
+/* Opens a dataset file. The sequential flag tells whether or not the file will only be read from start to end, which
+ * allows compressed files to be streamed instead of being inflated into memory. */
+static enum minst_error
+minst_source_open(struct source* src,
+                  const char* path,
+                  const struct minst_format* format,
+                  const enum minst_io_mode io_mode,
+                  const int sequential,
+                  const enum minst_error open_error)
+{
+  enum minst_error err;
+
+  src->file = NULL;
+  src->data = NULL;
+  src->size = 0;
+  src->preloaded = 0;
+  src->payload_offset = minst_element_offset(format, 0);
+
+#ifdef MINST_HAVE_ZLIB
+  src->gz = NULL;
+
+  if (minst_is_gzip(path)) {
+    return minst_source_open_gz(src, path, format, sequential && (io_mode == MINST_IO_STDIO), open_error);
+  }
+#else
+  (void)sequential;
+#endif
+
+  if (io_mode == MINST_IO_PRELOAD) {
+    return minst_source_preload(src, path, format, open_error);
+  }
+
+#ifdef MINST_HAVE_MMAP
+  if (io_mode == MINST_IO_MMAP) {
+    return minst_source_map(src, path, format, open_error);
+  }
+#endif
+
+  src->file = fopen(path, "rb");
+  if (src->file == NULL) {
+    return open_error;
+  }
+
+  err = minst_check_format(src->file, format);
+  if (err != MINST_ERR_NONE) {
+    minst_source_close(src);
+    return err;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Gets the offset of an element within a file. */
+static long int
+minst_source_offset(const struct source* src, const struct minst_format* format, const uint32_t element_idx)
+{
+  return src->payload_offset + ((long int)element_idx) * ((long int)minst_element_size(format));
+}
+
+/* Returns a pointer to a range of the file, if the file is mapped and the range exists. Otherwise, null is returned. */
+static const uint8_t*
+minst_source_span(const struct source* src, const long int offset, const size_t size)
+{
+  if (!src->data || ((size_t)offset) > src->size || size > src->size - ((size_t)offset)) {
+    return NULL;
+  }
+
+  return src->data + offset;
+}
+
+/* Reads a range of the file. If statistics are given, the calls are counted. */
+static enum minst_error
+minst_source_read(struct source* src,
+                  const long int offset,
+                  const uint32_t size,
+                  uint8_t* dst,
+                  struct minst_stats* stats)
+{
+  const uint8_t* span;
+
+  if (stats && !src->data) {
+    stats->num_seeks++;
+    stats->num_reads++;
+  }
+
+  if (src->data) {
+
+    span = minst_source_span(src, offset, size);
+    if (span == NULL) {
+      return MINST_ERR_MISSING_DATA;
+    }
+
+    memcpy(dst, span, size);
+
+    return MINST_ERR_NONE;
+  }
+
+#ifdef MINST_HAVE_ZLIB
+  if (src->gz) {
+
+    /* seeking forward inflates the skipped data, seeking backward starts over from the beginning of the file */
+    if (gzseek(src->gz, offset, SEEK_SET) != offset) {
+      return MINST_ERR_SEEK;
+    }
+
+    if (gzread(src->gz, dst, size) != (int)size) {
+      return MINST_ERR_MISSING_DATA;
+    }
+
+    return MINST_ERR_NONE;
+  }
+#endif
+
+  if (fseek(src->file, offset, SEEK_SET) != 0) {
+    return MINST_ERR_SEEK;
+  }
+
+  if (fread(dst, size, 1, src->file) != 1) {
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Like @ref minst_source_read, but safe to call from several threads at once since it does not move the file
+ * position. */
+static enum minst_error
+minst_source_pread(struct source* src,
+                   const long int offset,
+                   const uint32_t size,
+                   uint8_t* dst,
+                   struct minst_stats* stats)
+{
+#ifdef MINST_HAVE_THREADS
+  ssize_t read_size;
+  size_t total;
+
+  if (src->data || !src->file) {
+    return minst_source_read(src, offset, size, dst, stats);
+  }
+
+  total = 0;
+
+  while (total < size) {
+
+    if (stats) {
+      stats->num_reads++;
+    }
+
+    read_size = pread(fileno(src->file), dst + total, size - total, (off_t)(offset + (long int)total));
+    if (read_size <= 0) {
+      return MINST_ERR_MISSING_DATA;
+    }
+
+    total += (size_t)read_size;
+  }
+
+  return MINST_ERR_NONE;
+#else
+  return minst_source_read(src, offset, size, dst, stats);
+#endif
+}
+
+/* A fixed set of threads that run a task together with the calling thread. The calling thread is always worker zero. */
+struct worker_pool
+{
+  uint32_t num_workers;
+
+#ifdef MINST_HAVE_THREADS
+  pthread_t* threads;
+
+  uint32_t num_threads;
+
+  pthread_mutex_t mutex;
+
+  pthread_cond_t start_cond;
+
+  pthread_cond_t done_cond;
+
+  /* incremented every time a task is started */
+  uint32_t generation;
+
+  /* the number of threads that have not finished the current task */
+  uint32_t pending;
+
+  int quit;
+#endif
+
+  void (*task)(void* task_data, uint32_t worker_idx, uint32_t num_workers);
+
+  void* task_data;
+};
+
+#ifdef MINST_HAVE_THREADS
+
+struct worker
+{
+  struct worker_pool* pool;
+
+  uint32_t worker_idx;
+};
+
+static void*
+minst_worker_main(void* worker_ptr)
+{
+  struct worker_pool* pool;
+  uint32_t worker_idx;
+  uint32_t generation;
+
+  pool = ((struct worker*)worker_ptr)->pool;
+
+  worker_idx = ((struct worker*)worker_ptr)->worker_idx;
+
+  free(worker_ptr);
+
+  /* the pool is created with a generation of zero, so a task started before this thread got here is not missed */
+  generation = 0;
+
+  pthread_mutex_lock(&pool->mutex);
+
+  for (;;) {
+
+    while ((pool->generation == generation) && !pool->quit) {
+      pthread_cond_wait(&pool->start_cond, &pool->mutex);
+    }
+
+    if (pool->quit) {
+      break;
+    }
+
+    generation = pool->generation;
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->task(pool->task_data, worker_idx, pool->num_workers);
+
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->pending--;
+
+    if (pool->pending == 0) {
+      pthread_cond_signal(&pool->done_cond);
+    }
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+#endif /* MINST_HAVE_THREADS */
+
+static void
+minst_pool_destroy(struct worker_pool* pool)
+{
+#ifdef MINST_HAVE_THREADS
+  uint32_t i;
+
+  /* the threads array is allocated right before the sync objects are initialised, so they exist whenever it does,
+   * even if starting the first thread failed */
+  if (pool->threads != NULL) {
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* only the threads that were started are joined */
+    for (i = 0; i < pool->num_threads; i++) {
+      pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_mutex_destroy(&pool->mutex);
+  }
+
+  free(pool->threads);
+
+  pool->threads = NULL;
+  pool->num_threads = 0;
+#endif
+
+  pool->num_workers = 1;
+}
+
+static enum minst_error
+minst_pool_init(struct worker_pool* pool, const uint32_t num_workers)
+{
+#ifdef MINST_HAVE_THREADS
+  struct worker* w;
+  uint32_t i;
+#endif
+
+  memset(pool, 0, sizeof(*pool));
+
+  pool->num_workers = 1;
+
+#ifdef MINST_HAVE_THREADS
+  if (num_workers <= 1) {
+    return MINST_ERR_NONE;
+  }
+
+  pool->threads = malloc((num_workers - 1) * sizeof(pthread_t));
+  if (pool->threads == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->start_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  pool->num_workers = num_workers;
+
+  for (i = 0; i < (num_workers - 1); i++) {
+
+    w = malloc(sizeof(struct worker));
+    if (w == NULL) {
+      pool->num_threads = i;
+      minst_pool_destroy(pool);
+      return MINST_ERR_OUT_OF_MEMORY;
+    }
+
+    w->pool = pool;
+    w->worker_idx = i + 1;
+
+    if (pthread_create(&pool->threads[i], NULL, minst_worker_main, w) != 0) {
+      free(w);
+      pool->num_threads = i;
+      minst_pool_destroy(pool);
+      return MINST_ERR_THREAD;
+    }
+  }
+
+  pool->num_threads = num_workers - 1;
+#else
+  (void)num_workers;
+#endif
+
+  return MINST_ERR_NONE;
+}
+
+/* Runs a task on every worker of the pool and waits for all of them to finish. */
+static void
+minst_pool_run(struct worker_pool* pool, void (*task)(void*, uint32_t, uint32_t), void* task_data)
+{
+#ifdef MINST_HAVE_THREADS
+  if (pool->num_threads > 0) {
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->task_data = task_data;
+    pool->pending = pool->num_threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    task(task_data, 0, pool->num_workers);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->pending > 0) {
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return;
+  }
+#endif
+
+  task(task_data, 0, 1);
+}
+
+static int
+minst_is_contiguous(const uint32_t* indices, const uint32_t count)
+{
+  uint32_t i;
+
+  for (i = 1; i < count; i++) {
+    if (indices[i] != indices[0] + i) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/* Pairs an element with the batch slot it is read into, so that reads can be done in file order. */
+struct read_order
+{
+  uint32_t element_idx;
+
+  uint32_t batch_idx;
+};
+
+static int
+minst_compare_read_order(const void* a, const void* b)
+{
+  const uint32_t a_idx = ((const struct read_order*)a)->element_idx;
+  const uint32_t b_idx = ((const struct read_order*)b)->element_idx;
+  return (a_idx > b_idx) - (a_idx < b_idx);
+}
+
+/* The number of labels read at once while building a class index. */
+#define MINST_CLASS_CHUNK 65536
+
+/* The elements of each class, found with one pass over the labels file when the dataset is opened. The indices are
+ * those chosen by samplers, which are local to the shard. The elements of class c are elements[offsets[c]] up to, but
+ * not including, elements[offsets[c + 1]]. */
+struct class_index
+{
+  uint32_t num_classes;
+
+  uint32_t* offsets;
+
+  uint32_t* elements;
+};
+
+static void
+minst_class_index_free(struct class_index* index)
+{
+  free(index->offsets);
+  free(index->elements);
+
+  index->offsets = NULL;
+  index->elements = NULL;
+}
+
+/* Reads the label of every element as a native integer. */
+static enum minst_error
+minst_read_labels(const char* labels_path, const struct minst_format* label_format, int32_t* labels)
+{
+  struct source src;
+  minst_widen_func widen;
+  enum minst_error err;
+  uint8_t* chunk;
+  uint32_t label_size;
+  uint32_t first;
+  uint32_t count;
+
+  widen = minst_get_widen(label_format->type, 4);
+
+  label_size = minst_element_size(label_format);
+
+  if ((widen == NULL) || (label_size != minst_type_size(label_format->type))) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  chunk = malloc(((size_t)MINST_CLASS_CHUNK) * label_size);
+  if (chunk == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  memset(&src, 0, sizeof(src));
+
+  err = minst_source_open(&src, labels_path, label_format, MINST_IO_STDIO, 1, MINST_ERR_OPEN_LABELS);
+
+  for (first = 0; (err == MINST_ERR_NONE) && (first < label_format->shape[0]); first += count) {
+
+    count = label_format->shape[0] - first;
+    count = (count > MINST_CLASS_CHUNK) ? MINST_CLASS_CHUNK : count;
+
+    err = minst_source_read(&src, minst_source_offset(&src, label_format, first), count * label_size, chunk, NULL);
+    if (err == MINST_ERR_NONE) {
+      widen(chunk, labels + first, count);
+    }
+  }
+
+  minst_source_close(&src);
+
+  free(chunk);
+
+  return err;
+}
+
+/* A pair of dataset files opened for views. The files are shared by every view that refers to them, and are closed
+ * along with the last of these views. */
+struct view_files
+{
+  struct source samples;
+
+  struct source labels;
+
+  /* the number of view segments that refer to the files */
+  uint32_t num_refs;
+};
+
+/* A run of consecutive elements of one pair of files. */
+struct view_segment
+{
+  struct view_files* files;
+
+  /* the index of the first element of the run in the files */
+  uint32_t first;
+
+  /* the position of the first element of the run among the elements of all segments of the view */
+  uint32_t start;
+
+  uint32_t count;
+};
+
+struct minst_view
+{
+  /* the formats of the elements, where the first dimension is the number of elements in the view */
+  struct minst_format sample_format;
+
+  struct minst_format label_format;
+
+  /* the segments, ordered by their start, none of which is empty */
+  struct view_segment* segments;
+
+  uint32_t num_segments;
+
+  /* the position of each element among the elements of the segments, or null if the view is the segments in order */
+  uint32_t* indices;
+
+  /* whether or not all files of the view are in memory */
+  int in_memory;
+};
+
+/* Creates a view without any segments, which are added with @ref minst_view_push. */
+static enum minst_error
+minst_view_create(struct minst_view** view,
+                  const struct minst_format* sample_format,
+                  const struct minst_format* label_format,
+                  const uint32_t num_elements,
+                  const uint32_t max_segments,
+                  const int with_indices)
+{
+  struct minst_view* v;
+
+  *view = NULL;
+
+  v = calloc(1, sizeof(struct minst_view));
+  if (v == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  v->sample_format = *sample_format;
+  v->label_format = *label_format;
+  v->sample_format.shape[0] = num_elements;
+  v->label_format.shape[0] = num_elements;
+  v->in_memory = 1;
+
+  v->segments = malloc((((size_t)max_segments) + 1) * sizeof(struct view_segment));
+  v->indices = with_indices ? malloc((((size_t)num_elements) + 1) * sizeof(uint32_t)) : NULL;
+
+  if ((v->segments == NULL) || (with_indices && (v->indices == NULL))) {
+    minst_view_close(v);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  *view = v;
+
+  return MINST_ERR_NONE;
+}
+
+/* Adds a segment after the last one, unless it is empty. */
+static void
+minst_view_push(struct minst_view* view,
+                struct view_files* files,
+                const uint32_t first,
+                const uint32_t start,
+                const uint32_t count)
+{
+  struct view_segment* seg;
+
+  if (count == 0) {
+    return;
+  }
+
+  seg = &view->segments[view->num_segments++];
+  seg->files = files;
+  seg->first = first;
+  seg->start = start;
+  seg->count = count;
+
+  files->num_refs++;
+
+  view->in_memory = view->in_memory && files->samples.data && files->labels.data;
+}
+
+/* Gets the number of elements of all segments of a view, which is the size of the view unless it has indices. */
+static uint32_t
+minst_view_span(const struct minst_view* view)
+{
+  const struct view_segment* last;
+
+  if (view->num_segments == 0) {
+    return 0;
+  }
+
+  last = &view->segments[view->num_segments - 1];
+
+  return last->start + last->count;
+}
+
+/* Finds the files and the element in the files of an element of a view. */
+static void
+minst_view_locate(const struct minst_view* view,
+                  const uint32_t view_idx,
+                  struct view_files** files,
+                  uint32_t* element_idx)
+{
+  const struct view_segment* seg;
+  uint32_t pos;
+  uint32_t lo;
+  uint32_t hi;
+  uint32_t mid;
+
+  pos = view->indices ? view->indices[view_idx] : view_idx;
+
+  /* the last segment that starts at or before the position */
+  lo = 0;
+  hi = view->num_segments - 1;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo + 1) / 2;
+    if (view->segments[mid].start <= pos) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  seg = &view->segments[lo];
+
+  *files = seg->files;
+  *element_idx = seg->first + (pos - seg->start);
+}
+
+/* Reads the label of every element of a view as a native integer. */
+static enum minst_error
+minst_view_read_labels(const struct minst_view* view, int32_t* labels)
+{
+  struct view_files* files;
+  minst_widen_func widen;
+  enum minst_error err;
+  uint32_t label_size;
+  uint32_t element_idx;
+  uint32_t i;
+  uint8_t label[8];
+
+  widen = minst_get_widen(view->label_format.type, 4);
+
+  label_size = minst_element_size(&view->label_format);
+
+  if ((widen == NULL) || (label_size != minst_type_size(view->label_format.type))) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  for (i = 0; i < view->label_format.shape[0]; i++) {
+
+    minst_view_locate(view, i, &files, &element_idx);
+
+    err = minst_source_pread(&files->labels,
+                             minst_source_offset(&files->labels, &view->label_format, element_idx),
+                             label_size,
+                             label,
+                             NULL);
+    if (err != MINST_ERR_NONE) {
+      return err;
+    }
+
+    widen(label, labels + i, 1);
+  }
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_view_open(struct minst_view** view,
+                const char* samples_path,
+                const char* labels_path,
+                const struct minst_format* sample_format,
+                const struct minst_format* label_format,
+                const enum minst_io_mode io_mode)
+{
+  struct view_files* files;
+  enum minst_error err;
+
+  *view = NULL;
+
+  if (sample_format->shape[0] != label_format->shape[0]) {
+    return MINST_ERR_SHAPE;
+  }
+
+  files = calloc(1, sizeof(struct view_files));
+  if (files == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  /* a view may be read by several datasets at once, so compressed files are always inflated into memory */
+  err = minst_source_open(&files->samples, samples_path, sample_format, io_mode, 0, MINST_ERR_OPEN_SAMPLES);
+  if (err != MINST_ERR_NONE) {
+    free(files);
+    return err;
+  }
+
+  err = minst_source_open(&files->labels, labels_path, label_format, io_mode, 0, MINST_ERR_OPEN_LABELS);
+  if (err != MINST_ERR_NONE) {
+    minst_source_close(&files->samples);
+    free(files);
+    return err;
+  }
+
+  err = minst_view_create(view, sample_format, label_format, sample_format->shape[0], 1, 0);
+  if (err != MINST_ERR_NONE) {
+    minst_source_close(&files->labels);
+    minst_source_close(&files->samples);
+    free(files);
+    return err;
+  }
+
+  minst_view_push(*view, files, 0, 0, sample_format->shape[0]);
+
+  /* the files of an empty view are not referred to by any segment */
+  if (files->num_refs == 0) {
+    minst_source_close(&files->labels);
+    minst_source_close(&files->samples);
+    free(files);
+  }
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_view_range(struct minst_view** view, const struct minst_view* parent, const uint32_t first, const uint32_t count)
+{
+  const struct view_segment* seg;
+  enum minst_error err;
+  uint32_t seg_idx;
+  uint32_t lo;
+  uint32_t hi;
+
+  *view = NULL;
+
+  if ((first > parent->sample_format.shape[0]) || (count > (parent->sample_format.shape[0] - first))) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  err = minst_view_create(
+    view, &parent->sample_format, &parent->label_format, count, parent->num_segments, parent->indices != NULL);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  /* a range of indices keeps all segments, while a range of segments is cut down to the segments it overlaps */
+  if (parent->indices) {
+
+    for (seg_idx = 0; seg_idx < parent->num_segments; seg_idx++) {
+      seg = &parent->segments[seg_idx];
+      minst_view_push(*view, seg->files, seg->first, seg->start, seg->count);
+    }
+
+    if (count > 0) {
+      memcpy((*view)->indices, parent->indices + first, ((size_t)count) * sizeof(uint32_t));
+    }
+
+    return MINST_ERR_NONE;
+  }
+
+  for (seg_idx = 0; seg_idx < parent->num_segments; seg_idx++) {
+
+    seg = &parent->segments[seg_idx];
+
+    lo = (seg->start > first) ? seg->start : first;
+    hi = ((seg->start + seg->count) < (first + count)) ? (seg->start + seg->count) : (first + count);
+
+    if (lo < hi) {
+      minst_view_push(*view, seg->files, seg->first + (lo - seg->start), lo - first, hi - lo);
+    }
+  }
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_view_select(struct minst_view** view,
+                  const struct minst_view* parent,
+                  const uint32_t* indices,
+                  const uint32_t count)
+{
+  const struct view_segment* seg;
+  enum minst_error err;
+  uint32_t seg_idx;
+  uint32_t i;
+
+  *view = NULL;
+
+  for (i = 0; i < count; i++) {
+    if (indices[i] >= parent->sample_format.shape[0]) {
+      return MINST_ERR_INVALID_ARGUMENT;
+    }
+  }
+
+  err = minst_view_create(view, &parent->sample_format, &parent->label_format, count, parent->num_segments, 1);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  for (seg_idx = 0; seg_idx < parent->num_segments; seg_idx++) {
+    seg = &parent->segments[seg_idx];
+    minst_view_push(*view, seg->files, seg->first, seg->start, seg->count);
+  }
+
+  for (i = 0; i < count; i++) {
+    (*view)->indices[i] = parent->indices ? parent->indices[indices[i]] : indices[i];
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Checks that two formats only differ in their number of elements. */
+static enum minst_error
+minst_view_check_format(const struct minst_format* a, const struct minst_format* b)
+{
+  uint32_t dim_idx;
+
+  if (a->type != b->type) {
+    return MINST_ERR_TYPE;
+  }
+
+  if (a->rank != b->rank) {
+    return MINST_ERR_SHAPE;
+  }
+
+  for (dim_idx = 1; dim_idx < MINST_MAX_RANK; dim_idx++) {
+    if (a->shape[dim_idx] != b->shape[dim_idx]) {
+      return MINST_ERR_SHAPE;
+    }
+  }
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_view_concat(struct minst_view** view, const struct minst_view* const* parts, const uint32_t num_parts)
+{
+  const struct minst_view* part;
+  const struct view_segment* seg;
+  enum minst_error err;
+  uint32_t max_segments;
+  uint32_t num_elements;
+  uint32_t part_idx;
+  uint32_t seg_idx;
+  uint32_t base;
+  uint32_t pos;
+  uint32_t i;
+  int with_indices;
+
+  *view = NULL;
+
+  if (num_parts == 0) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  max_segments = 0;
+  num_elements = 0;
+  base = 0;
+  with_indices = 0;
+
+  for (part_idx = 0; part_idx < num_parts; part_idx++) {
+
+    part = parts[part_idx];
+
+    err = minst_view_check_format(&parts[0]->sample_format, &part->sample_format);
+    if (err == MINST_ERR_NONE) {
+      err = minst_view_check_format(&parts[0]->label_format, &part->label_format);
+    }
+
+    if (err != MINST_ERR_NONE) {
+      return err;
+    }
+
+    /* the elements and the segments are both counted with 32 bits */
+    if ((part->sample_format.shape[0] > (0xFFFFFFFFu - num_elements)) ||
+        (minst_view_span(part) > (0xFFFFFFFFu - base))) {
+      return MINST_ERR_INVALID_ARGUMENT;
+    }
+
+    num_elements += part->sample_format.shape[0];
+    base += minst_view_span(part);
+    max_segments += part->num_segments;
+    with_indices = with_indices || (part->indices != NULL);
+  }
+
+  err = minst_view_create(
+    view, &parts[0]->sample_format, &parts[0]->label_format, num_elements, max_segments, with_indices);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  base = 0;
+  pos = 0;
+
+  for (part_idx = 0; part_idx < num_parts; part_idx++) {
+
+    part = parts[part_idx];
+
+    for (seg_idx = 0; seg_idx < part->num_segments; seg_idx++) {
+      seg = &part->segments[seg_idx];
+      minst_view_push(*view, seg->files, seg->first, base + seg->start, seg->count);
+    }
+
+    /* once any part has indices, the parts without indices get indices that visit their segments in order */
+    for (i = 0; with_indices && (i < part->sample_format.shape[0]); i++) {
+      (*view)->indices[pos + i] = base + (part->indices ? part->indices[i] : i);
+    }
+
+    pos += part->sample_format.shape[0];
+    base += minst_view_span(part);
+  }
+
+  return MINST_ERR_NONE;
+}
+
+uint32_t
+minst_view_size(const struct minst_view* view)
+{
+  return view->sample_format.shape[0];
+}
+
+void
+minst_view_formats(const struct minst_view* view,
+                   struct minst_format* sample_format,
+                   struct minst_format* label_format)
+{
+  *sample_format = view->sample_format;
+  *label_format = view->label_format;
+}
+
+void
+minst_view_close(struct minst_view* view)
+{
+  struct view_files* files;
+  uint32_t seg_idx;
+
+  if (!view) {
+    return;
+  }
+
+  for (seg_idx = 0; seg_idx < view->num_segments; seg_idx++) {
+
+    files = view->segments[seg_idx].files;
+
+    if (--files->num_refs == 0) {
+      minst_source_close(&files->labels);
+      minst_source_close(&files->samples);
+      free(files);
+    }
+  }
+
+  free(view->indices);
+  free(view->segments);
+  free(view);
+}
+
+/* Sorts the elements of a shard by class with a counting sort. If the number of classes is zero, it is taken from the
+ * largest label. The labels are taken from the view if there is one, and from the labels file otherwise. */
+static enum minst_error
+minst_class_index_build(struct class_index* index,
+                        const char* labels_path,
+                        const struct minst_view* view,
+                        const struct minst_format* label_format,
+                        const uint32_t num_classes,
+                        const struct shard* sh,
+                        const uint32_t num_elements)
+{
+  enum minst_error err;
+  int32_t* labels;
+  uint32_t* fill;
+  uint32_t total;
+  uint32_t label;
+  uint32_t i;
+
+  memset(index, 0, sizeof(*index));
+
+  total = label_format->shape[0];
+
+  if (total == 0) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  labels = malloc(((size_t)total) * sizeof(int32_t));
+  if (labels == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  err = view ? minst_view_read_labels(view, labels) : minst_read_labels(labels_path, label_format, labels);
+  if (err != MINST_ERR_NONE) {
+    free(labels);
+    return err;
+  }
+
+  index->num_classes = num_classes;
+
+  for (i = 0; i < total; i++) {
+
+    if ((labels[i] < 0) || ((num_classes > 0) && (((uint32_t)labels[i]) >= num_classes))) {
+      free(labels);
+      return MINST_ERR_LABEL_RANGE;
+    }
+
+    if ((num_classes == 0) && (((uint32_t)labels[i]) >= index->num_classes)) {
+      index->num_classes = ((uint32_t)labels[i]) + 1;
+    }
+  }
+
+  index->offsets = calloc(((size_t)index->num_classes) + 1, sizeof(uint32_t));
+  index->elements = malloc(((size_t)num_elements) * sizeof(uint32_t));
+  fill = calloc(index->num_classes, sizeof(uint32_t));
+
+  if ((index->offsets == NULL) || (index->elements == NULL) || (fill == NULL)) {
+    free(fill);
+    free(labels);
+    minst_class_index_free(index);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  /* padded shards wrap around to the start of the file */
+  for (i = 0; i < num_elements; i++) {
+    label = (uint32_t)labels[(((uint64_t)sh->offset) + i) % total];
+    index->offsets[label + 1]++;
+  }
+
+  for (i = 0; i < index->num_classes; i++) {
+    index->offsets[i + 1] += index->offsets[i];
+  }
+
+  for (i = 0; i < num_elements; i++) {
+    label = (uint32_t)labels[(((uint64_t)sh->offset) + i) % total];
+    index->elements[index->offsets[label] + fill[label]] = i;
+    fill[label]++;
+  }
+
+  free(fill);
+  free(labels);
+
+  return MINST_ERR_NONE;
+}
+
+/* Chooses elements by their class, using a class index that is built once when the dataset is opened. */
+struct class_sampler
+{
+  enum minst_sampling mode;
+
+  struct class_index index;
+
+  uint64_t seed;
+
+  uint64_t epoch;
+
+  struct minst_rng rng;
+
+  /* the share of each class in every batch, for stratified and balanced sampling */
+  double* shares;
+
+  /* the number of elements of each class in the current batch */
+  uint32_t* quotas;
+
+  /* the elements of each class in a shuffled order, and the position of the next one to choose */
+  uint32_t* shuffled;
+
+  uint32_t* cursors;
+
+  /* the alias table over the classes, for weighted sampling */
+  float* alias_probs;
+
+  uint32_t* aliases;
+};
+
+static void
+minst_class_sampler_free(struct class_sampler* s)
+{
+  minst_class_index_free(&s->index);
+
+  free(s->shares);
+  free(s->quotas);
+  free(s->shuffled);
+  free(s->cursors);
+  free(s->alias_probs);
+  free(s->aliases);
+}
+
+static void
+minst_class_shuffle(struct class_sampler* s, const uint32_t class_idx)
+{
+  uint32_t* elements;
+  uint32_t count;
+  uint32_t i;
+  uint32_t j;
+  uint32_t tmp;
+
+  elements = s->shuffled + s->index.offsets[class_idx];
+
+  count = s->index.offsets[class_idx + 1] - s->index.offsets[class_idx];
+
+  for (i = count; i > 1; i--) {
+    j = minst_rng_bounded(&s->rng, i);
+    tmp = elements[i - 1];
+    elements[i - 1] = elements[j];
+    elements[j] = tmp;
+  }
+
+  s->cursors[class_idx] = 0;
+}
+
+/* Starts an epoch. Each class is shuffled starting from the order of the file, so that the epoch only depends on the
+ * seed and the epoch number. */
+static void
+minst_class_sampler_prepare(struct class_sampler* s)
+{
+  uint32_t c;
+
+  minst_rng_seed(&s->rng, s->seed, s->epoch);
+
+  if (s->mode == MINST_SAMPLING_WEIGHTED) {
+    return;
+  }
+
+  memcpy(s->shuffled, s->index.elements, ((size_t)s->index.offsets[s->index.num_classes]) * sizeof(uint32_t));
+
+  for (c = 0; c < s->index.num_classes; c++) {
+    minst_class_shuffle(s, c);
+  }
+}
+
+/* Builds the alias table of Vose's method, so that a class is drawn with one uniform index and one comparison. */
+static void
+minst_alias_build(struct class_sampler* s, const double* weights, double* scaled, uint32_t* small, uint32_t* large)
+{
+  const uint32_t n = s->index.num_classes;
+  double sum;
+  uint32_t num_small;
+  uint32_t num_large;
+  uint32_t l;
+  uint32_t g;
+  uint32_t c;
+
+  sum = 0.0;
+
+  for (c = 0; c < n; c++) {
+    sum += weights[c];
+  }
+
+  num_small = 0;
+  num_large = 0;
+
+  for (c = 0; c < n; c++) {
+
+    scaled[c] = (weights[c] * n) / sum;
+
+    if (scaled[c] < 1.0) {
+      small[num_small++] = c;
+    } else {
+      large[num_large++] = c;
+    }
+  }
+
+  while ((num_small > 0) && (num_large > 0)) {
+
+    l = small[--num_small];
+    g = large[num_large - 1];
+
+    s->alias_probs[l] = (float)scaled[l];
+    s->aliases[l] = g;
+
+    scaled[g] = (scaled[g] + scaled[l]) - 1.0;
+
+    if (scaled[g] < 1.0) {
+      num_large--;
+      small[num_small++] = g;
+    }
+  }
+
+  /* what is left over only differs from one by rounding errors */
+  while (num_large > 0) {
+    g = large[--num_large];
+    s->alias_probs[g] = 1.0f;
+    s->aliases[g] = g;
+  }
+
+  while (num_small > 0) {
+    l = small[--num_small];
+    s->alias_probs[l] = 1.0f;
+    s->aliases[l] = l;
+  }
+}
+
+static enum minst_error
+minst_class_sampler_init(struct class_sampler* s,
+                         const enum minst_sampling mode,
+                         const uint64_t seed,
+                         const float* class_weights,
+                         const char* labels_path,
+                         const struct minst_view* view,
+                         const struct minst_format* label_format,
+                         const uint32_t num_classes,
+                         const struct shard* sh,
+                         const uint32_t num_elements)
+{
+  enum minst_error err;
+  uint32_t n;
+  uint32_t c;
+  uint32_t count;
+  double* weights;
+  double sum;
+
+  memset(s, 0, sizeof(*s));
+
+  if ((mode != MINST_SAMPLING_STRATIFIED) && (mode != MINST_SAMPLING_BALANCED) && (mode != MINST_SAMPLING_WEIGHTED)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  /* the weights can only be matched to the classes if the number of classes is known */
+  if (class_weights && (num_classes == 0)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  s->mode = mode;
+  s->seed = seed;
+
+  err = minst_class_index_build(&s->index, labels_path, view, label_format, num_classes, sh, num_elements);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  n = s->index.num_classes;
+
+  s->shares = calloc(n, sizeof(double));
+  s->quotas = calloc(n, sizeof(uint32_t));
+  s->shuffled = calloc(((size_t)num_elements) + 1, sizeof(uint32_t));
+  s->cursors = calloc(n, sizeof(uint32_t));
+  s->alias_probs = calloc(n, sizeof(float));
+  s->aliases = calloc(n, sizeof(uint32_t));
+  weights = calloc(n, sizeof(double));
+
+  if (!s->shares || !s->quotas || !s->shuffled || !s->cursors || !s->alias_probs || !s->aliases || !weights) {
+    free(weights);
+    minst_class_sampler_free(s);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  sum = 0.0;
+
+  for (c = 0; c < n; c++) {
+
+    count = s->index.offsets[c + 1] - s->index.offsets[c];
+
+    if (class_weights && !(class_weights[c] >= 0.0f)) {
+      free(weights);
+      minst_class_sampler_free(s);
+      return MINST_ERR_INVALID_ARGUMENT;
+    }
+
+    switch (mode) {
+      case MINST_SAMPLING_STRATIFIED:
+        weights[c] = (double)count;
+        break;
+      case MINST_SAMPLING_BALANCED:
+        weights[c] = (count > 0) ? 1.0 : 0.0;
+        break;
+      default:
+        /* each element has the weight of its class */
+        weights[c] = ((double)count) * (class_weights ? class_weights[c] : 1.0);
+        break;
+    }
+
+    sum += weights[c];
+  }
+
+  if (!(sum > 0.0)) {
+    free(weights);
+    minst_class_sampler_free(s);
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  if (mode == MINST_SAMPLING_WEIGHTED) {
+    /* the other tables are not used in weighted mode, so they serve as scratch memory */
+    minst_alias_build(s, weights, s->shares, s->quotas, s->cursors);
+  } else {
+    for (c = 0; c < n; c++) {
+      s->shares[c] = weights[c] / sum;
+    }
+  }
+
+  free(weights);
+
+  minst_class_sampler_prepare(s);
+
+  return MINST_ERR_NONE;
+}
+
+/* Chooses the next element of a class, reshuffling the class once all of its elements have been chosen. */
+static uint32_t
+minst_class_next(struct class_sampler* s, const uint32_t class_idx)
+{
+  const uint32_t count = s->index.offsets[class_idx + 1] - s->index.offsets[class_idx];
+
+  if (s->cursors[class_idx] >= count) {
+    minst_class_shuffle(s, class_idx);
+  }
+
+  return s->shuffled[s->index.offsets[class_idx] + s->cursors[class_idx]++];
+}
+
+/* Splits a batch among the classes in proportion to their shares. Each class gets the whole part of its share, and the
+ * fractional parts are handed out with systematic sampling, so that each class gets at most one more element and its
+ * expected number of elements is exact. */
+static void
+minst_class_quotas(struct class_sampler* s, const uint32_t count)
+{
+  const uint32_t n = s->index.num_classes;
+  double owed;
+  double point;
+  double sum;
+  uint32_t assigned;
+  uint32_t last;
+  uint32_t c;
+
+  assigned = 0;
+  last = 0;
+
+  for (c = 0; c < n; c++) {
+    s->quotas[c] = (uint32_t)floor(s->shares[c] * count);
+    assigned += s->quotas[c];
+    last = (s->shares[c] > 0.0) ? c : last;
+  }
+
+  point = ((double)minst_rng_next(&s->rng)) * (1.0 / 4294967296.0);
+  sum = 0.0;
+
+  for (c = 0; (c < n) && (assigned < count); c++) {
+
+    owed = s->shares[c] * count - (double)s->quotas[c];
+
+    sum += owed;
+
+    if (sum > point) {
+      s->quotas[c]++;
+      assigned++;
+      point += 1.0;
+    }
+  }
+
+  /* rounding errors may leave an element over */
+  s->quotas[last] += count - assigned;
+}
+
+static int
+minst_class_sampler(void* sampler_data, const uint32_t num_elements, const uint32_t count, uint32_t* element_indices)
+{
+  struct class_sampler* s;
+  uint32_t class_idx;
+  uint32_t class_size;
+  uint32_t i;
+  uint32_t j;
+  uint32_t tmp;
+
+  s = sampler_data;
+
+  (void)num_elements;
+
+  if (s->mode == MINST_SAMPLING_WEIGHTED) {
+
+    for (i = 0; i < count; i++) {
+
+      class_idx = minst_rng_bounded(&s->rng, s->index.num_classes);
+
+      if (((float)(minst_rng_next(&s->rng) >> 8)) * (1.0f / 16777216.0f) >= s->alias_probs[class_idx]) {
+        class_idx = s->aliases[class_idx];
+      }
+
+      class_size = s->index.offsets[class_idx + 1] - s->index.offsets[class_idx];
+
+      element_indices[i] = s->index.elements[s->index.offsets[class_idx] + minst_rng_bounded(&s->rng, class_size)];
+    }
+
+    return 0;
+  }
+
+  minst_class_quotas(s, count);
+
+  i = 0;
+
+  for (class_idx = 0; class_idx < s->index.num_classes; class_idx++) {
+    for (j = 0; j < s->quotas[class_idx]; j++) {
+      element_indices[i++] = minst_class_next(s, class_idx);
+    }
+  }
+
+  /* the classes are mixed, so that any part of the batch has about the same mix */
+  for (i = count; i > 1; i--) {
+    j = minst_rng_bounded(&s->rng, i);
+    tmp = element_indices[i - 1];
+    element_indices[i - 1] = element_indices[j];
+    element_indices[j] = tmp;
+  }
+
+  return 0;
+}
+
+static void
+minst_class_sampler_next_epoch(struct class_sampler* s)
+{
+  s->epoch++;
+
+  minst_class_sampler_prepare(s);
+}
+
+/* How the elements of a file are changed before being passed on. */
+struct transform
+{
+  /* converts the elements to floats, if not null */
+  minst_convert_f32_func convert;
+
+  /* converts the elements to native byte order, if not null */
+  minst_bswap_func swap;
+
+  /* converts the elements to wider integers, if not null. For one-hot labels, this reads the class of each value. */
+  minst_widen_func widen;
+
+  float scale;
+
+  float bias;
+
+  /* the number of classes of one-hot labels, or zero when the labels are not expanded */
+  uint32_t num_classes;
+
+  float on_value;
+
+  float off_value;
+
+  /* the number of values in one element */
+  uint32_t values;
+
+  /* the size of one transformed element, in bytes */
+  uint32_t output_size;
+};
+
+static int
+minst_is_big_endian(void)
+{
+  const uint16_t probe = 1;
+  return *((const uint8_t*)&probe) == 0;
+}
+
+static enum minst_error
+minst_transform_init(struct transform* t,
+                     const struct minst_format* format,
+                     const enum minst_output output,
+                     const float scale,
+                     const float mean,
+                     const float std,
+                     const uint32_t num_classes,
+                     const float smoothing)
+{
+  memset(t, 0, sizeof(*t));
+
+  t->values = format->shape[1] * format->shape[2] * format->shape[3];
+
+  t->output_size = minst_element_size(format);
+
+  switch (output) {
+    case MINST_OUTPUT_RAW:
+      break;
+    case MINST_OUTPUT_NATIVE:
+      if (!minst_is_big_endian()) {
+        t->swap = minst_get_bswap(minst_type_size(format->type));
+      }
+      break;
+    case MINST_OUTPUT_F32:
+      t->convert = minst_get_convert_f32(format->type);
+      if (t->convert == NULL) {
+        return MINST_ERR_UNKNOWN_TYPE;
+      }
+      /* (x * scale - mean) / std, folded into one multiply and add */
+      t->scale = scale / std;
+      t->bias = -mean / std;
+      t->output_size = t->values * ((uint32_t)sizeof(float));
+      break;
+    case MINST_OUTPUT_I32:
+    case MINST_OUTPUT_I64:
+      t->widen = minst_get_widen(format->type, (output == MINST_OUTPUT_I32) ? 4 : 8);
+      if (t->widen == NULL) {
+        return MINST_ERR_INVALID_ARGUMENT;
+      }
+      t->output_size = t->values * ((output == MINST_OUTPUT_I32) ? 4u : 8u);
+      break;
+    case MINST_OUTPUT_ONE_HOT:
+      t->widen = minst_get_widen(format->type, 4);
+      if ((t->widen == NULL) || (num_classes == 0) || !(smoothing >= 0.0f) || !(smoothing < 1.0f)) {
+        return MINST_ERR_INVALID_ARGUMENT;
+      }
+      t->num_classes = num_classes;
+      t->off_value = smoothing / (float)num_classes;
+      t->on_value = (1.0f - smoothing) + t->off_value;
+      t->output_size = t->values * num_classes * ((uint32_t)sizeof(float));
+      break;
+    default:
+      return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+static int
+minst_transform_active(const struct transform* t)
+{
+  return (t->convert != NULL) || (t->swap != NULL) || (t->widen != NULL);
+}
+
+/* Expands each value of an element into a one-hot vector. The background is written with one fill, after which only
+ * the entries of the classes are set. */
+static enum minst_error
+minst_one_hot(const struct transform* t, const uint8_t* src, const uint32_t value_size, float* dst)
+{
+  const size_t count = ((size_t)t->values) * t->num_classes;
+  int32_t label;
+  uint32_t i;
+  size_t j;
+
+  for (j = 0; j < count; j++) {
+    dst[j] = t->off_value;
+  }
+
+  for (i = 0; i < t->values; i++) {
+
+    t->widen(src + ((size_t)value_size) * i, &label, 1);
+
+    if ((label < 0) || (((uint32_t)label) >= t->num_classes)) {
+      return MINST_ERR_LABEL_RANGE;
+    }
+
+    dst[((size_t)t->num_classes) * i + (uint32_t)label] = t->on_value;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* The number of points along each axis of the coarse grid that elastic distortions are interpolated from. */
+#define MINST_ELASTIC_GRID 4
+
+/* The augmentations of a dataset, along with the kernels and the scratch memory of each worker. */
+struct augmentation
+{
+  struct minst_augment params;
+
+  int active;
+
+  uint64_t seed;
+
+  uint32_t width;
+
+  uint32_t height;
+
+  uint32_t channels;
+
+  minst_warp_func warp;
+
+  minst_noise_func noise;
+
+  /* one copy of a sample and one displacement field for each worker */
+  float* scratch;
+
+  size_t scratch_size;
+};
+
+static int
+minst_augment_enabled(const struct minst_augment* params)
+{
+  return (params->max_shift != 0) || (params->flip_probability != 0.0f) || (params->max_rotation != 0.0f) ||
+         (params->max_scale != 0.0f) || (params->max_shear != 0.0f) || (params->elastic_alpha != 0.0f) ||
+         (params->noise_std != 0.0f);
+}
+
+static int
+minst_augment_warps(const struct minst_augment* params)
+{
+  return (params->max_shift != 0) || (params->flip_probability != 0.0f) || (params->max_rotation != 0.0f) ||
+         (params->max_scale != 0.0f) || (params->max_shear != 0.0f) || (params->elastic_alpha != 0.0f);
+}
+
+static enum minst_error
+minst_augmentation_init(struct augmentation* a,
+                        const struct minst_augment* params,
+                        const struct minst_format* format,
+                        const enum minst_output output,
+                        const uint64_t seed,
+                        const uint32_t num_workers)
+{
+  size_t plane;
+
+  memset(a, 0, sizeof(*a));
+
+  if (!minst_augment_enabled(params)) {
+    return MINST_ERR_NONE;
+  }
+
+  if ((output != MINST_OUTPUT_F32) || (format->rank < 3)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  if ((params->flip_probability < 0.0f) || (params->flip_probability > 1.0f) || (params->max_scale < 0.0f) ||
+      (params->max_scale >= 1.0f) || (params->max_rotation < 0.0f) || (params->max_shear < 0.0f) ||
+      (params->elastic_alpha < 0.0f) || (params->noise_std < 0.0f)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  a->params = *params;
+  a->active = 1;
+
+  /* keeps the streams of the augmentation apart from those of the default sampler */
+  a->seed = seed ^ ((((uint64_t)0x9E3779B9u) << 32) | ((uint64_t)0x7F4A7C15u));
+
+  a->height = format->shape[1];
+  a->width = format->shape[2];
+  a->channels = format->shape[3];
+  a->warp = minst_get_warp();
+  a->noise = minst_get_noise();
+
+  plane = ((size_t)a->width) * a->height;
+
+  a->scratch_size = plane * a->channels + plane * 2;
+
+  a->scratch = minst_aligned_alloc(a->scratch_size * num_workers * sizeof(float));
+  if (a->scratch == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Generates a uniformly distributed number in [-max_v, max_v]. */
+static float
+minst_rng_symmetric(struct minst_rng* rng, const float max_v)
+{
+  const float u = ((float)(minst_rng_next(rng) >> 8)) * (1.0f / 16777216.0f);
+
+  return (u * 2.0f - 1.0f) * max_v;
+}
+
+/* Interpolates random displacements on a coarse grid into one plane of x offsets followed by one plane of y offsets. */
+static void
+minst_elastic_field(const struct augmentation* a, struct minst_rng* rng, float* field)
+{
+  float grid[2][MINST_ELASTIC_GRID][MINST_ELASTIC_GRID];
+  const size_t plane = ((size_t)a->width) * a->height;
+  const float x_step = (a->width > 1) ? (((float)(MINST_ELASTIC_GRID - 1)) / ((float)(a->width - 1))) : 0.0f;
+  const float y_step = (a->height > 1) ? (((float)(MINST_ELASTIC_GRID - 1)) / ((float)(a->height - 1))) : 0.0f;
+  uint32_t k;
+  uint32_t gx;
+  uint32_t gy;
+  uint32_t x;
+  uint32_t y;
+  float px;
+  float py;
+  float top;
+  float bottom;
+
+  for (k = 0; k < 2; k++) {
+    for (gy = 0; gy < MINST_ELASTIC_GRID; gy++) {
+      for (gx = 0; gx < MINST_ELASTIC_GRID; gx++) {
+        grid[k][gy][gx] = minst_rng_symmetric(rng, a->params.elastic_alpha);
+      }
+    }
+  }
+
+  for (y = 0; y < a->height; y++) {
+
+    py = ((float)y) * y_step;
+    gy = (uint32_t)py;
+    gy = (gy > MINST_ELASTIC_GRID - 2) ? (MINST_ELASTIC_GRID - 2) : gy;
+    py -= (float)gy;
+
+    for (x = 0; x < a->width; x++) {
+
+      px = ((float)x) * x_step;
+      gx = (uint32_t)px;
+      gx = (gx > MINST_ELASTIC_GRID - 2) ? (MINST_ELASTIC_GRID - 2) : gx;
+      px -= (float)gx;
+
+      for (k = 0; k < 2; k++) {
+        top = grid[k][gy][gx] + (grid[k][gy][gx + 1] - grid[k][gy][gx]) * px;
+        bottom = grid[k][gy + 1][gx] + (grid[k][gy + 1][gx + 1] - grid[k][gy + 1][gx]) * px;
+        field[k * plane + ((size_t)y) * a->width + x] = top + (bottom - top) * py;
+      }
+    }
+  }
+}
+
+/* Augments one sample in place. The random values only depend on the seed and the stream of the sample. */
+static void
+minst_augment_sample(const struct augmentation* a, float* sample, float* scratch, const uint64_t stream)
+{
+  const struct minst_augment* params = &a->params;
+  const float cx = ((float)(a->width - 1)) * 0.5f;
+  const float cy = ((float)(a->height - 1)) * 0.5f;
+  const size_t values = ((size_t)a->width) * a->height * a->channels;
+  struct minst_rng rng;
+  float matrix[6];
+  float* field;
+  float tx;
+  float ty;
+  float angle;
+  float scale;
+  float shear;
+  float c;
+  float s;
+
+  minst_rng_seed(&rng, a->seed, stream);
+
+  if (minst_augment_warps(params)) {
+
+    tx = 0.0f;
+    ty = 0.0f;
+
+    if (params->max_shift > 0) {
+      tx = (float)((int32_t)minst_rng_bounded(&rng, params->max_shift * 2 + 1) - (int32_t)params->max_shift);
+      ty = (float)((int32_t)minst_rng_bounded(&rng, params->max_shift * 2 + 1) - (int32_t)params->max_shift);
+    }
+
+    angle = minst_rng_symmetric(&rng, params->max_rotation);
+    scale = 1.0f + minst_rng_symmetric(&rng, params->max_scale);
+    shear = minst_rng_symmetric(&rng, params->max_shear);
+
+    /* the map from output to input pixels rotates, scales and shears around the center */
+    c = ((float)cos(angle)) / scale;
+    s = ((float)sin(angle)) / scale;
+
+    matrix[0] = c;
+    matrix[1] = c * shear - s;
+    matrix[3] = s;
+    matrix[4] = s * shear + c;
+
+    if ((params->flip_probability > 0.0f) && (minst_rng_symmetric(&rng, 0.5f) + 0.5f < params->flip_probability)) {
+      matrix[0] = -matrix[0];
+      matrix[3] = -matrix[3];
+    }
+
+    matrix[2] = cx - matrix[0] * cx - matrix[1] * cy - tx;
+    matrix[5] = cy - matrix[3] * cx - matrix[4] * cy - ty;
+
+    field = NULL;
+
+    if (params->elastic_alpha > 0.0f) {
+      field = scratch + values;
+      minst_elastic_field(a, &rng, field);
+    }
+
+    memcpy(scratch, sample, values * sizeof(float));
+
+    a->warp(scratch, sample, a->width, a->height, a->channels, matrix, field, params->fill);
+  }
+
+  if (params->noise_std > 0.0f) {
+    a->noise(sample, values, minst_rng_next(&rng), params->noise_std);
+  }
+}
+
+/* The layout of the samples of a batch, along with the strides used to move packed samples into it. */
+struct layout
+{
+  /* whether the layout differs from packed samples */
+  int active;
+
+  /* the size of one value, in bytes */
+  uint32_t value_size;
+
+  /* the shape of the packed samples */
+  uint32_t height;
+
+  uint32_t width;
+
+  uint32_t channels;
+
+  /* the position of the first value of a sample, past the padding */
+  size_t offset;
+
+  size_t row_stride;
+
+  size_t pixel_stride;
+
+  size_t channel_stride;
+
+  size_t sample_stride;
+
+  /* the alignment of the batch memory */
+  size_t alignment;
+
+  /* the shape and strides of the samples in memory order, as passed on with each batch */
+  uint8_t rank;
+
+  uint32_t shape[MINST_MAX_RANK];
+
+  size_t strides[MINST_MAX_RANK];
+};
+
+static int
+minst_is_alignment(const uint32_t alignment)
+{
+  return (alignment & (alignment - 1)) == 0;
+}
+
+static size_t
+minst_align(const size_t size, const uint32_t alignment)
+{
+  if (alignment <= 1) {
+    return size;
+  }
+
+  return (size + alignment - 1) & ~((size_t)alignment - 1);
+}
+
+static enum minst_error
+minst_layout_init(struct layout* l,
+                  const struct minst_layout* params,
+                  const struct minst_format* format,
+                  const struct transform* t)
+{
+  uint32_t i;
+  uint32_t height;
+  uint32_t width;
+  uint32_t channels;
+  size_t packed_row;
+  int padded;
+
+  memset(l, 0, sizeof(*l));
+
+  if ((params->pad_before[0] != 0) || (params->pad_after[0] != 0) || !minst_is_alignment(params->row_alignment) ||
+      !minst_is_alignment(params->sample_alignment)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  padded = 0;
+
+  for (i = 1; i < MINST_MAX_RANK; i++) {
+    if ((i >= format->rank) && ((params->pad_before[i] != 0) || (params->pad_after[i] != 0))) {
+      return MINST_ERR_INVALID_ARGUMENT;
+    }
+    padded |= (params->pad_before[i] != 0) || (params->pad_after[i] != 0);
+  }
+
+  if ((params->channel_order == MINST_CHANNELS_FIRST) && (format->rank < 3)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  l->value_size = t->output_size / t->values;
+  l->height = format->shape[1];
+  l->width = format->shape[2];
+  l->channels = format->shape[3];
+
+  height = l->height + params->pad_before[1] + params->pad_after[1];
+  width = l->width + params->pad_before[2] + params->pad_after[2];
+  channels = l->channels + params->pad_before[3] + params->pad_after[3];
+
+  /* only images have rows that can be aligned */
+  packed_row = ((size_t)width) * channels * l->value_size;
+
+  if (params->channel_order == MINST_CHANNELS_FIRST) {
+
+    l->rank = MINST_MAX_RANK;
+    l->shape[1] = channels;
+    l->shape[2] = height;
+    l->shape[3] = width;
+
+    l->pixel_stride = l->value_size;
+    l->row_stride = minst_align(((size_t)width) * l->value_size, params->row_alignment);
+    l->channel_stride = l->row_stride * height;
+
+    l->strides[1] = l->channel_stride;
+    l->strides[2] = l->row_stride;
+    l->strides[3] = l->pixel_stride;
+
+    l->sample_stride = l->channel_stride * channels;
+
+  } else {
+
+    l->rank = format->rank;
+    l->shape[1] = height;
+    l->shape[2] = width;
+    l->shape[3] = channels;
+
+    l->channel_stride = l->value_size;
+    l->pixel_stride = ((size_t)channels) * l->value_size;
+    l->row_stride = (format->rank >= 3) ? minst_align(packed_row, params->row_alignment) : packed_row;
+
+    l->strides[1] = l->row_stride;
+    l->strides[2] = l->pixel_stride;
+    l->strides[3] = l->channel_stride;
+
+    l->sample_stride = l->row_stride * height;
+  }
+
+  l->sample_stride = minst_align(l->sample_stride, params->sample_alignment);
+  l->strides[0] = l->sample_stride;
+
+  l->offset = params->pad_before[1] * l->row_stride + params->pad_before[2] * l->pixel_stride +
+              params->pad_before[3] * l->channel_stride;
+
+  l->alignment = MINST_ALIGNMENT;
+  l->alignment = (params->row_alignment > l->alignment) ? params->row_alignment : l->alignment;
+  l->alignment = (params->sample_alignment > l->alignment) ? params->sample_alignment : l->alignment;
+
+  l->active = (params->channel_order == MINST_CHANNELS_FIRST) || padded || (l->row_stride != packed_row) ||
+              (l->sample_stride != t->output_size);
+
+  return MINST_ERR_NONE;
+}
+
+/* Fills the memory of a batch with the padding value, which the packed samples are then written around. */
+static void
+minst_layout_fill(const struct layout* l,
+                  uint8_t* batch,
+                  const uint32_t batch_size,
+                  const int floats,
+                  const float value)
+{
+  const size_t size = l->sample_stride * batch_size;
+  size_t i;
+
+  if (!floats || (value == 0.0f)) {
+    memset(batch, 0, size);
+    return;
+  }
+
+  for (i = 0; i + sizeof(float) <= size; i += sizeof(float)) {
+    memcpy(batch + i, &value, sizeof(float));
+  }
+}
+
+/* Moves the values of one packed sample into its place in the batch. Whole rows or pixels are copied at once, unless
+ * the channels have to be split into planes. */
+static void
+minst_layout_apply(const struct layout* l, const uint8_t* src, uint8_t* dst)
+{
+  const size_t run = ((size_t)l->channels) * l->value_size;
+  uint32_t x;
+  uint32_t y;
+  uint32_t c;
+  uint8_t* row;
+
+  dst += l->offset;
+
+  if ((l->pixel_stride == run) && (l->row_stride == run * l->width)) {
+    memcpy(dst, src, l->row_stride * l->height);
+    return;
+  }
+
+  for (y = 0; y < l->height; y++) {
+
+    row = dst + l->row_stride * y;
+
+    if (l->pixel_stride == run) {
+      memcpy(row, src, run * l->width);
+      src += run * l->width;
+    } else if ((l->channels == 1) || (l->channel_stride == l->value_size)) {
+      for (x = 0; x < l->width; x++) {
+        memcpy(row + l->pixel_stride * x, src, run);
+        src += run;
+      }
+    } else {
+      for (x = 0; x < l->width; x++) {
+        for (c = 0; c < l->channels; c++) {
+          memcpy(row + l->pixel_stride * x + l->channel_stride * c, src, l->value_size);
+          src += l->value_size;
+        }
+      }
+    }
+  }
+}
+
+static void
+minst_layout_describe_batch(const struct layout* l, const uint32_t batch_size, struct minst_batch* batch)
+{
+  batch->sample_rank = l->rank;
+
+  memcpy(batch->sample_shape, l->shape, sizeof(batch->sample_shape));
+  memcpy(batch->sample_strides, l->strides, sizeof(batch->sample_strides));
+
+  batch->sample_shape[0] = batch_size;
+}
+
+enum minst_error
+minst_layout_describe(const struct minst_format* format,
+                      const enum minst_output output,
+                      const struct minst_layout* layout,
+                      const uint32_t batch_size,
+                      struct minst_batch* batch)
+{
+  struct minst_layout packed;
+  struct transform t;
+  struct layout l;
+  enum minst_error err;
+
+  memset(batch, 0, sizeof(*batch));
+
+  if (!layout) {
+    memset(&packed, 0, sizeof(packed));
+    layout = &packed;
+  }
+
+  err = minst_transform_init(&t, format, output, 1.0f, 0.0f, 1.0f, 0, 0.0f);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  err = minst_layout_init(&l, layout, format, &t);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  minst_layout_describe_batch(&l, batch_size, batch);
+
+  return MINST_ERR_NONE;
+}
+
+typedef enum minst_error (*source_read_func)(struct source*, long int, uint32_t, uint8_t*, struct minst_stats*);
+
+/* Gets one element of a file and transforms it. Elements of files that are in memory are transformed straight from the
+ * source, otherwise they are read into the raw buffer first. */
+static enum minst_error
+minst_gather_element(struct source* src,
+                     const struct minst_format* format,
+                     const struct transform* t,
+                     const uint32_t element_idx,
+                     uint8_t* raw,
+                     uint8_t* output,
+                     const source_read_func read_func,
+                     struct minst_stats* stats)
+{
+  enum minst_error error;
+  long int offset;
+  uint32_t size;
+  const uint8_t* span;
+  double start;
+
+  offset = minst_source_offset(src, format, element_idx);
+
+  size = minst_element_size(format);
+
+  start = stats ? minst_now() : 0.0;
+
+  if (src->data && minst_transform_active(t)) {
+
+    span = minst_source_span(src, offset, size);
+    if (span == NULL) {
+      return MINST_ERR_MISSING_DATA;
+    }
+
+  } else {
+
+    error = read_func(src, offset, size, raw, stats);
+    if (error != MINST_ERR_NONE) {
+      return error;
+    }
+
+    span = raw;
+  }
+
+  if (stats) {
+    stats->bytes_read += size;
+    stats->io_seconds += minst_now() - start;
+    start = minst_now();
+  }
+
+  error = MINST_ERR_NONE;
+
+  if (t->convert) {
+    t->convert(span, (float*)output, t->values, t->scale, t->bias);
+  } else if (t->swap) {
+    t->swap(span, output, t->values);
+  } else if (t->num_classes > 0) {
+    error = minst_one_hot(t, span, minst_type_size(format->type), (float*)output);
+  } else if (t->widen) {
+    t->widen(span, output, t->values);
+  }
+
+  if (stats) {
+    stats->convert_seconds += minst_now() - start;
+  }
+
+  return error;
+}
+
+/* The buffers of one batch. With prefetching, the dataset has a ring of these. */
+struct batch_slot
+{
+  uint8_t* sample_buffer;
+
+  uint8_t* label_buffer;
+
+  uint32_t* indices;
+
+  /* the files of each element, which is only allocated for datasets over a view */
+  struct view_files** files;
+
+  /* the batch elements, sorted by their position in the file */
+  struct read_order* order;
+
+  /* the transformed samples and labels, for those that are transformed */
+  uint8_t* sample_output;
+
+  uint8_t* label_output;
+
+  /* the samples in their final layout, if the layout is not packed */
+  uint8_t* sample_layout;
+
+  /* the batch data, which either points to the buffers or into a mapped file */
+  const uint8_t* samples;
+
+  const uint8_t* labels;
+
+  /* the augmentation stream of the first element of the batch */
+  uint64_t stream;
+
+  /* the number of elements in the batch, which is only less than the batch size for a partial last batch */
+  uint32_t size;
+
+  enum minst_error error;
+};
+
+struct minst_dataset
+{
+  struct source samples;
+
+  struct source labels;
+
+  /* the view that the elements are read from instead of the sources, if any */
+  const struct minst_view* view;
+
+  struct minst_format sample_format;
+
+  struct minst_format label_format;
+
+  uint32_t batch_size;
+
+  /* the number of batches in one epoch */
+  uint32_t num_batches;
+
+  /* the number of elements in the last batch of an epoch */
+  uint32_t last_batch_size;
+
+  /* the number of batches returned in the current epoch */
+  uint32_t batch_idx;
+
+  struct batch_slot* slots;
+
+  /* the slot of the first batch of the current epoch, which follows the slot of the last batch of the previous one */
+  uint32_t first_slot;
+
+  uint32_t num_slots;
+
+  struct transform sample_transform;
+
+  struct transform label_transform;
+
+  /* the slot that is currently being gathered by the worker pool */
+  struct batch_slot* gather_slot;
+
+  /* every kind of sampler is called through the batch interface */
+  void* sampler_data;
+
+  minst_batch_sampler sampler;
+
+  struct element_sampler elem_sampler;
+
+  struct default_sampler def_sampler;
+
+  struct sequential_sampler seq_sampler;
+
+  struct class_sampler class_sampler;
+
+  /* the number of epochs started before the current one */
+  uint64_t epoch;
+
+  struct augmentation augment;
+
+  struct layout layout;
+
+  /* only used when the dataset is split into several shards */
+  struct shard shard;
+
+  uint32_t num_shards;
+
+  struct worker_pool pool;
+
+  /* the first error encountered by each worker while gathering a batch */
+  enum minst_error* worker_errors;
+
+  /* where the statistics are stored when the dataset is closed, or null if none are collected */
+  struct minst_stats* stats_target;
+
+  /* the statistics of each worker, which is only allocated when statistics are collected */
+  struct minst_stats* worker_stats;
+
+  /* the statistics of the thread that produces the batches */
+  struct minst_stats producer_stats;
+
+  /* the statistics of the thread that opened the dataset and consumes the batches */
+  struct minst_stats consumer_stats;
+
+#ifdef MINST_HAVE_THREADS
+  /* whether or not batches are produced ahead of time on a background thread */
+  int prefetch;
+
+  pthread_t producer;
+
+  pthread_mutex_t mutex;
+
+  /* signaled when the producer may continue */
+  pthread_cond_t producer_cond;
+
+  /* signaled when a batch has been produced */
+  pthread_cond_t consumer_cond;
+
+  /* the number of batches produced in the current epoch */
+  uint32_t num_produced;
+
+  /* the number of batches the consumer is done with in the current epoch */
+  uint32_t num_released;
+
+  /* the number of slots the consumer still holds from the previous epoch, which is at most one */
+  uint32_t num_held;
+
+  /* whether or not the producer is working on a batch outside of the lock */
+  int producer_busy;
+
+  /* the statistics of the producer and the workers as of the last batch produced, guarded by the mutex */
+  struct minst_stats published_stats;
+
+  int quit;
+#endif
+};
+
+/* Adds up the statistics of the producer and the workers. Must only be called while the workers are idle. */
+static void
+minst_stats_collect(const struct minst_dataset* ds, struct minst_stats* stats)
+{
+  uint32_t worker_idx;
+
+  memset(stats, 0, sizeof(*stats));
+
+  minst_stats_add(stats, &ds->producer_stats);
+
+  for (worker_idx = 0; worker_idx < ds->pool.num_workers; worker_idx++) {
+    minst_stats_add(stats, &ds->worker_stats[worker_idx]);
+  }
+}
+
+/* Whether or not the elements of a dataset are read from memory, so that the order of the reads does not matter. */
+static int
+minst_dataset_in_memory(const struct minst_dataset* ds)
+{
+  return ds->view ? ds->view->in_memory : (ds->samples.data != NULL);
+}
+
+static enum minst_error
+minst_gather(struct minst_dataset* ds,
+             struct batch_slot* slot,
+             const uint32_t first,
+             const uint32_t last,
+             const int positional,
+             float* scratch,
+             struct minst_stats* stats)
+{
+  enum minst_error error;
+  uint32_t i;
+  uint32_t element_idx;
+  uint32_t batch_idx;
+  uint32_t sample_size;
+  uint32_t label_size;
+  uint8_t* sample;
+  struct source* samples;
+  struct source* labels;
+  source_read_func read_func;
+  double start;
+
+  sample_size = minst_element_size(&ds->sample_format);
+
+  label_size = minst_element_size(&ds->label_format);
+
+  /* the files of a view may be read by other datasets at the same time */
+  read_func = (positional || ds->view) ? minst_source_pread : minst_source_read;
+
+  for (i = first; i < last; i++) {
+
+    /* files that are not in memory are read in file order, so that the reads only move forward */
+    if (minst_dataset_in_memory(ds)) {
+      element_idx = slot->indices[i];
+      batch_idx = i;
+    } else {
+      element_idx = slot->order[i].element_idx;
+      batch_idx = slot->order[i].batch_idx;
+    }
+
+    samples = ds->view ? &slot->files[batch_idx]->samples : &ds->samples;
+    labels = ds->view ? &slot->files[batch_idx]->labels : &ds->labels;
+
+    error = minst_gather_element(samples,
+                                 &ds->sample_format,
+                                 &ds->sample_transform,
+                                 element_idx,
+                                 slot->sample_buffer + sample_size * batch_idx,
+                                 slot->sample_output + ds->sample_transform.output_size * batch_idx,
+                                 read_func,
+                                 stats);
+    if (error != MINST_ERR_NONE) {
+      return error;
+    }
+
+    sample = minst_transform_active(&ds->sample_transform)
+               ? (slot->sample_output + ds->sample_transform.output_size * batch_idx)
+               : (slot->sample_buffer + sample_size * batch_idx);
+
+    start = (stats && (ds->augment.active || ds->layout.active)) ? minst_now() : 0.0;
+
+    if (ds->augment.active) {
+      minst_augment_sample(&ds->augment, (float*)sample, scratch, slot->stream + batch_idx);
+    }
+
+    if (ds->layout.active) {
+      minst_layout_apply(&ds->layout, sample, slot->sample_layout + ds->layout.sample_stride * batch_idx);
+    }
+
+    if (stats && (ds->augment.active || ds->layout.active)) {
+      stats->convert_seconds += minst_now() - start;
+    }
+
+    error = minst_gather_element(labels,
+                                 &ds->label_format,
+                                 &ds->label_transform,
+                                 element_idx,
+                                 slot->label_buffer + label_size * batch_idx,
+                                 slot->label_output + ds->label_transform.output_size * batch_idx,
+                                 read_func,
+                                 stats);
+    if (error != MINST_ERR_NONE) {
+      return error;
+    }
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Each worker gathers its own disjoint range of batch slots. */
+static void
+minst_gather_task(void* task_data, const uint32_t worker_idx, const uint32_t num_workers)
+{
+  struct minst_dataset* ds;
+  uint32_t first;
+  uint32_t last;
+
+  ds = task_data;
+
+  first = (uint32_t)((((unsigned long)ds->gather_slot->size) * worker_idx) / num_workers);
+
+  last = (uint32_t)((((unsigned long)ds->gather_slot->size) * (worker_idx + 1)) / num_workers);
+
+  ds->worker_errors[worker_idx] = minst_gather(ds,
+                                               ds->gather_slot,
+                                               first,
+                                               last,
+                                               1,
+                                               ds->augment.scratch + ds->augment.scratch_size * worker_idx,
+                                               ds->worker_stats ? &ds->worker_stats[worker_idx] : NULL);
+}
+
+/* Loads the elements of one batch. If the elements are consecutive and both files are mapped, the batch points to the
+ * mapped data and nothing is copied. Otherwise, the elements are gathered into the batch buffers. */
+static enum minst_error
+minst_load_batch(struct minst_dataset* ds, struct batch_slot* slot)
+{
+  enum minst_error error;
+  uint32_t worker_idx;
+  uint32_t batch_idx;
+  const uint8_t* sample_span;
+  const uint8_t* label_span;
+  struct source* samples;
+  struct source* labels;
+  int contiguous;
+
+  contiguous = minst_is_contiguous(slot->indices, slot->size);
+
+  samples = &ds->samples;
+  labels = &ds->labels;
+
+  /* the elements of a view are only contiguous if they are also in the same files */
+  if (ds->view && (slot->size > 0)) {
+
+    for (batch_idx = 1; contiguous && (batch_idx < slot->size); batch_idx++) {
+      contiguous = slot->files[batch_idx] == slot->files[0];
+    }
+
+    samples = &slot->files[0]->samples;
+    labels = &slot->files[0]->labels;
+  }
+
+  if (!minst_transform_active(&ds->sample_transform) && !minst_transform_active(&ds->label_transform) &&
+      !ds->augment.active && !ds->layout.active && contiguous) {
+
+    sample_span = minst_source_span(samples,
+                                    minst_source_offset(samples, &ds->sample_format, slot->indices[0]),
+                                    ((size_t)minst_element_size(&ds->sample_format)) * slot->size);
+
+    label_span = minst_source_span(labels,
+                                   minst_source_offset(labels, &ds->label_format, slot->indices[0]),
+                                   ((size_t)minst_element_size(&ds->label_format)) * slot->size);
+
+    if (sample_span && label_span) {
+      if (ds->worker_stats) {
+        ds->worker_stats->bytes_read += ((uint64_t)minst_element_size(&ds->sample_format)) * slot->size;
+        ds->worker_stats->bytes_read += ((uint64_t)minst_element_size(&ds->label_format)) * slot->size;
+      }
+      slot->samples = sample_span;
+      slot->labels = label_span;
+      return MINST_ERR_NONE;
+    }
+  }
+
+  if (!minst_dataset_in_memory(ds)) {
+
+    for (batch_idx = 0; batch_idx < slot->size; batch_idx++) {
+      slot->order[batch_idx].element_idx = slot->indices[batch_idx];
+      slot->order[batch_idx].batch_idx = batch_idx;
+    }
+
+    qsort(slot->order, slot->size, sizeof(struct read_order), minst_compare_read_order);
+  }
+
+  if (ds->pool.num_workers > 1) {
+
+    ds->gather_slot = slot;
+
+    minst_pool_run(&ds->pool, minst_gather_task, ds);
+
+    for (worker_idx = 0; worker_idx < ds->pool.num_workers; worker_idx++) {
+      if (ds->worker_errors[worker_idx] != MINST_ERR_NONE) {
+        return ds->worker_errors[worker_idx];
+      }
+    }
+
+  } else {
+
+    error = minst_gather(ds, slot, 0, slot->size, 0, ds->augment.scratch, ds->worker_stats);
+    if (error != MINST_ERR_NONE) {
+      return error;
+    }
+  }
+
+  slot->samples = minst_transform_active(&ds->sample_transform) ? slot->sample_output : slot->sample_buffer;
+  slot->samples = ds->layout.active ? slot->sample_layout : slot->samples;
+  slot->labels = minst_transform_active(&ds->label_transform) ? slot->label_output : slot->label_buffer;
+
+  return MINST_ERR_NONE;
+}
+
+/* Samples the indices of the next batch and loads its elements into a slot. Each position in the global order of the
+ * epoch gets its own augmentation stream, so that augmentations do not depend on threading or prefetching and differ
+ * between ranks. Only a partial last batch asks the sampler for fewer elements than the batch size. */
+static enum minst_error
+minst_produce_batch(struct minst_dataset* ds, struct batch_slot* slot, const uint32_t batch_idx)
+{
+  uint32_t num_elements;
+  uint32_t i;
+  double start;
+  int result;
+
+  num_elements = ds->sample_format.shape[0];
+
+  /* the shard offset is zero without sharding, and keeps the ranks from repeating each other's augmentations */
+  slot->stream = (ds->epoch << 32) | (((uint64_t)ds->shard.offset) + (((uint64_t)batch_idx) * ds->batch_size));
+
+  slot->size = ((batch_idx + 1) < ds->num_batches) ? ds->batch_size : ds->last_batch_size;
+
+  start = ds->worker_stats ? minst_now() : 0.0;
+
+  if (ds->num_shards > 1) {
+
+    result = ds->sampler(ds->sampler_data, ds->shard.size, slot->size, slot->indices);
+    if (result == 0) {
+      minst_shard_map(&ds->shard, num_elements, slot->size, slot->indices);
+    }
+
+  } else {
+    result = ds->sampler(ds->sampler_data, num_elements, slot->size, slot->indices);
+  }
+
+  if (ds->worker_stats) {
+    ds->producer_stats.sampler_seconds += minst_now() - start;
+  }
+
+  if (result != 0) {
+    return MINST_ERR_SAMPLER;
+  }
+
+  if (ds->view) {
+    for (i = 0; i < slot->size; i++) {
+      if (slot->indices[i] >= num_elements) {
+        return MINST_ERR_SAMPLER;
+      }
+      minst_view_locate(ds->view, slot->indices[i], &slot->files[i], &slot->indices[i]);
+    }
+  }
+
+  return minst_load_batch(ds, slot);
+}
+
+#ifdef MINST_HAVE_THREADS
+
+/* Fills the ring of batch slots ahead of the consumer. The producer may fill batch i as long as it does not overwrite a
+ * batch the consumer still holds, which is the case while i < num_released + num_slots - num_held. */
+static void*
+minst_producer_main(void* dataset_ptr)
+{
+  struct minst_dataset* ds;
+  struct batch_slot* slot;
+  uint32_t batch_idx;
+
+  ds = dataset_ptr;
+
+  pthread_mutex_lock(&ds->mutex);
+
+  for (;;) {
+
+    while (!ds->quit &&
+           ((ds->num_produced >= ds->num_batches) ||
+            (ds->num_produced >= ds->num_released + ds->num_slots - ds->num_held))) {
+      pthread_cond_wait(&ds->producer_cond, &ds->mutex);
+    }
+
+    if (ds->quit) {
+      break;
+    }
+
+    batch_idx = ds->num_produced;
+
+    slot = &ds->slots[(ds->first_slot + batch_idx) % ds->num_slots];
+
+    ds->producer_busy = 1;
+
+    pthread_mutex_unlock(&ds->mutex);
+
+    slot->error = minst_produce_batch(ds, slot, batch_idx);
+
+    pthread_mutex_lock(&ds->mutex);
+
+    ds->producer_busy = 0;
+
+    /* the workers are idle between batches, so their counters can be copied for the consumer */
+    if (ds->worker_stats) {
+      minst_stats_collect(ds, &ds->published_stats);
+    }
+
+    /* after an error, there is nothing more to produce for this epoch */
+    ds->num_produced = (slot->error != MINST_ERR_NONE) ? ds->num_batches : (batch_idx + 1);
+
+    pthread_cond_broadcast(&ds->consumer_cond);
+  }
+
+  pthread_mutex_unlock(&ds->mutex);
+
+  return NULL;
+}
+
+static enum minst_error
+minst_start_producer(struct minst_dataset* ds)
+{
+  pthread_mutex_init(&ds->mutex, NULL);
+  pthread_cond_init(&ds->producer_cond, NULL);
+  pthread_cond_init(&ds->consumer_cond, NULL);
+
+  if (pthread_create(&ds->producer, NULL, minst_producer_main, ds) != 0) {
+    pthread_cond_destroy(&ds->consumer_cond);
+    pthread_cond_destroy(&ds->producer_cond);
+    pthread_mutex_destroy(&ds->mutex);
+    return MINST_ERR_THREAD;
+  }
+
+  ds->prefetch = 1;
+
+  return MINST_ERR_NONE;
+}
+
+static void
+minst_stop_producer(struct minst_dataset* ds)
+{
+  if (!ds->prefetch) {
+    return;
+  }
+
+  pthread_mutex_lock(&ds->mutex);
+  ds->quit = 1;
+  pthread_cond_broadcast(&ds->producer_cond);
+  pthread_mutex_unlock(&ds->mutex);
+
+  pthread_join(ds->producer, NULL);
+
+  pthread_cond_destroy(&ds->consumer_cond);
+  pthread_cond_destroy(&ds->producer_cond);
+  pthread_mutex_destroy(&ds->mutex);
+
+  ds->prefetch = 0;
+}
+
+#endif /* MINST_HAVE_THREADS */
+
+/* The default scale maps the range of integer types onto [0, 1] for unsigned types and [-1, 1) for signed types. */
+static float
+minst_default_scale(const enum minst_type type)
+{
+  switch (type) {
+    case MINST_TYPE_U8:
+      return 1.0f / 255.0f;
+    case MINST_TYPE_I8:
+      return 1.0f / 128.0f;
+    case MINST_TYPE_I16:
+      return 1.0f / 32768.0f;
+    case MINST_TYPE_I32:
+      return 1.0f / 2147483648.0f;
+    case MINST_TYPE_F32:
+    case MINST_TYPE_F64:
+      break;
+  }
+
+  return 1.0f;
+}
+
+void
+minst_options_init(struct minst_options* options)
+{
+  options->io_mode = MINST_IO_STDIO;
+  options->shuffle = 1;
+  options->num_threads = 1;
+  options->prefetch_depth = 0;
+  options->sample_output = MINST_OUTPUT_RAW;
+  options->sample_scale = 0.0f;
+  options->sample_mean = 0.0f;
+  options->sample_std = 1.0f;
+  options->label_output = MINST_OUTPUT_RAW;
+  options->num_classes = 0;
+  options->label_smoothing = 0.0f;
+  options->sampling = MINST_SAMPLING_UNIFORM;
+  options->class_weights = NULL;
+  options->seed = 0;
+  options->shuffle_mode = MINST_SHUFFLE_TABLE;
+  options->batch_sampler_data = NULL;
+  options->batch_sampler = NULL;
+  options->world_size = 1;
+  options->rank = 0;
+  options->shard_mode = MINST_SHARD_PAD;
+  options->tail_mode = MINST_TAIL_WRAP;
+  options->cache_path = NULL;
+  memset(&options->augment, 0, sizeof(options->augment));
+  memset(&options->sample_layout, 0, sizeof(options->sample_layout));
+  options->stats = NULL;
+}
+
+enum minst_error
+minst_eval(const char* samples_path,
+           const char* labels_path,
+           const struct minst_format* sample_format,
+           const struct minst_format* label_format,
+           const uint32_t batch_size,
+           void* callback_data,
+           const minst_callback callback,
+           void* sampler_data,
+           minst_sampler sampler)
+{
+  return minst_eval_ex(samples_path,
+                       labels_path,
+                       sample_format,
+                       label_format,
+                       batch_size,
+                       callback_data,
+                       callback,
+                       sampler_data,
+                       sampler,
+                       NULL);
+}
+
+/* Passes batches to a callback that does not take their size. */
+struct callback_adapter
+{
+  void* callback_data;
+
+  minst_callback callback;
+};
+
+static int
+minst_call_adapter(void* adapter_ptr, const void* sample, const void* label, const uint32_t count)
+{
+  const struct callback_adapter* adapter;
+
+  adapter = adapter_ptr;
+
+  (void)count;
+
+  return adapter->callback(adapter->callback_data, sample, label);
+}
+
+enum minst_error
+minst_eval_ex(const char* samples_path,
+              const char* labels_path,
+              const struct minst_format* sample_format,
+              const struct minst_format* label_format,
+              const uint32_t batch_size,
+              void* callback_data,
+              const minst_callback callback,
+              void* sampler_data,
+              minst_sampler sampler,
+              const struct minst_options* options)
+{
+  struct callback_adapter adapter;
+
+  adapter.callback_data = callback_data;
+  adapter.callback = callback;
+
+  return minst_eval_batches(samples_path,
+                            labels_path,
+                            sample_format,
+                            label_format,
+                            batch_size,
+                            &adapter,
+                            minst_call_adapter,
+                            sampler_data,
+                            sampler,
+                            options);
+}
+
+/* Passes every batch of one epoch of an opened dataset to the callback, and closes the dataset. */
+static enum minst_error
+minst_eval_dataset(struct minst_dataset* dataset, void* callback_data, minst_batch_callback callback)
+{
+  struct minst_batch batch;
+  enum minst_error err;
+  double start;
+  int result;
+
+  for (;;) {
+
+    err = minst_dataset_next_batch(dataset, &batch);
+    if ((err != MINST_ERR_NONE) || (batch.size == 0)) {
+      break;
+    }
+
+    start = dataset->worker_stats ? minst_now() : 0.0;
+
+    result = callback(callback_data, batch.samples, batch.labels, batch.size);
+
+    if (dataset->worker_stats) {
+      dataset->consumer_stats.callback_seconds += minst_now() - start;
+    }
+
+    if (result != 0) {
+      err = MINST_ERR_CALLBACK;
+      break;
+    }
+  }
+
+  minst_dataset_close(dataset);
+
+  return err;
+}
+
+enum minst_error
+minst_eval_batches(const char* samples_path,
+                   const char* labels_path,
+                   const struct minst_format* sample_format,
+                   const struct minst_format* label_format,
+                   const uint32_t batch_size,
+                   void* callback_data,
+                   minst_batch_callback callback,
+                   void* sampler_data,
+                   minst_sampler sampler,
+                   const struct minst_options* options)
+{
+  struct minst_dataset* dataset;
+  enum minst_error err;
+
+  err = minst_dataset_open(
+    &dataset, samples_path, labels_path, sample_format, label_format, batch_size, sampler_data, sampler, options);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  return minst_eval_dataset(dataset, callback_data, callback);
+}
+
+enum minst_error
+minst_eval_view(const struct minst_view* view,
+                const uint32_t batch_size,
+                void* callback_data,
+                minst_batch_callback callback,
+                void* sampler_data,
+                minst_sampler sampler,
+                const struct minst_options* options)
+{
+  struct minst_dataset* dataset;
+  enum minst_error err;
+
+  err = minst_dataset_open_view(&dataset, view, batch_size, sampler_data, sampler, options);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  return minst_eval_dataset(dataset, callback_data, callback);
+}
+
+/* Chooses the elements of a range in file order. The last batch is filled up by repeating the last element, which the
+ * evaluation leaves out. */
+struct range_sampler
+{
+  uint32_t next;
+
+  uint32_t last;
+};
+
+static int
+minst_range_sampler(void* sampler_data, const uint32_t num_elements, const uint32_t count, uint32_t* element_indices)
+{
+  struct range_sampler* data;
+  uint32_t i;
+
+  data = sampler_data;
+
+  (void)num_elements;
+
+  for (i = 0; i < count; i++) {
+    element_indices[i] = (data->next < data->last) ? data->next++ : (data->last - 1);
+  }
+
+  return 0;
+}
+
+/* What each evaluation thread needs to open the dataset and call the model. */
+struct eval_job
+{
+  const char* samples_path;
+
+  const char* labels_path;
+
+  const struct minst_format* sample_format;
+
+  const struct minst_format* label_format;
+
+  uint32_t batch_size;
+
+  uint32_t num_classes;
+
+  void* callback_data;
+
+  minst_predict_callback callback;
+
+  struct minst_options options;
+
+  /* the files opened once for all threads, or null when the threads read from a cache */
+  struct minst_view* view;
+};
+
+struct eval_worker
+{
+  const struct eval_job* job;
+
+  uint32_t thread_idx;
+
+  /* the sampler advances through the range once the dataset is open, so the size is kept on its own */
+  struct range_sampler range;
+
+  uint32_t num_elements;
+
+  /* the range of the shared files this thread reads, if they are shared */
+  struct minst_view* view;
+
+  /* opened before the threads start and closed by the thread once its range is done */
+  struct minst_dataset* dataset;
+
+  /* the confusion matrix of this thread, added to the result at the end */
+  uint64_t* confusion;
+
+  struct minst_stats stats;
+
+  enum minst_error error;
+
+#ifdef MINST_HAVE_THREADS
+  pthread_t thread;
+#endif
+};
+
+/* Opens the dataset of one thread. The threads either read ranges of the shared files, or each opens the cache. */
+static enum minst_error
+minst_eval_open(struct eval_worker* w)
+{
+  const struct eval_job* job = w->job;
+  struct minst_options options;
+  enum minst_error err;
+
+  if (w->num_elements == 0) {
+    return MINST_ERR_NONE;
+  }
+
+  options = job->options;
+  options.stats = job->options.stats ? &w->stats : NULL;
+
+  if (job->view) {
+
+    err = minst_view_range(&w->view, job->view, w->range.next, w->num_elements);
+    if (err != MINST_ERR_NONE) {
+      return err;
+    }
+
+    return minst_dataset_open_view(&w->dataset, w->view, job->batch_size, NULL, NULL, &options);
+  }
+
+  options.batch_sampler_data = &w->range;
+  options.batch_sampler = minst_range_sampler;
+
+  return minst_dataset_open(&w->dataset,
+                            job->samples_path,
+                            job->labels_path,
+                            job->sample_format,
+                            job->label_format,
+                            job->batch_size,
+                            NULL,
+                            NULL,
+                            &options);
+}
+
+static enum minst_error
+minst_eval_range(struct eval_worker* w)
+{
+  const struct eval_job* job = w->job;
+  struct minst_dataset* ds = w->dataset;
+  struct minst_batch batch;
+  enum minst_error err;
+  uint32_t* predictions;
+  const int32_t* labels;
+  uint32_t remaining;
+  uint32_t i;
+  double start;
+  int result;
+
+  if (ds == NULL) {
+    return MINST_ERR_NONE;
+  }
+
+  w->dataset = NULL;
+
+  remaining = w->num_elements;
+
+  predictions = malloc(((size_t)job->batch_size) * sizeof(uint32_t));
+  if (predictions == NULL) {
+    minst_dataset_close(ds);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  err = MINST_ERR_NONE;
+
+  while ((remaining > 0) && (err == MINST_ERR_NONE)) {
+
+    err = minst_dataset_next_batch(ds, &batch);
+    if ((err != MINST_ERR_NONE) || (batch.size == 0)) {
+      break;
+    }
+
+    batch.size = (remaining < batch.size) ? remaining : batch.size;
+
+    start = ds->worker_stats ? minst_now() : 0.0;
+
+    result = job->callback(job->callback_data, w->thread_idx, &batch, predictions);
+
+    if (ds->worker_stats) {
+      ds->consumer_stats.callback_seconds += minst_now() - start;
+    }
+
+    if (result != 0) {
+      err = MINST_ERR_CALLBACK;
+      break;
+    }
+
+    labels = batch.labels;
+
+    for (i = 0; i < batch.size; i++) {
+
+      if ((labels[i] < 0) || (((uint32_t)labels[i]) >= job->num_classes) || (predictions[i] >= job->num_classes)) {
+        err = MINST_ERR_LABEL_RANGE;
+        break;
+      }
+
+      w->confusion[((size_t)labels[i]) * job->num_classes + predictions[i]]++;
+    }
+
+    remaining -= batch.size;
+  }
+
+  minst_dataset_close(ds);
+
+  free(predictions);
+
+  return err;
+}
+
+#ifdef MINST_HAVE_THREADS
+
+static void*
+minst_eval_main(void* worker_ptr)
+{
+  struct eval_worker* w;
+
+  w = worker_ptr;
+
+  w->error = minst_eval_range(w);
+
+  return NULL;
+}
+
+#endif
+
+/* Adds up the confusion matrices of the threads and derives the scores from the total. */
+static void
+minst_eval_score(struct minst_eval_result* result, const struct eval_worker* workers, const uint32_t num_workers)
+{
+  const uint32_t n = result->num_classes;
+  uint64_t predicted;
+  uint64_t labeled;
+  uint32_t w;
+  uint32_t r;
+  uint32_t c;
+  size_t i;
+
+  for (w = 0; w < num_workers; w++) {
+    for (i = 0; i < ((size_t)n) * n; i++) {
+      result->confusion[i] += workers[w].confusion[i];
+    }
+  }
+
+  for (c = 0; c < n; c++) {
+
+    predicted = 0;
+    labeled = 0;
+
+    for (r = 0; r < n; r++) {
+      predicted += result->confusion[((size_t)r) * n + c];
+      labeled += result->confusion[((size_t)c) * n + r];
+    }
+
+    result->num_elements += labeled;
+    result->num_correct += result->confusion[((size_t)c) * n + c];
+
+    result->precision[c] = (predicted > 0) ? ((double)result->confusion[((size_t)c) * n + c]) / (double)predicted : 0.0;
+    result->recall[c] = (labeled > 0) ? ((double)result->confusion[((size_t)c) * n + c]) / (double)labeled : 0.0;
+  }
+
+  result->accuracy = (result->num_elements > 0) ? ((double)result->num_correct) / (double)result->num_elements : 0.0;
+}
+
+enum minst_error
+minst_evaluate(const char* samples_path,
+               const char* labels_path,
+               const struct minst_format* sample_format,
+               const struct minst_format* label_format,
+               const uint32_t batch_size,
+               const uint32_t num_classes,
+               const uint32_t num_threads,
+               void* callback_data,
+               minst_predict_callback callback,
+               const struct minst_options* options,
+               struct minst_eval_result* result)
+{
+  struct eval_job job;
+  struct eval_worker* workers;
+  enum minst_error err;
+  uint32_t num_elements;
+  uint32_t num_workers;
+  uint32_t w;
+
+  memset(result, 0, sizeof(*result));
+
+  if ((num_classes == 0) || (num_threads == 0) || (batch_size == 0) || (callback == NULL)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  /* the labels are scored as one integer per element */
+  if ((label_format->shape[1] != 1) || (label_format->shape[2] != 1) || (label_format->shape[3] != 1)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  if (options) {
+    job.options = *options;
+  } else {
+    minst_options_init(&job.options);
+  }
+
+  /* every element is visited once, in file order, with integer labels */
+  job.options.shuffle = 0;
+  job.options.sampling = MINST_SAMPLING_UNIFORM;
+  job.options.world_size = 1;
+  job.options.rank = 0;
+  job.options.label_output = MINST_OUTPUT_I32;
+  job.options.tail_mode = MINST_TAIL_PARTIAL;
+  memset(&job.options.augment, 0, sizeof(job.options.augment));
+
+  job.samples_path = samples_path;
+  job.labels_path = labels_path;
+  job.sample_format = sample_format;
+  job.label_format = label_format;
+  job.batch_size = batch_size;
+  job.num_classes = num_classes;
+  job.callback_data = callback_data;
+  job.callback = callback;
+  job.view = NULL;
+
+  num_elements = sample_format->shape[0];
+
+  /* no thread is started without elements to evaluate */
+  num_workers = ((num_elements > 0) && (num_threads > num_elements)) ? num_elements : num_threads;
+
+  result->num_classes = num_classes;
+  result->confusion = calloc(((size_t)num_classes) * num_classes, sizeof(uint64_t));
+  result->precision = calloc(num_classes, sizeof(double));
+  result->recall = calloc(num_classes, sizeof(double));
+  workers = calloc(num_workers, sizeof(struct eval_worker));
+
+  if (!result->confusion || !result->precision || !result->recall || !workers) {
+    free(workers);
+    minst_eval_result_free(result);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  err = MINST_ERR_NONE;
+
+  for (w = 0; w < num_workers; w++) {
+    workers[w].job = &job;
+    workers[w].thread_idx = w;
+    workers[w].range.next = (uint32_t)((((uint64_t)num_elements) * w) / num_workers);
+    workers[w].range.last = (uint32_t)((((uint64_t)num_elements) * (w + 1)) / num_workers);
+    workers[w].num_elements = workers[w].range.last - workers[w].range.next;
+    workers[w].confusion = calloc(((size_t)num_classes) * num_classes, sizeof(uint64_t));
+    if (workers[w].confusion == NULL) {
+      err = MINST_ERR_OUT_OF_MEMORY;
+    }
+  }
+
+  /* the files are opened, inflated or preloaded only once, and each thread reads its range of them */
+  if ((err == MINST_ERR_NONE) && !job.options.cache_path) {
+    err = minst_view_open(&job.view, samples_path, labels_path, sample_format, label_format, job.options.io_mode);
+  }
+
+  /* the datasets are opened before the threads start, so that a cache is checked and built only once */
+  for (w = 0; (w < num_workers) && (err == MINST_ERR_NONE); w++) {
+    err = minst_eval_open(&workers[w]);
+  }
+
+#ifdef MINST_HAVE_THREADS
+  for (w = 1; (w < num_workers) && (err == MINST_ERR_NONE); w++) {
+    if (pthread_create(&workers[w].thread, NULL, minst_eval_main, &workers[w]) != 0) {
+      err = MINST_ERR_THREAD;
+      break;
+    }
+  }
+
+  /* the calling thread evaluates the first range */
+  if (err == MINST_ERR_NONE) {
+    workers[0].error = minst_eval_range(&workers[0]);
+  }
+
+  while (w > 1) {
+    w--;
+    pthread_join(workers[w].thread, NULL);
+  }
+#else
+  for (w = 0; (w < num_workers) && (err == MINST_ERR_NONE); w++) {
+    workers[w].error = minst_eval_range(&workers[w]);
+  }
+#endif
+
+  for (w = 0; (w < num_workers) && (err == MINST_ERR_NONE); w++) {
+    err = workers[w].error;
+  }
+
+  if (err == MINST_ERR_NONE) {
+    minst_eval_score(result, workers, num_workers);
+  }
+
+  if (job.options.stats) {
+    memset(job.options.stats, 0, sizeof(struct minst_stats));
+    for (w = 0; w < num_workers; w++) {
+      minst_stats_add(job.options.stats, &workers[w].stats);
+    }
+  }
+
+  for (w = 0; w < num_workers; w++) {
+    minst_dataset_close(workers[w].dataset);
+    minst_view_close(workers[w].view);
+    free(workers[w].confusion);
+  }
+
+  minst_view_close(job.view);
+
+  free(workers);
+
+  if (err != MINST_ERR_NONE) {
+    minst_eval_result_free(result);
+  }
+
+  return err;
+}
+
+void
+minst_eval_result_free(struct minst_eval_result* result)
+{
+  free(result->confusion);
+  free(result->precision);
+  free(result->recall);
+
+  memset(result, 0, sizeof(*result));
+}
+
+/* The layout of the first page of a cache file. The fields are in the byte order of the machine that built the cache,
+ * which is checked with the byte order mark. */
+struct cache_header
+{
+  char magic[8];
+
+  uint32_t version;
+
+  uint32_t byte_order;
+
+  uint32_t sample_type;
+
+  uint32_t sample_rank;
+
+  uint32_t sample_shape[MINST_MAX_RANK];
+
+  uint32_t label_type;
+
+  uint32_t label_rank;
+
+  uint32_t label_shape[MINST_MAX_RANK];
+
+  uint32_t sample_output;
+
+  uint32_t label_output;
+
+  float sample_scale;
+
+  float sample_mean;
+
+  float sample_std;
+
+  uint32_t reserved;
+
+  /* everything from here on describes the dataset files and the cache contents, rather than the options */
+  uint64_t samples_size;
+
+  uint64_t samples_mtime;
+
+  uint64_t labels_size;
+
+  uint64_t labels_mtime;
+
+  uint64_t checksum;
+
+  uint64_t samples_offset;
+
+  uint64_t labels_offset;
+};
+
+#define MINST_CACHE_VERSION 1u
+
+/* The alignment of the header and the element blocks of a cache file, which is the page size on most systems. */
+#define MINST_CACHE_ALIGNMENT 4096u
+
+/* The number of elements converted at once while building a cache. */
+#define MINST_CACHE_BATCH_SIZE 1024u
+
+static const char minst_cache_magic[8] = { 'M', 'I', 'N', 'S', 'T', 'P', 'A', 'K' };
+
+/* Gets the format of the elements in the cache, which is the format of the dataset file converted to its output. */
+static struct minst_format
+minst_cache_format(const struct minst_format* format, const enum minst_output output)
+{
+  struct minst_format cache_format;
+
+  cache_format = *format;
+
+  if (output == MINST_OUTPUT_F32) {
+    cache_format.type = MINST_TYPE_F32;
+  }
+
+  return cache_format;
+}
+
+/* Gets the form in which elements are stored in a cache. Widened integers and one-hot labels would only make the cache
+ * larger, so those elements are stored as they are in the file and expanded when they are read. */
+static enum minst_output
+minst_cache_output(const enum minst_output output)
+{
+  switch (output) {
+    case MINST_OUTPUT_I32:
+    case MINST_OUTPUT_I64:
+    case MINST_OUTPUT_ONE_HOT:
+      return MINST_OUTPUT_RAW;
+    default:
+      break;
+  }
+
+  return output;
+}
+
+/* Gets the transform that is still needed after reading elements from a cache. */
+static enum minst_output
+minst_cache_read_output(const enum minst_output output)
+{
+  return (minst_cache_output(output) == output) ? MINST_OUTPUT_RAW : output;
+}
+
+static void
+minst_cache_header_init(struct cache_header* header,
+                        const struct minst_format* sample_format,
+                        const struct minst_format* label_format,
+                        const struct minst_options* options)
+{
+  uint32_t dim_idx;
+
+  memset(header, 0, sizeof(*header));
+
+  memcpy(header->magic, minst_cache_magic, sizeof(header->magic));
+
+  header->version = MINST_CACHE_VERSION;
+  header->byte_order = 0x01020304u;
+  header->sample_type = (uint32_t)sample_format->type;
+  header->sample_rank = sample_format->rank;
+  header->label_type = (uint32_t)label_format->type;
+  header->label_rank = label_format->rank;
+
+  for (dim_idx = 0; dim_idx < MINST_MAX_RANK; dim_idx++) {
+    header->sample_shape[dim_idx] = sample_format->shape[dim_idx];
+    header->label_shape[dim_idx] = label_format->shape[dim_idx];
+  }
+
+  header->sample_output = (uint32_t)minst_cache_output(options->sample_output);
+  header->label_output = (uint32_t)minst_cache_output(options->label_output);
+
+  /* the scale is stored after resolving the default, so that both ways of asking for it share a cache */
+  header->sample_scale =
+    (options->sample_scale != 0.0f) ? options->sample_scale : minst_default_scale(sample_format->type);
+
+  if (options->sample_output == MINST_OUTPUT_F32) {
+    header->sample_mean = options->sample_mean;
+    header->sample_std = options->sample_std;
+  } else {
+    header->sample_scale = 1.0f;
+    header->sample_mean = 0.0f;
+    header->sample_std = 1.0f;
+  }
+}
+
+/* Gets the size and modification time of a file, which are used to notice when a dataset file changes. */
+static int
+minst_file_stamp(const char* path, uint64_t* size, uint64_t* mtime)
+{
+#ifdef MINST_HAVE_MMAP
+  struct stat st;
+
+  if (stat(path, &st) != 0) {
+    return -1;
+  }
+
+  *size = (uint64_t)st.st_size;
+  *mtime = (uint64_t)st.st_mtime;
+
+#ifdef __linux__
+  /* files can change more than once per second */
+  *mtime = (*mtime * 1000000000u) + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+
+  return 0;
+#else
+  FILE* file;
+  long int file_size;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+
+  if ((fseek(file, 0, SEEK_END) != 0) || ((file_size = ftell(file)) < 0)) {
+    fclose(file);
+    return -1;
+  }
+
+  fclose(file);
+
+  *size = (uint64_t)file_size;
+  *mtime = 0;
+
+  return 0;
+#endif
+}
+
+/* Creates a file next to the path under a name that no other writer uses, so that processes and threads that write the
+ * same derived file at once do not write into each other. The file is moved over the path by @ref minst_temp_close. */
+static enum minst_error
+minst_temp_open(const char* path, FILE** file, char** tmp_path)
+{
+#ifdef MINST_HAVE_MMAP
+  int fd;
+#else
+  static unsigned long int counter = 0;
+  FILE* existing;
+  unsigned long int attempt;
+#endif
+
+  *file = NULL;
+
+  *tmp_path = malloc(strlen(path) + 32);
+  if (*tmp_path == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+#ifdef MINST_HAVE_MMAP
+  strcpy(*tmp_path, path);
+  strcat(*tmp_path, ".XXXXXX");
+
+  fd = mkstemp(*tmp_path);
+  if (fd < 0) {
+    free(*tmp_path);
+    *tmp_path = NULL;
+    return MINST_ERR_WRITE;
+  }
+
+  /* the file is created readable by its owner only, which is too strict for a file that others share */
+  (void)fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  *file = fdopen(fd, "wb");
+  if (*file == NULL) {
+    close(fd);
+    remove(*tmp_path);
+  }
+#else
+  /* without a way to create a file exclusively, names that are in use are skipped */
+  for (attempt = 0; (attempt < 1000) && (*file == NULL); attempt++) {
+    sprintf(*tmp_path, "%s.%lu.tmp", path, counter++);
+    existing = fopen(*tmp_path, "rb");
+    if (existing) {
+      fclose(existing);
+      continue;
+    }
+    *file = fopen(*tmp_path, "wb");
+  }
+#endif
+
+  if (*file == NULL) {
+    free(*tmp_path);
+    *tmp_path = NULL;
+    return MINST_ERR_WRITE;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Closes a file opened by @ref minst_temp_open and moves it over the path if it is complete, or removes it otherwise.
+ * Renaming replaces the path at once, so readers see either the previous file or the complete new one. */
+static enum minst_error
+minst_temp_close(FILE* file, char* tmp_path, const char* path, int complete)
+{
+  complete = (fclose(file) == 0) && complete;
+
+  if (complete) {
+#ifndef MINST_HAVE_MMAP
+    /* outside of POSIX, renaming does not have to replace an existing file */
+    remove(path);
+#endif
+    complete = rename(tmp_path, path) == 0;
+  }
+
+  if (!complete) {
+    remove(tmp_path);
+  }
+
+  free(tmp_path);
+
+  return complete ? MINST_ERR_NONE : MINST_ERR_WRITE;
+}
+
+/* Continues a 64-bit FNV-1a hash over the contents of a file. */
+static int
+minst_file_checksum(const char* path, uint64_t* checksum)
+{
+  FILE* file;
+  uint8_t buffer[16384];
+  size_t read_size;
+  size_t i;
+  uint64_t hash;
+  uint64_t prime;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+
+  /* 1099511628211, built from two halves to stay within C89 */
+  prime = (((uint64_t)0x100u) << 32) | ((uint64_t)0x1B3u);
+
+  hash = *checksum;
+
+  while ((read_size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    for (i = 0; i < read_size; i++) {
+      hash = (hash ^ buffer[i]) * prime;
+    }
+  }
+
+  fclose(file);
+
+  *checksum = hash;
+
+  return 0;
+}
+
+/* Hashes the contents of both dataset files. The labels path may be null, in which case only the samples count. */
+static int
+minst_sources_checksum(const char* samples_path, const char* labels_path, uint64_t* checksum)
+{
+  /* the FNV-1a offset basis, 14695981039346656037 */
+  *checksum = (((uint64_t)0xCBF29CE4u) << 32) | ((uint64_t)0x84222325u);
+
+  if (minst_file_checksum(samples_path, checksum) != 0) {
+    return -1;
+  }
+
+  if (labels_path && (minst_file_checksum(labels_path, checksum) != 0)) {
+    return -1;
+  }
+
+  return 0;
+}
+
+static int
+minst_cache_read_header(const char* cache_path, struct cache_header* header)
+{
+  FILE* file;
+  size_t read_count;
+
+  file = fopen(cache_path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+
+  read_count = fread(header, sizeof(*header), 1, file);
+
+  fclose(file);
+
+  return (read_count == 1) ? 0 : -1;
+}
+
+/* Reads the header of a file that was derived from the dataset files, such as a cache, and checks that it was made
+ * with the expected formats and options from dataset files with the same contents. The expected header must already
+ * hold the stamps of the dataset files. When only the stamps differ, the contents are compared by their checksum. The
+ * header is not updated with the new stamps, since other processes may be reading the file or replacing it, so the
+ * checksum is compared again next time. Returns zero if the file is current. */
+static int
+minst_derived_header_check(const char* path,
+                           const struct cache_header* expected,
+                           const char* samples_path,
+                           const char* labels_path,
+                           struct cache_header* header)
+{
+  uint64_t checksum;
+
+  if (minst_cache_read_header(path, header) != 0) {
+    return -1;
+  }
+
+  if (memcmp(header, expected, offsetof(struct cache_header, samples_size)) != 0) {
+    return -1;
+  }
+
+  if ((header->samples_size != expected->samples_size) || (header->samples_mtime != expected->samples_mtime) ||
+      (header->labels_size != expected->labels_size) || (header->labels_mtime != expected->labels_mtime)) {
+
+    /* the files were touched, but they may still have the same contents */
+    if ((minst_sources_checksum(samples_path, labels_path, &checksum) != 0) || (checksum != header->checksum)) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* Opens one block of a cache file. The block is read like a dataset file whose header has the size of the offset. */
+static enum minst_error
+minst_cache_open_block(struct source* src,
+                       const char* cache_path,
+                       const uint64_t offset,
+                       const struct minst_format* format)
+{
+  enum minst_error err;
+
+  src->file = NULL;
+  src->data = NULL;
+  src->size = 0;
+  src->preloaded = 0;
+  src->payload_offset = (long int)offset;
+
+#ifdef MINST_HAVE_ZLIB
+  src->gz = NULL;
+#endif
+
+#ifdef MINST_HAVE_MMAP
+  err = minst_source_map(src, cache_path, NULL, MINST_ERR_MISSING_DATA);
+#else
+  err = minst_source_preload(src, cache_path, NULL, MINST_ERR_MISSING_DATA);
+#endif
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  if (minst_source_span(src, src->payload_offset, ((size_t)minst_element_size(format)) * format->shape[0]) == NULL) {
+    minst_source_close(src);
+    return MINST_ERR_MISSING_DATA;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Opens the samples and labels of a cache file, building the cache first if it is missing or out of date. On success,
+ * the formats of the dataset are changed to the formats of the cached elements. */
+static enum minst_error
+minst_cache_open(struct minst_dataset* ds,
+                 const char* samples_path,
+                 const char* labels_path,
+                 const struct minst_options* options)
+{
+  struct cache_header expected;
+  struct cache_header header;
+  struct minst_format sample_format;
+  struct minst_format label_format;
+  enum minst_error err;
+  int attempt;
+
+  minst_cache_header_init(&expected, &ds->sample_format, &ds->label_format, options);
+
+  if (minst_file_stamp(samples_path, &expected.samples_size, &expected.samples_mtime) != 0) {
+    return MINST_ERR_OPEN_SAMPLES;
+  }
+
+  if (minst_file_stamp(labels_path, &expected.labels_size, &expected.labels_mtime) != 0) {
+    return MINST_ERR_OPEN_LABELS;
+  }
+
+  sample_format = minst_cache_format(&ds->sample_format, options->sample_output);
+
+  label_format = minst_cache_format(&ds->label_format, options->label_output);
+
+  for (attempt = 0; attempt < 2; attempt++) {
+
+    if (attempt > 0) {
+      err = minst_cache_build(
+        options->cache_path, samples_path, labels_path, &ds->sample_format, &ds->label_format, options);
+      if (err != MINST_ERR_NONE) {
+        return err;
+      }
+    }
+
+    if (minst_derived_header_check(options->cache_path, &expected, samples_path, labels_path, &header) != 0) {
+      continue;
+    }
+
+    err = minst_cache_open_block(&ds->samples, options->cache_path, header.samples_offset, &sample_format);
+    if (err != MINST_ERR_NONE) {
+      return err;
+    }
+
+    err = minst_cache_open_block(&ds->labels, options->cache_path, header.labels_offset, &label_format);
+    if (err != MINST_ERR_NONE) {
+      return err;
+    }
+
+    ds->sample_format = sample_format;
+    ds->label_format = label_format;
+
+    return MINST_ERR_NONE;
+  }
+
+  return MINST_ERR_MISSING_DATA;
+}
+
+/* Opens a dataset over either a pair of files or a view. The paths are only used without a view. */
+static enum minst_error
+minst_dataset_init(struct minst_dataset** dataset,
+                   const char* samples_path,
+                   const char* labels_path,
+                   const struct minst_view* view,
+                   const struct minst_format* sample_format,
+                   const struct minst_format* label_format,
+                   const uint32_t batch_size,
+                   void* sampler_data,
+                   minst_sampler sampler,
+                   const struct minst_options* options)
+{
+  struct minst_dataset* ds;
+  struct minst_options default_options;
+  enum minst_error err;
+  uint32_t num_elements;
+  uint32_t num_workers;
+  uint32_t slot_idx;
+  struct batch_slot* slot;
+  int sequential;
+  double start;
+
+  *dataset = NULL;
+
+  if (!options) {
+    minst_options_init(&default_options);
+    options = &default_options;
+  }
+
+  start = options->stats ? minst_now() : 0.0;
+
+  if ((batch_size == 0) || (options->num_threads == 0) || (options->sample_std == 0.0f)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  if ((options->world_size == 0) || (options->rank >= options->world_size)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  /* a cache is built from a pair of files */
+  if (view && options->cache_path) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  ds = calloc(1, sizeof(struct minst_dataset));
+  if (ds == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  minst_pool_init(&ds->pool, 1);
+
+  ds->view = view;
+  ds->sample_format = *sample_format;
+  ds->label_format = *label_format;
+  ds->batch_size = batch_size;
+  ds->num_shards = options->world_size;
+
+  if (ds->num_shards > 1) {
+    minst_shard_init(&ds->shard, sample_format->shape[0], options->world_size, options->rank, options->shard_mode);
+    num_elements = ds->shard.size;
+  } else {
+    num_elements = sample_format->shape[0];
+  }
+
+  ds->num_batches = (num_elements / batch_size) + (((num_elements % batch_size) != 0) ? 1 : 0);
+  ds->last_batch_size = batch_size;
+
+  if ((num_elements % batch_size) != 0) {
+    if (options->tail_mode == MINST_TAIL_DROP) {
+      ds->num_batches--;
+    } else if (options->tail_mode == MINST_TAIL_PARTIAL) {
+      ds->last_batch_size = num_elements % batch_size;
+    }
+  }
+
+  if (options->batch_sampler) {
+    ds->sampler_data = options->batch_sampler_data;
+    ds->sampler = options->batch_sampler;
+  } else if (sampler) {
+    ds->elem_sampler.sampler_data = sampler_data;
+    ds->elem_sampler.sampler = sampler;
+    ds->sampler_data = &ds->elem_sampler;
+    ds->sampler = minst_element_sampler;
+  } else if (options->sampling != MINST_SAMPLING_UNIFORM) {
+    err = minst_class_sampler_init(&ds->class_sampler,
+                                   options->sampling,
+                                   options->seed,
+                                   options->class_weights,
+                                   labels_path,
+                                   view,
+                                   label_format,
+                                   options->num_classes,
+                                   &ds->shard,
+                                   num_elements);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+    ds->sampler_data = &ds->class_sampler;
+    ds->sampler = minst_class_sampler;
+  } else if (options->shuffle && (ds->num_shards > 1)) {
+    /* the shard walks through its range of the global permutation in order */
+    ds->shard.shuffle = 1;
+    ds->shard.seed = options->seed;
+    minst_permutation_init(&ds->shard.perm, sample_format->shape[0], ds->shard.seed, ds->shard.epoch);
+    ds->sampler_data = &ds->seq_sampler;
+    ds->sampler = minst_sequential_sampler;
+  } else if (options->shuffle) {
+    ds->def_sampler.mode = options->shuffle_mode;
+    ds->def_sampler.seed = options->seed;
+    ds->sampler_data = &ds->def_sampler;
+    ds->sampler = minst_default_sampler;
+  } else {
+    ds->sampler_data = &ds->seq_sampler;
+    ds->sampler = minst_sequential_sampler;
+  }
+
+  if (options->cache_path) {
+
+    err = minst_cache_open(ds, samples_path, labels_path, options);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+
+    /* the cached elements are already in their output form, unless they are widened when read */
+    err = minst_transform_init(&ds->sample_transform,
+                               &ds->sample_format,
+                               minst_cache_read_output(options->sample_output),
+                               1.0f,
+                               0.0f,
+                               1.0f,
+                               0,
+                               0.0f);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+
+    err = minst_transform_init(&ds->label_transform,
+                               &ds->label_format,
+                               minst_cache_read_output(options->label_output),
+                               1.0f,
+                               0.0f,
+                               1.0f,
+                               options->num_classes,
+                               options->label_smoothing);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+
+  } else {
+    err = minst_transform_init(&ds->sample_transform,
+                               sample_format,
+                               options->sample_output,
+                               (options->sample_scale != 0.0f) ? options->sample_scale
+                                                               : minst_default_scale(sample_format->type),
+                               options->sample_mean,
+                               options->sample_std,
+                               0,
+                               0.0f);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+
+    /* labels are never normalized */
+    err = minst_transform_init(&ds->label_transform,
+                               label_format,
+                               options->label_output,
+                               1.0f,
+                               0.0f,
+                               1.0f,
+                               options->num_classes,
+                               options->label_smoothing);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+
+  }
+
+  /* the files of a view are already open */
+  if (!view && !options->cache_path) {
+
+    /* only the sequential sampler reads the files from start to end */
+    sequential =
+      !options->batch_sampler && !sampler && !options->shuffle && (options->sampling == MINST_SAMPLING_UNIFORM);
+
+    err = minst_source_open(
+      &ds->samples, samples_path, sample_format, options->io_mode, sequential, MINST_ERR_OPEN_SAMPLES);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+
+    err = minst_source_open(
+      &ds->labels, labels_path, label_format, options->io_mode, sequential, MINST_ERR_OPEN_LABELS);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+  }
+
+  err = minst_layout_init(&ds->layout, &options->sample_layout, &ds->sample_format, &ds->sample_transform);
+  if (err != MINST_ERR_NONE) {
+    minst_dataset_close(ds);
+    return err;
+  }
+
+  /* one slot is held by the consumer while the producer fills the others */
+#ifdef MINST_HAVE_THREADS
+  ds->num_slots = options->prefetch_depth + 1;
+#else
+  ds->num_slots = 1;
+#endif
+
+  ds->slots = calloc(ds->num_slots, sizeof(struct batch_slot));
+  if (ds->slots == NULL) {
+    ds->num_slots = 0;
+    minst_dataset_close(ds);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  for (slot_idx = 0; slot_idx < ds->num_slots; slot_idx++) {
+
+    slot = &ds->slots[slot_idx];
+
+    slot->sample_buffer = malloc(batch_size * minst_element_size(&ds->sample_format));
+    slot->label_buffer = malloc(batch_size * minst_element_size(&ds->label_format));
+    slot->indices = malloc(batch_size * sizeof(uint32_t));
+    slot->order = malloc(batch_size * sizeof(struct read_order));
+
+    if (view) {
+      slot->files = malloc(batch_size * sizeof(struct view_files*));
+      if (slot->files == NULL) {
+        minst_dataset_close(ds);
+        return MINST_ERR_OUT_OF_MEMORY;
+      }
+    }
+
+    if (minst_transform_active(&ds->sample_transform)) {
+      slot->sample_output = minst_aligned_alloc(((size_t)batch_size) * ds->sample_transform.output_size);
+      if (slot->sample_output == NULL) {
+        minst_dataset_close(ds);
+        return MINST_ERR_OUT_OF_MEMORY;
+      }
+    }
+
+    if (minst_transform_active(&ds->label_transform)) {
+      slot->label_output = minst_aligned_alloc(((size_t)batch_size) * ds->label_transform.output_size);
+      if (slot->label_output == NULL) {
+        minst_dataset_close(ds);
+        return MINST_ERR_OUT_OF_MEMORY;
+      }
+    }
+
+    if (ds->layout.active) {
+      slot->sample_layout = minst_aligned_alloc_ex(ds->layout.sample_stride * batch_size, ds->layout.alignment);
+      if (slot->sample_layout == NULL) {
+        minst_dataset_close(ds);
+        return MINST_ERR_OUT_OF_MEMORY;
+      }
+      minst_layout_fill(&ds->layout,
+                        slot->sample_layout,
+                        batch_size,
+                        options->sample_output == MINST_OUTPUT_F32,
+                        options->sample_layout.pad_value);
+    }
+
+    if ((slot->sample_buffer == NULL) || (slot->label_buffer == NULL) || (slot->indices == NULL) ||
+        (slot->order == NULL)) {
+      minst_dataset_close(ds);
+      return MINST_ERR_OUT_OF_MEMORY;
+    }
+  }
+
+  ds->worker_errors = malloc(options->num_threads * sizeof(enum minst_error));
+  if (ds->worker_errors == NULL) {
+    minst_dataset_close(ds);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  if (options->stats) {
+    ds->worker_stats = calloc(options->num_threads, sizeof(struct minst_stats));
+    if (ds->worker_stats == NULL) {
+      minst_dataset_close(ds);
+      return MINST_ERR_OUT_OF_MEMORY;
+    }
+    ds->stats_target = options->stats;
+  }
+
+  /* there is no point in having more workers than batch slots, and a compressed stream can only be read by one */
+  num_workers = (options->num_threads < batch_size) ? options->num_threads : batch_size;
+
+#ifdef MINST_HAVE_ZLIB
+  if (ds->samples.gz || ds->labels.gz) {
+    num_workers = 1;
+  }
+#endif
+
+  err = minst_pool_init(&ds->pool, num_workers);
+  if (err != MINST_ERR_NONE) {
+    minst_dataset_close(ds);
+    return err;
+  }
+
+  err = minst_augmentation_init(
+    &ds->augment, &options->augment, &ds->sample_format, options->sample_output, options->seed, num_workers);
+  if (err != MINST_ERR_NONE) {
+    minst_dataset_close(ds);
+    return err;
+  }
+
+  if (ds->worker_stats) {
+    /* a preloaded or inflated file is read all at once */
+    if (ds->samples.preloaded) {
+      ds->consumer_stats.bytes_read += ds->samples.size;
+      ds->consumer_stats.num_reads++;
+    }
+    if (ds->labels.preloaded) {
+      ds->consumer_stats.bytes_read += ds->labels.size;
+      ds->consumer_stats.num_reads++;
+    }
+    ds->consumer_stats.open_seconds = minst_now() - start;
+  }
+
+#ifdef MINST_HAVE_THREADS
+  if (options->prefetch_depth > 0) {
+    err = minst_start_producer(ds);
+    if (err != MINST_ERR_NONE) {
+      minst_dataset_close(ds);
+      return err;
+    }
+  }
+#endif
+
+  *dataset = ds;
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_dataset_open(struct minst_dataset** dataset,
+                   const char* samples_path,
+                   const char* labels_path,
+                   const struct minst_format* sample_format,
+                   const struct minst_format* label_format,
+                   const uint32_t batch_size,
+                   void* sampler_data,
+                   minst_sampler sampler,
+                   const struct minst_options* options)
+{
+  return minst_dataset_init(
+    dataset, samples_path, labels_path, NULL, sample_format, label_format, batch_size, sampler_data, sampler, options);
+}
+
+enum minst_error
+minst_dataset_open_view(struct minst_dataset** dataset,
+                        const struct minst_view* view,
+                        const uint32_t batch_size,
+                        void* sampler_data,
+                        minst_sampler sampler,
+                        const struct minst_options* options)
+{
+  return minst_dataset_init(dataset,
+                            NULL,
+                            NULL,
+                            view,
+                            &view->sample_format,
+                            &view->label_format,
+                            batch_size,
+                            sampler_data,
+                            sampler,
+                            options);
+}
+
+void
+minst_dataset_close(struct minst_dataset* dataset)
+{
+  uint32_t slot_idx;
+
+  if (!dataset) {
+    return;
+  }
+
+#ifdef MINST_HAVE_THREADS
+  minst_stop_producer(dataset);
+#endif
+
+  if (dataset->worker_stats) {
+    minst_dataset_stats(dataset, dataset->stats_target);
+  }
+
+  minst_pool_destroy(&dataset->pool);
+
+  for (slot_idx = 0; slot_idx < dataset->num_slots; slot_idx++) {
+    minst_aligned_free(dataset->slots[slot_idx].sample_layout);
+    minst_aligned_free(dataset->slots[slot_idx].label_output);
+    minst_aligned_free(dataset->slots[slot_idx].sample_output);
+    free(dataset->slots[slot_idx].order);
+    free(dataset->slots[slot_idx].files);
+    free(dataset->slots[slot_idx].indices);
+    free(dataset->slots[slot_idx].label_buffer);
+    free(dataset->slots[slot_idx].sample_buffer);
+  }
+
+  minst_aligned_free(dataset->augment.scratch);
+  free(dataset->slots);
+  free(dataset->worker_errors);
+  free(dataset->worker_stats);
+  free(dataset->def_sampler.indices);
+  minst_class_sampler_free(&dataset->class_sampler);
+
+  minst_source_close(&dataset->labels);
+  minst_source_close(&dataset->samples);
+
+  free(dataset);
+}
+
+void
+minst_dataset_stats(struct minst_dataset* dataset, struct minst_stats* stats)
+{
+  memset(stats, 0, sizeof(*stats));
+
+  if (!dataset->worker_stats) {
+    return;
+  }
+
+#ifdef MINST_HAVE_THREADS
+  if (dataset->prefetch) {
+    pthread_mutex_lock(&dataset->mutex);
+    *stats = dataset->published_stats;
+    pthread_mutex_unlock(&dataset->mutex);
+  } else {
+    minst_stats_collect(dataset, stats);
+  }
+#else
+  minst_stats_collect(dataset, stats);
+#endif
+
+  minst_stats_add(stats, &dataset->consumer_stats);
+}
+
+uint32_t
+minst_dataset_num_batches(const struct minst_dataset* dataset)
+{
+  return dataset->num_batches;
+}
+
+enum minst_error
+minst_dataset_next_epoch(struct minst_dataset* dataset)
+{
+#ifdef MINST_HAVE_THREADS
+  if (dataset->prefetch) {
+
+    pthread_mutex_lock(&dataset->mutex);
+
+    /* the producer must not be using the sampler while it is reset */
+    while (dataset->producer_busy) {
+      pthread_cond_wait(&dataset->consumer_cond, &dataset->mutex);
+    }
+
+    dataset->num_produced = 0;
+    dataset->num_released = 0;
+
+    /* the last batch returned stays valid until the next batch is requested, so its slot is left out of the ring */
+    if (dataset->batch_idx > 0) {
+      dataset->num_held = 1;
+    }
+  }
+#endif
+
+  dataset->first_slot = (dataset->first_slot + dataset->batch_idx) % dataset->num_slots;
+  dataset->batch_idx = 0;
+  dataset->epoch++;
+
+  if (dataset->sampler == minst_default_sampler) {
+    minst_default_sampler_next_epoch(&dataset->def_sampler);
+  } else if (dataset->sampler == minst_sequential_sampler) {
+    dataset->seq_sampler.idx = 0;
+  } else if (dataset->sampler == minst_class_sampler) {
+    minst_class_sampler_next_epoch(&dataset->class_sampler);
+  }
+
+  if (dataset->shard.shuffle) {
+    dataset->shard.epoch++;
+    minst_permutation_init(
+      &dataset->shard.perm, dataset->sample_format.shape[0], dataset->shard.seed, dataset->shard.epoch);
+  }
+
+#ifdef MINST_HAVE_THREADS
+  if (dataset->prefetch) {
+    pthread_cond_signal(&dataset->producer_cond);
+    pthread_mutex_unlock(&dataset->mutex);
+  }
+#endif
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_dataset_next_batch(struct minst_dataset* dataset, struct minst_batch* batch)
+{
+  struct batch_slot* slot;
+  double start;
+
+  batch->samples = NULL;
+  batch->labels = NULL;
+  batch->size = 0;
+
+  if (dataset->batch_idx >= dataset->num_batches) {
+    return MINST_ERR_NONE;
+  }
+
+  slot = &dataset->slots[(dataset->first_slot + dataset->batch_idx) % dataset->num_slots];
+
+  start = dataset->worker_stats ? minst_now() : 0.0;
+
+#ifdef MINST_HAVE_THREADS
+  if (dataset->prefetch) {
+
+    pthread_mutex_lock(&dataset->mutex);
+
+    /* the batch returned by the previous call is recycled now, even if it is from the previous epoch */
+    dataset->num_released = dataset->batch_idx;
+    dataset->num_held = 0;
+
+    pthread_cond_signal(&dataset->producer_cond);
+
+    while (dataset->num_produced <= dataset->batch_idx) {
+      pthread_cond_wait(&dataset->consumer_cond, &dataset->mutex);
+    }
+
+    pthread_mutex_unlock(&dataset->mutex);
+
+  } else {
+    slot->error = minst_produce_batch(dataset, slot, dataset->batch_idx);
+  }
+#else
+  slot->error = minst_produce_batch(dataset, slot, dataset->batch_idx);
+#endif
+
+  if (slot->error != MINST_ERR_NONE) {
+    /* the rest of the epoch is lost */
+    dataset->batch_idx = dataset->num_batches;
+    return slot->error;
+  }
+
+  dataset->batch_idx++;
+
+  batch->samples = slot->samples;
+  batch->labels = slot->labels;
+  batch->size = slot->size;
+
+  minst_layout_describe_batch(&dataset->layout, slot->size, batch);
+
+  if (dataset->worker_stats) {
+    minst_stats_latency(&dataset->consumer_stats, minst_now() - start);
+  }
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_cache_build(const char* cache_path,
+                  const char* samples_path,
+                  const char* labels_path,
+                  const struct minst_format* sample_format,
+                  const struct minst_format* label_format,
+                  const struct minst_options* options)
+{
+  struct minst_options build_options;
+  struct minst_dataset* ds;
+  struct minst_batch batch;
+  struct cache_header header;
+  struct minst_format cache_sample_format;
+  struct minst_format cache_label_format;
+  uint8_t* page;
+  char* tmp_path;
+  FILE* file;
+  enum minst_error err;
+  enum minst_error write_err;
+  uint32_t sample_size;
+  uint32_t label_size;
+  uint32_t num_written;
+  uint32_t count;
+  int write_failed;
+
+  if (options) {
+    build_options = *options;
+  } else {
+    minst_options_init(&build_options);
+  }
+
+  /* the elements are converted in file order, by a dataset that reads the files themselves */
+  build_options.cache_path = NULL;
+  build_options.shuffle = 0;
+  build_options.sampling = MINST_SAMPLING_UNIFORM;
+  build_options.world_size = 1;
+  build_options.rank = 0;
+  build_options.batch_sampler = NULL;
+  build_options.batch_sampler_data = NULL;
+  build_options.stats = NULL;
+  build_options.tail_mode = MINST_TAIL_PARTIAL;
+  memset(&build_options.augment, 0, sizeof(build_options.augment));
+  memset(&build_options.sample_layout, 0, sizeof(build_options.sample_layout));
+  build_options.sample_output = minst_cache_output(build_options.sample_output);
+  build_options.label_output = minst_cache_output(build_options.label_output);
+
+  minst_cache_header_init(&header, sample_format, label_format, &build_options);
+
+  if (minst_file_stamp(samples_path, &header.samples_size, &header.samples_mtime) != 0) {
+    return MINST_ERR_OPEN_SAMPLES;
+  }
+
+  if (minst_file_stamp(labels_path, &header.labels_size, &header.labels_mtime) != 0) {
+    return MINST_ERR_OPEN_LABELS;
+  }
+
+  if (minst_sources_checksum(samples_path, labels_path, &header.checksum) != 0) {
+    return MINST_ERR_OPEN_SAMPLES;
+  }
+
+  cache_sample_format = minst_cache_format(sample_format, build_options.sample_output);
+  cache_label_format = minst_cache_format(label_format, build_options.label_output);
+
+  sample_size = minst_element_size(&cache_sample_format);
+  label_size = minst_element_size(&cache_label_format);
+
+  header.samples_offset = MINST_CACHE_ALIGNMENT;
+  header.labels_offset = header.samples_offset + ((uint64_t)sample_size) * sample_format->shape[0];
+  header.labels_offset = (header.labels_offset + MINST_CACHE_ALIGNMENT - 1) & ~((uint64_t)(MINST_CACHE_ALIGNMENT - 1));
+
+  err = minst_dataset_open(&ds,
+                           samples_path,
+                           labels_path,
+                           sample_format,
+                           label_format,
+                           MINST_CACHE_BATCH_SIZE,
+                           NULL,
+                           NULL,
+                           &build_options);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  page = calloc(1, MINST_CACHE_ALIGNMENT);
+  if (page == NULL) {
+    minst_dataset_close(ds);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  /* ranks and threads that share a cache may build it at the same time */
+  err = minst_temp_open(cache_path, &file, &tmp_path);
+  if (err != MINST_ERR_NONE) {
+    free(page);
+    minst_dataset_close(ds);
+    return err;
+  }
+
+  memcpy(page, &header, sizeof(header));
+
+  write_failed = (fwrite(page, MINST_CACHE_ALIGNMENT, 1, file) != 1);
+
+  num_written = 0;
+
+  while (!write_failed && ((err = minst_dataset_next_batch(ds, &batch)) == MINST_ERR_NONE) && (batch.size > 0)) {
+
+    count = batch.size;
+
+    write_failed =
+      (fseek(file, (long int)(header.samples_offset + ((uint64_t)sample_size) * num_written), SEEK_SET) != 0) ||
+      (fwrite(batch.samples, sample_size, count, file) != count) ||
+      (fseek(file, (long int)(header.labels_offset + ((uint64_t)label_size) * num_written), SEEK_SET) != 0) ||
+      (fwrite(batch.labels, label_size, count, file) != count);
+
+    num_written += count;
+  }
+
+  minst_dataset_close(ds);
+
+  free(page);
+
+  write_err = minst_temp_close(file, tmp_path, cache_path, (err == MINST_ERR_NONE) && !write_failed);
+
+  return (err != MINST_ERR_NONE) ? err : write_err;
+}
+
+/* The number of bytes of samples that each thread reads at once while computing statistics. */
+#define MINST_STATS_CHUNK_SIZE (1024u * 1024u)
+
+#define MINST_STATS_VERSION 2u
+
+static const char minst_stats_magic[8] = { 'M', 'I', 'N', 'S', 'T', 'S', 'T', 'A' };
+
+/* The fixed part of a stats file, which follows the header. It is followed by the mean, standard deviation, minimum
+ * and maximum of each feature as doubles, and then by the count of each class. */
+struct stats_block
+{
+  uint64_t num_elements;
+
+  uint32_t num_features;
+
+  uint32_t num_classes;
+
+  double mean;
+
+  double std;
+
+  double min;
+
+  double max;
+};
+
+/* The running sums of one thread, which are taken around the shift of the job. */
+struct stats_partial
+{
+  double* sum;
+
+  double* sum_sq;
+
+  double* min_v;
+
+  double* max_v;
+};
+
+struct stats_job
+{
+  struct source* src;
+
+  const struct minst_format* format;
+
+  uint32_t num_features;
+
+  minst_convert_f64_func convert;
+
+  minst_moments_func moments;
+
+  /* the values of the first element, which are close enough to the means that the sums do not cancel */
+  double* shift;
+
+  struct stats_partial* partials;
+
+  enum minst_error* errors;
+};
+
+static void
+minst_stats_partial_free(struct stats_partial* p)
+{
+  free(p->sum);
+  free(p->sum_sq);
+  free(p->min_v);
+  free(p->max_v);
+}
+
+static enum minst_error
+minst_stats_partial_init(struct stats_partial* p, const uint32_t num_features)
+{
+  uint32_t i;
+
+  p->sum = calloc(num_features, sizeof(double));
+  p->sum_sq = calloc(num_features, sizeof(double));
+  p->min_v = malloc(num_features * sizeof(double));
+  p->max_v = malloc(num_features * sizeof(double));
+
+  if (!p->sum || !p->sum_sq || !p->min_v || !p->max_v) {
+    minst_stats_partial_free(p);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  for (i = 0; i < num_features; i++) {
+    p->min_v[i] = HUGE_VAL;
+    p->max_v[i] = -HUGE_VAL;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Reads a run of elements as doubles, through the buffer if the file is not in memory. */
+static enum minst_error
+minst_stats_load(const struct stats_job* job, const uint32_t idx, const uint32_t count, uint8_t* raw, double* values)
+{
+  const uint32_t element_size = minst_element_size(job->format);
+  const uint8_t* span;
+  enum minst_error err;
+
+  if (job->src->data) {
+    span = minst_source_span(job->src, minst_source_offset(job->src, job->format, idx), ((size_t)count) * element_size);
+    if (span == NULL) {
+      return MINST_ERR_MISSING_DATA;
+    }
+  } else {
+    err = minst_source_pread(
+      job->src, minst_source_offset(job->src, job->format, idx), count * element_size, raw, NULL);
+    if (err != MINST_ERR_NONE) {
+      return err;
+    }
+    span = raw;
+  }
+
+  job->convert(span, values, ((size_t)count) * job->num_features);
+
+  return MINST_ERR_NONE;
+}
+
+/* Adds up the samples of one contiguous range of elements, reading them in large chunks. */
+static enum minst_error
+minst_stats_range(const struct stats_job* job, struct stats_partial* p, const uint32_t first, const uint32_t last)
+{
+  const uint32_t element_size = minst_element_size(job->format);
+  enum minst_error err;
+  uint8_t* raw;
+  double* values;
+  uint32_t chunk;
+  uint32_t count;
+  uint32_t idx;
+  uint32_t i;
+
+  chunk = MINST_STATS_CHUNK_SIZE / element_size;
+  chunk = (chunk > 0) ? chunk : 1;
+
+  raw = job->src->data ? NULL : malloc(((size_t)chunk) * element_size);
+  values = malloc(((size_t)chunk) * job->num_features * sizeof(double));
+
+  if ((!job->src->data && !raw) || !values) {
+    free(raw);
+    free(values);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  err = MINST_ERR_NONE;
+
+  for (idx = first; (idx < last) && (err == MINST_ERR_NONE); idx += count) {
+
+    count = ((last - idx) < chunk) ? (last - idx) : chunk;
+
+    err = minst_stats_load(job, idx, count, raw, values);
+    if (err != MINST_ERR_NONE) {
+      break;
+    }
+
+    for (i = 0; i < count; i++) {
+      job->moments(values + ((size_t)i) * job->num_features,
+                   job->shift,
+                   job->num_features,
+                   p->sum,
+                   p->sum_sq,
+                   p->min_v,
+                   p->max_v);
+    }
+  }
+
+  free(raw);
+  free(values);
+
+  return err;
+}
+
+static void
+minst_stats_task(void* task_data, const uint32_t worker_idx, const uint32_t num_workers)
+{
+  const struct stats_job* job;
+  uint32_t first;
+  uint32_t last;
+
+  job = task_data;
+
+  first = (uint32_t)((((uint64_t)job->format->shape[0]) * worker_idx) / num_workers);
+
+  last = (uint32_t)((((uint64_t)job->format->shape[0]) * (worker_idx + 1)) / num_workers);
+
+  job->errors[worker_idx] = minst_stats_range(job, &job->partials[worker_idx], first, last);
+}
+
+static enum minst_error
+minst_data_stats_alloc(struct minst_data_stats* stats, const uint32_t num_features, const uint32_t num_classes)
+{
+  stats->num_features = num_features;
+  stats->num_classes = num_classes;
+  stats->feature_mean = malloc(((size_t)num_features + 1) * sizeof(double));
+  stats->feature_std = malloc(((size_t)num_features + 1) * sizeof(double));
+  stats->feature_min = malloc(((size_t)num_features + 1) * sizeof(double));
+  stats->feature_max = malloc(((size_t)num_features + 1) * sizeof(double));
+  stats->label_counts = calloc((size_t)num_classes + 1, sizeof(uint64_t));
+
+  if (!stats->feature_mean || !stats->feature_std || !stats->feature_min || !stats->feature_max ||
+      !stats->label_counts) {
+    minst_data_stats_free(stats);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+/* Combines the partial sums of the threads into the moments of each feature, and those into the moments of the whole
+ * dataset. */
+static void
+minst_stats_finish(struct minst_data_stats* stats,
+                   const struct stats_partial* partials,
+                   const uint32_t num_partials,
+                   const double* shift)
+{
+  const uint32_t num_features = stats->num_features;
+  const double n = (double)stats->num_elements;
+  double total_var = 0.0;
+  double sum;
+  double sum_sq;
+  double min_v;
+  double max_v;
+  double var;
+  double d;
+  uint32_t f;
+  uint32_t w;
+
+  stats->min = 0.0;
+  stats->max = 0.0;
+  stats->mean = 0.0;
+
+  for (f = 0; f < num_features; f++) {
+
+    sum = 0.0;
+    sum_sq = 0.0;
+    min_v = HUGE_VAL;
+    max_v = -HUGE_VAL;
+
+    for (w = 0; w < num_partials; w++) {
+      sum += partials[w].sum[f];
+      sum_sq += partials[w].sum_sq[f];
+      min_v = (partials[w].min_v[f] < min_v) ? partials[w].min_v[f] : min_v;
+      max_v = (partials[w].max_v[f] > max_v) ? partials[w].max_v[f] : max_v;
+    }
+
+    if (stats->num_elements == 0) {
+      min_v = 0.0;
+      max_v = 0.0;
+    }
+
+    stats->min = ((f == 0) || (min_v < stats->min)) ? min_v : stats->min;
+    stats->max = ((f == 0) || (max_v > stats->max)) ? max_v : stats->max;
+
+    /* the sums are taken around the shift, so the variance is that of the shifted values */
+    stats->feature_mean[f] = (n > 0.0) ? (shift[f] + sum / n) : 0.0;
+    var = (n > 0.0) ? ((sum_sq / n) - (sum / n) * (sum / n)) : 0.0;
+    stats->feature_std[f] = (var > 0.0) ? sqrt(var) : 0.0;
+    stats->feature_min[f] = min_v;
+    stats->feature_max[f] = max_v;
+
+    stats->mean += stats->feature_mean[f];
+    total_var += (var > 0.0) ? var : 0.0;
+  }
+
+  stats->mean = (num_features > 0) ? (stats->mean / num_features) : 0.0;
+
+  /* the variance of all values is the mean variance of the features plus the variance of their means */
+  for (f = 0; f < num_features; f++) {
+    d = stats->feature_mean[f] - stats->mean;
+    total_var += d * d;
+  }
+
+  var = (num_features > 0) ? (total_var / num_features) : 0.0;
+  stats->std = (var > 0.0) ? sqrt(var) : 0.0;
+}
+
+/* Reads the moments of the samples with one pass over the samples file on the given number of threads. */
+static enum minst_error
+minst_stats_samples(const char* samples_path,
+                    const struct minst_format* sample_format,
+                    const uint32_t num_threads,
+                    struct minst_data_stats* stats)
+{
+  struct worker_pool pool;
+  struct source src;
+  struct stats_job job;
+  enum minst_error err;
+  uint8_t* raw;
+  uint32_t num_workers;
+  uint32_t w;
+
+  err = minst_source_open(&src, samples_path, sample_format, MINST_IO_MMAP, 0, MINST_ERR_OPEN_SAMPLES);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  job.src = &src;
+  job.format = sample_format;
+  job.num_features = stats->num_features;
+  job.convert = minst_get_convert_f64(sample_format->type);
+  job.moments = minst_get_moments();
+
+  /* a compressed stream can only be read by one thread */
+  num_workers = num_threads;
+
+#ifdef MINST_HAVE_ZLIB
+  if (src.gz) {
+    num_workers = 1;
+  }
+#endif
+
+  job.partials = calloc(num_workers, sizeof(struct stats_partial));
+  job.errors = calloc(num_workers, sizeof(enum minst_error));
+  job.shift = calloc((size_t)job.num_features + 1, sizeof(double));
+
+  err = (job.partials && job.errors && job.shift) ? MINST_ERR_NONE : MINST_ERR_OUT_OF_MEMORY;
+
+  if ((err == MINST_ERR_NONE) && (sample_format->shape[0] > 0)) {
+    raw = src.data ? NULL : malloc(minst_element_size(sample_format));
+    err = (src.data || raw) ? minst_stats_load(&job, 0, 1, raw, job.shift) : MINST_ERR_OUT_OF_MEMORY;
+    free(raw);
+  }
+
+  for (w = 0; (w < num_workers) && (err == MINST_ERR_NONE); w++) {
+    err = minst_stats_partial_init(&job.partials[w], job.num_features);
+  }
+
+  if (err == MINST_ERR_NONE) {
+    err = minst_pool_init(&pool, num_workers);
+  }
+
+  if (err == MINST_ERR_NONE) {
+
+    minst_pool_run(&pool, minst_stats_task, &job);
+
+    for (w = 0; (w < pool.num_workers) && (err == MINST_ERR_NONE); w++) {
+      err = job.errors[w];
+    }
+
+    if (err == MINST_ERR_NONE) {
+      minst_stats_finish(stats, job.partials, pool.num_workers, job.shift);
+    }
+
+    minst_pool_destroy(&pool);
+  }
+
+  for (w = 0; job.partials && (w < num_workers); w++) {
+    minst_stats_partial_free(&job.partials[w]);
+  }
+
+  free(job.partials);
+  free(job.errors);
+  free(job.shift);
+
+  minst_source_close(&src);
+
+  return err;
+}
+
+/* Counts the elements of each class. The number of classes is one more than the largest label. */
+static enum minst_error
+minst_stats_labels(const char* labels_path, const struct minst_format* label_format, int32_t* labels, uint32_t* max)
+{
+  enum minst_error err;
+  uint32_t i;
+
+  err = minst_read_labels(labels_path, label_format, labels);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  *max = 0;
+
+  for (i = 0; i < label_format->shape[0]; i++) {
+
+    if (labels[i] < 0) {
+      return MINST_ERR_LABEL_RANGE;
+    }
+
+    *max = (((uint32_t)labels[i]) > *max) ? (uint32_t)labels[i] : *max;
+  }
+
+  return MINST_ERR_NONE;
+}
+
+static int
+minst_stats_file_read(const char* stats_path,
+                      const struct cache_header* expected,
+                      const char* samples_path,
+                      const char* labels_path,
+                      struct minst_data_stats* stats)
+{
+  struct cache_header header;
+  struct stats_block block;
+  FILE* file;
+  int ok;
+
+  if (minst_derived_header_check(stats_path, expected, samples_path, labels_path, &header) != 0) {
+    return -1;
+  }
+
+  file = fopen(stats_path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+
+  ok = (fseek(file, (long int)header.samples_offset, SEEK_SET) == 0) && (fread(&block, sizeof(block), 1, file) == 1) &&
+       (block.num_elements == expected->sample_shape[0]) &&
+       (block.num_features == expected->sample_shape[1] * expected->sample_shape[2] * expected->sample_shape[3]) &&
+       (minst_data_stats_alloc(stats, block.num_features, block.num_classes) == MINST_ERR_NONE);
+
+  if (ok) {
+    stats->num_elements = block.num_elements;
+    stats->mean = block.mean;
+    stats->std = block.std;
+    stats->min = block.min;
+    stats->max = block.max;
+
+    ok = (fread(stats->feature_mean, sizeof(double), block.num_features, file) == block.num_features) &&
+         (fread(stats->feature_std, sizeof(double), block.num_features, file) == block.num_features) &&
+         (fread(stats->feature_min, sizeof(double), block.num_features, file) == block.num_features) &&
+         (fread(stats->feature_max, sizeof(double), block.num_features, file) == block.num_features) &&
+         (fread(stats->label_counts, sizeof(uint64_t), block.num_classes, file) == block.num_classes);
+  }
+
+  fclose(file);
+
+  if (!ok) {
+    minst_data_stats_free(stats);
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Writes a stats file through a temporary file, so that a stats file is never seen half written. */
+static enum minst_error
+minst_stats_file_write(const char* stats_path,
+                       const struct cache_header* expected,
+                       const char* samples_path,
+                       const char* labels_path,
+                       const struct minst_data_stats* stats)
+{
+  struct cache_header header;
+  struct stats_block block;
+  enum minst_error err;
+  char* tmp_path;
+  FILE* file;
+  int ok;
+
+  header = *expected;
+  header.samples_offset = sizeof(header);
+  header.labels_offset = 0;
+
+  if (minst_sources_checksum(samples_path, labels_path, &header.checksum) != 0) {
+    return MINST_ERR_OPEN_SAMPLES;
+  }
+
+  memset(&block, 0, sizeof(block));
+  block.num_elements = stats->num_elements;
+  block.num_features = stats->num_features;
+  block.num_classes = stats->num_classes;
+  block.mean = stats->mean;
+  block.std = stats->std;
+  block.min = stats->min;
+  block.max = stats->max;
+
+  /* ranks that share a stats file may write it at the same time */
+  err = minst_temp_open(stats_path, &file, &tmp_path);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  ok = (fwrite(&header, sizeof(header), 1, file) == 1) && (fwrite(&block, sizeof(block), 1, file) == 1) &&
+       (fwrite(stats->feature_mean, sizeof(double), stats->num_features, file) == stats->num_features) &&
+       (fwrite(stats->feature_std, sizeof(double), stats->num_features, file) == stats->num_features) &&
+       (fwrite(stats->feature_min, sizeof(double), stats->num_features, file) == stats->num_features) &&
+       (fwrite(stats->feature_max, sizeof(double), stats->num_features, file) == stats->num_features) &&
+       (fwrite(stats->label_counts, sizeof(uint64_t), stats->num_classes, file) == stats->num_classes);
+
+  return minst_temp_close(file, tmp_path, stats_path, ok);
+}
+
+enum minst_error
+minst_compute_stats(const char* samples_path,
+                    const char* labels_path,
+                    const struct minst_format* sample_format,
+                    const struct minst_format* label_format,
+                    const uint32_t num_threads,
+                    const char* stats_path,
+                    struct minst_data_stats* stats)
+{
+  struct minst_options options;
+  struct minst_format no_labels;
+  struct cache_header expected;
+  enum minst_error err;
+  int32_t* labels;
+  uint32_t max_label;
+  uint32_t i;
+
+  memset(stats, 0, sizeof(*stats));
+
+  if (num_threads == 0) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  /* without labels, the label fields of the header are all zero */
+  memset(&no_labels, 0, sizeof(no_labels));
+
+  if (!labels_path) {
+    label_format = &no_labels;
+  }
+
+  if (stats_path) {
+
+    minst_options_init(&options);
+
+    minst_cache_header_init(&expected, sample_format, label_format, &options);
+
+    memcpy(expected.magic, minst_stats_magic, sizeof(expected.magic));
+
+    expected.version = MINST_STATS_VERSION;
+
+    if (minst_file_stamp(samples_path, &expected.samples_size, &expected.samples_mtime) != 0) {
+      return MINST_ERR_OPEN_SAMPLES;
+    }
+
+    if (labels_path && (minst_file_stamp(labels_path, &expected.labels_size, &expected.labels_mtime) != 0)) {
+      return MINST_ERR_OPEN_LABELS;
+    }
+
+    if (minst_stats_file_read(stats_path, &expected, samples_path, labels_path, stats) == 0) {
+      return MINST_ERR_NONE;
+    }
+  }
+
+  labels = NULL;
+  max_label = 0;
+
+  if (labels_path) {
+
+    labels = malloc(((size_t)label_format->shape[0] + 1) * sizeof(int32_t));
+    if (labels == NULL) {
+      return MINST_ERR_OUT_OF_MEMORY;
+    }
+
+    err = minst_stats_labels(labels_path, label_format, labels, &max_label);
+    if (err != MINST_ERR_NONE) {
+      free(labels);
+      return err;
+    }
+  }
+
+  err = minst_data_stats_alloc(stats,
+                               sample_format->shape[1] * sample_format->shape[2] * sample_format->shape[3],
+                               (labels && (label_format->shape[0] > 0)) ? (max_label + 1) : 0);
+  if (err != MINST_ERR_NONE) {
+    free(labels);
+    return err;
+  }
+
+  for (i = 0; labels && (i < label_format->shape[0]); i++) {
+    stats->label_counts[labels[i]]++;
+  }
+
+  free(labels);
+
+  stats->num_elements = sample_format->shape[0];
+
+  err = minst_stats_samples(samples_path, sample_format, num_threads, stats);
+
+  if ((err == MINST_ERR_NONE) && stats_path) {
+    err = minst_stats_file_write(stats_path, &expected, samples_path, labels_path, stats);
+  }
+
+  if (err != MINST_ERR_NONE) {
+    minst_data_stats_free(stats);
+  }
+
+  return err;
+}
+
+void
+minst_data_stats_free(struct minst_data_stats* stats)
+{
+  free(stats->feature_mean);
+  free(stats->feature_std);
+  free(stats->feature_min);
+  free(stats->feature_max);
+  free(stats->label_counts);
+
+  memset(stats, 0, sizeof(*stats));
+}
+
+/* The size of the buffer that appended elements are staged in before they are written. */
+#define MINST_WRITER_BUFFER_SIZE (4u * 1024u * 1024u)
+
+struct minst_writer
+{
+  FILE* file;
+
+  struct minst_format format;
+
+  uint32_t element_size;
+
+  /* null for single byte types and on big endian hosts, where elements are written as they are */
+  minst_bswap_func bswap;
+
+  long int header_size;
+
+  uint8_t* buffer;
+
+  /* the number of elements that fit in the buffer */
+  uint32_t capacity;
+
+  /* the number of elements in the buffer, which come right before the next element */
+  uint32_t staged;
+
+  /* the index of the next element to append */
+  uint32_t next_idx;
+};
+
+static uint8_t
+minst_type_code(const enum minst_type type)
+{
+  switch (type) {
+    case MINST_TYPE_U8:
+      return 0x08;
+    case MINST_TYPE_I8:
+      return 0x09;
+    case MINST_TYPE_I16:
+      return 0x0B;
+    case MINST_TYPE_I32:
+      return 0x0C;
+    case MINST_TYPE_F32:
+      return 0x0D;
+    case MINST_TYPE_F64:
+      return 0x0E;
+  }
+  return 0;
+}
+
+/* Writes a block of bytes at an offset of the file. With thread support, this does not use the position of the file,
+ * so that several threads can write at once. */
+static enum minst_error
+minst_writer_pwrite(struct minst_writer* writer, const long int offset, const uint8_t* data, const size_t size)
+{
+#ifdef MINST_HAVE_THREADS
+  ssize_t write_size;
+  size_t total;
+
+  total = 0;
+
+  while (total < size) {
+
+    write_size = pwrite(fileno(writer->file), data + total, size - total, (off_t)(offset + (long int)total));
+    if (write_size <= 0) {
+      return MINST_ERR_WRITE;
+    }
+
+    total += (size_t)write_size;
+  }
+
+  return MINST_ERR_NONE;
+#else
+  if (fseek(writer->file, offset, SEEK_SET) != 0) {
+    return MINST_ERR_WRITE;
+  }
+
+  return (fwrite(data, 1, size, writer->file) == size) ? MINST_ERR_NONE : MINST_ERR_WRITE;
+#endif
+}
+
+/* Gives the file its full size up front, reserving the disk space if asked to. */
+static enum minst_error
+minst_writer_resize(struct minst_writer* writer, const enum minst_write_mode mode)
+{
+  const long int total = writer->header_size + ((long int)writer->format.shape[0]) * ((long int)writer->element_size);
+#ifdef MINST_HAVE_MMAP
+#ifdef MINST_HAVE_FALLOCATE
+  /* file systems that can not reserve space fail here, and get a sparse file instead */
+  if ((mode == MINST_WRITE_PREALLOCATE) && (posix_fallocate(fileno(writer->file), 0, (off_t)total) == 0)) {
+    return MINST_ERR_NONE;
+  }
+#else
+  (void)mode;
+#endif
+  return (ftruncate(fileno(writer->file), (off_t)total) == 0) ? MINST_ERR_NONE : MINST_ERR_WRITE;
+#else
+  const uint8_t zero = 0;
+
+  (void)mode;
+
+  /* writing the last byte makes the file system fill in the rest */
+  return (total > writer->header_size) ? minst_writer_pwrite(writer, total - 1, &zero, 1) : MINST_ERR_NONE;
+#endif
+}
+
+enum minst_error
+minst_writer_open(struct minst_writer** writer,
+                  const char* path,
+                  const struct minst_format* format,
+                  const enum minst_write_mode mode)
+{
+  struct minst_writer* w;
+  enum minst_error err;
+  uint8_t header[4 + MINST_MAX_RANK * 4];
+  uint32_t dim_idx;
+
+  *writer = NULL;
+
+  if ((format->rank == 0) || (format->rank > MINST_MAX_RANK) || (minst_type_code(format->type) == 0) ||
+      (minst_element_size(format) == 0)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  w = calloc(1, sizeof(struct minst_writer));
+  if (w == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  w->format = *format;
+  w->element_size = minst_element_size(format);
+  w->bswap = !minst_is_big_endian() ? minst_get_bswap(minst_type_size(format->type)) : NULL;
+  w->header_size = minst_element_offset(format, 0);
+  w->capacity = (MINST_WRITER_BUFFER_SIZE >= w->element_size) ? (MINST_WRITER_BUFFER_SIZE / w->element_size) : 1;
+
+  w->buffer = malloc(((size_t)w->capacity) * w->element_size);
+  if (w->buffer == NULL) {
+    free(w);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  w->file = fopen(path, "wb");
+  if (w->file == NULL) {
+    free(w->buffer);
+    free(w);
+    return MINST_ERR_WRITE;
+  }
+
+  /* every write is a large block at a known offset, so the stream buffer would only add a copy */
+  setvbuf(w->file, NULL, _IONBF, 0);
+
+  header[0] = 0;
+  header[1] = 0;
+  header[2] = minst_type_code(format->type);
+  header[3] = format->rank;
+
+  for (dim_idx = 0; dim_idx < format->rank; dim_idx++) {
+    header[4 + dim_idx * 4 + 0] = (uint8_t)(format->shape[dim_idx] >> 24u);
+    header[4 + dim_idx * 4 + 1] = (uint8_t)(format->shape[dim_idx] >> 16u);
+    header[4 + dim_idx * 4 + 2] = (uint8_t)(format->shape[dim_idx] >> 8u);
+    header[4 + dim_idx * 4 + 3] = (uint8_t)format->shape[dim_idx];
+  }
+
+  err = minst_writer_pwrite(w, 0, header, (size_t)w->header_size);
+
+  if ((err == MINST_ERR_NONE) && (mode != MINST_WRITE_STREAM)) {
+    err = minst_writer_resize(w, mode);
+  }
+
+  if (err != MINST_ERR_NONE) {
+    fclose(w->file);
+    remove(path);
+    free(w->buffer);
+    free(w);
+    return err;
+  }
+
+  *writer = w;
+
+  return MINST_ERR_NONE;
+}
+
+/* Writes the staged elements, which end right before the next element to append. */
+static enum minst_error
+minst_writer_flush(struct minst_writer* writer)
+{
+  enum minst_error err;
+
+  if (writer->staged == 0) {
+    return MINST_ERR_NONE;
+  }
+
+  err = minst_writer_pwrite(writer,
+                            minst_element_offset(&writer->format, writer->next_idx - writer->staged),
+                            writer->buffer,
+                            ((size_t)writer->staged) * writer->element_size);
+
+  writer->staged = 0;
+
+  return err;
+}
+
+enum minst_error
+minst_writer_append(struct minst_writer* writer, const void* data, const uint32_t count)
+{
+  const uint8_t* src;
+  enum minst_error err;
+  uint32_t remaining;
+  uint32_t n;
+
+  if (count > (writer->format.shape[0] - writer->next_idx)) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  src = data;
+
+  for (remaining = count; remaining > 0; remaining -= n) {
+
+    /* elements already in file byte order need no conversion, so a block larger than the buffer is written without
+     * copying it */
+    if (!writer->bswap && (writer->staged == 0) && (remaining >= writer->capacity)) {
+
+      n = remaining;
+
+      err = minst_writer_pwrite(
+        writer, minst_element_offset(&writer->format, writer->next_idx), src, ((size_t)n) * writer->element_size);
+      if (err != MINST_ERR_NONE) {
+        return err;
+      }
+
+      writer->next_idx += n;
+      src += ((size_t)n) * writer->element_size;
+      continue;
+    }
+
+    n = writer->capacity - writer->staged;
+    n = (remaining < n) ? remaining : n;
+
+    if (writer->bswap) {
+      writer->bswap(src,
+                    writer->buffer + ((size_t)writer->staged) * writer->element_size,
+                    (((size_t)n) * writer->element_size) / minst_type_size(writer->format.type));
+    } else {
+      memcpy(writer->buffer + ((size_t)writer->staged) * writer->element_size, src, ((size_t)n) * writer->element_size);
+    }
+
+    writer->staged += n;
+    writer->next_idx += n;
+    src += ((size_t)n) * writer->element_size;
+
+    if (writer->staged == writer->capacity) {
+      err = minst_writer_flush(writer);
+      if (err != MINST_ERR_NONE) {
+        return err;
+      }
+    }
+  }
+
+  return MINST_ERR_NONE;
+}
+
+enum minst_error
+minst_writer_write_at(struct minst_writer* writer, const uint32_t element_idx, const void* data, const uint32_t count)
+{
+  const uint8_t* src;
+  enum minst_error err;
+  uint8_t* buffer;
+  uint32_t capacity;
+  uint32_t done;
+  uint32_t n;
+
+  if ((element_idx > writer->format.shape[0]) || (count > (writer->format.shape[0] - element_idx))) {
+    return MINST_ERR_INVALID_ARGUMENT;
+  }
+
+  if (count == 0) {
+    return MINST_ERR_NONE;
+  }
+
+  src = data;
+
+  if (!writer->bswap) {
+    return minst_writer_pwrite(
+      writer, minst_element_offset(&writer->format, element_idx), src, ((size_t)count) * writer->element_size);
+  }
+
+  /* each call converts into its own buffer, so that calls from several threads do not share any state */
+  capacity = (count < writer->capacity) ? count : writer->capacity;
+
+  buffer = malloc(((size_t)capacity) * writer->element_size);
+  if (buffer == NULL) {
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  err = MINST_ERR_NONE;
+
+  for (done = 0; (done < count) && (err == MINST_ERR_NONE); done += n) {
+
+    n = ((count - done) < capacity) ? (count - done) : capacity;
+
+    writer->bswap(src + ((size_t)done) * writer->element_size,
+                  buffer,
+                  (((size_t)n) * writer->element_size) / minst_type_size(writer->format.type));
+
+    err = minst_writer_pwrite(
+      writer, minst_element_offset(&writer->format, element_idx + done), buffer, ((size_t)n) * writer->element_size);
+  }
+
+  free(buffer);
+
+  return err;
+}
+
+enum minst_error
+minst_writer_close(struct minst_writer* writer)
+{
+  enum minst_error err;
+
+  if (!writer) {
+    return MINST_ERR_NONE;
+  }
+
+  err = minst_writer_flush(writer);
+
+  if ((fclose(writer->file) != 0) && (err == MINST_ERR_NONE)) {
+    err = MINST_ERR_WRITE;
+  }
 
-  fclose(samples_file);
+  free(writer->buffer);
+  free(writer);
 
   return err;
 }
@@ -1,9 +1,20 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define MINST_MAX_RANK 4
 
+/**
+ * @brief The alignment, in bytes, of memory that the library allocates for dataset contents.
+ * */
+#define MINST_ALIGNMENT 64
+
+/**
+ * @brief The number of buckets in the batch latency histogram of @ref minst_stats.
+ * */
+#define MINST_STATS_BUCKETS 24
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -58,7 +69,54 @@ extern "C"
     /**
      * @brief Failed to go to a specific file location.
      * */
-    MINST_ERR_SEEK
+    MINST_ERR_SEEK,
+    /**
+     * @brief Failed to map a file into memory.
+     * */
+    MINST_ERR_MAP,
+    /**
+     * @brief A parameter passed to the library is not valid.
+     * */
+    MINST_ERR_INVALID_ARGUMENT,
+    /**
+     * @brief A worker thread could not be created.
+     * */
+    MINST_ERR_THREAD,
+    /**
+     * @brief Failed to write a file.
+     * */
+    MINST_ERR_WRITE,
+    /**
+     * @brief A label is not one of the classes of a one-hot output.
+     * */
+    MINST_ERR_LABEL_RANGE
+  };
+
+  /**
+   * @brief Enumerates the ways in which the dataset files can be accessed.
+   *
+   * @note When the library is built with zlib, gzip compressed files (such as the official *-ubyte.gz downloads) are
+   *       detected and inflated. With @ref MINST_IO_STDIO and the sequential default sampler, a compressed file is
+   *       streamed in large blocks. Otherwise, it is inflated into memory once when the dataset is opened.
+   * */
+  enum minst_io_mode
+  {
+    /**
+     * @brief Elements are read with buffered standard I/O, one seek and read per element. The reads of each batch are
+     *        done in file order, so that they only move forward through the file.
+     * */
+    MINST_IO_STDIO,
+    /**
+     * @brief The files are memory mapped once and elements are served directly from the mapping. Batches of consecutive
+     *        elements are passed to the callback without being copied. On platforms without memory mapping support,
+     *        this falls back to @ref MINST_IO_STDIO.
+     * */
+    MINST_IO_MMAP,
+    /**
+     * @brief Each file is read into aligned memory with one sequential read when the dataset is opened. Batches are then
+     *        gathered from memory. This is best for datasets that fit in memory, such as MINST and FashionMINST.
+     * */
+    MINST_IO_PRELOAD
   };
 
   /**
@@ -74,6 +132,166 @@ extern "C"
     MINST_TYPE_F64
   };
 
+  /**
+   * @brief Enumerates the forms in which the samples and labels can be passed on to the caller.
+   * */
+  enum minst_output
+  {
+    /**
+     * @brief The samples are passed on exactly as they appear in the file.
+     * */
+    MINST_OUTPUT_RAW,
+    /**
+     * @brief The elements keep their type, but multi-byte types are converted from big-endian to native byte order
+     *        using SIMD byte shuffles over the whole batch.
+     * */
+    MINST_OUTPUT_NATIVE,
+    /**
+     * @brief The samples are converted to 32-bit floats in native byte order and normalized, using SIMD kernels where
+     *        the CPU supports them.
+     * */
+    MINST_OUTPUT_F32,
+    /**
+     * @brief The elements are widened to signed 32-bit integers in native byte order. Only integer types can be
+     *        widened.
+     * */
+    MINST_OUTPUT_I32,
+    /**
+     * @brief The elements are widened to signed 64-bit integers in native byte order, as expected by most loss
+     *        functions that take class indices. Only integer types can be widened.
+     * */
+    MINST_OUTPUT_I64,
+    /**
+     * @brief Each value of a label becomes a vector of 32-bit floats with one entry per class, where the entry of the
+     *        label's class is one and the others are zero, before label smoothing. This is only valid for labels of an
+     *        integer type, and requires the number of classes to be set.
+     * */
+    MINST_OUTPUT_ONE_HOT
+  };
+
+  /**
+   * @brief Enumerates the ways in which the default sampler can shuffle the elements.
+   * */
+  enum minst_shuffle_mode
+  {
+    /**
+     * @brief A table of element indices is kept and shuffled with a Fisher–Yates shuffle at the start of each epoch.
+     *        This costs one index per element of memory and one pass over the table per epoch.
+     * */
+    MINST_SHUFFLE_TABLE,
+    /**
+     * @brief Each shuffled index is computed on demand from the seed, the epoch number and the position in the epoch,
+     *        using @ref minst_permute. Starting a new epoch costs nothing and no memory is needed for the permutation.
+     * */
+    MINST_SHUFFLE_COUNTER
+  };
+
+  /**
+   * @brief Enumerates the ways in which the built-in samplers can choose elements by their class. The class samplers
+   *        read the labels once when the dataset is opened and keep the elements of each class in an index, so that
+   *        choosing an element takes constant time and starting a new epoch does not read the labels again. The labels
+   *        must be integers, with one label per element.
+   * */
+  enum minst_sampling
+  {
+    /**
+     * @brief The elements are chosen without regard to their class, as set by the shuffle options.
+     * */
+    MINST_SAMPLING_UNIFORM,
+    /**
+     * @brief Each batch has the same mix of classes as the dataset, up to one element per class. The elements of each
+     *        class are visited in a shuffled order.
+     * */
+    MINST_SAMPLING_STRATIFIED,
+    /**
+     * @brief Each batch has the same number of elements of every class that occurs in the dataset, up to one element
+     *        per class. Classes with fewer elements are visited more than once per epoch.
+     * */
+    MINST_SAMPLING_BALANCED,
+    /**
+     * @brief Each element is chosen independently and with replacement, with a probability proportional to the weight
+     *        of its class. Classes are drawn from an alias table in constant time.
+     * */
+    MINST_SAMPLING_WEIGHTED
+  };
+
+  /**
+   * @brief Enumerates the ways of splitting a dataset into shards of equal size, when the number of elements is not a
+   *        multiple of the number of shards.
+   * */
+  enum minst_shard_mode
+  {
+    /**
+     * @brief The last shards are padded with elements from the start of the global order, so that no element is left
+     *        out.
+     * */
+    MINST_SHARD_PAD,
+    /**
+     * @brief The elements at the end of the global order that do not fill a whole shard are left out of the epoch.
+     * */
+    MINST_SHARD_DROP
+  };
+
+  /**
+   * @brief Enumerates what happens to the last batch of an epoch when the number of elements is not a multiple of the
+   *        batch size.
+   * */
+  enum minst_tail_mode
+  {
+    /**
+     * @brief The last batch is filled up by the sampler going on past the end of the epoch, which with the default
+     *        samplers means starting over at the first elements of the epoch. Every batch is full.
+     * */
+    MINST_TAIL_WRAP,
+    /**
+     * @brief The elements that do not fill a whole batch are left out of the epoch. Every batch is full, and no element
+     *        is read twice.
+     * */
+    MINST_TAIL_DROP,
+    /**
+     * @brief The last batch only has the remaining elements, so that every element is read exactly once per epoch. The
+     *        size of each batch tells how many elements it has.
+     * */
+    MINST_TAIL_PARTIAL
+  };
+
+  /**
+   * @brief Enumerates how a writer sizes the file that it writes.
+   * */
+  enum minst_write_mode
+  {
+    /**
+     * @brief The file grows as elements are written. This is best for writing the elements in order.
+     * */
+    MINST_WRITE_STREAM,
+    /**
+     * @brief The file is given its full size when it is opened, without reserving disk space. Elements that are never
+     *        written read back as zero. On file systems without sparse files, the space is filled in with zeros.
+     * */
+    MINST_WRITE_SPARSE,
+    /**
+     * @brief The disk space of the whole file is reserved when it is opened, so that writing elements can not run out
+     *        of space and the file is less fragmented. On platforms where space can not be reserved, this is the same
+     *        as @ref MINST_WRITE_SPARSE.
+     * */
+    MINST_WRITE_PREALLOCATE
+  };
+
+  /**
+   * @brief Enumerates the orders in which the values of an image can be stored.
+   * */
+  enum minst_channel_order
+  {
+    /**
+     * @brief The channels of a pixel are stored next to each other (NHWC). This is the order of the IDX files.
+     * */
+    MINST_CHANNELS_LAST,
+    /**
+     * @brief Each channel is stored as its own plane of rows (NCHW). This requires samples of rank three or more.
+     * */
+    MINST_CHANNELS_FIRST
+  };
+
   /**
    * @brief Used for specifying the expected format of a MINST file.
    * */
@@ -98,76 +316,1151 @@ extern "C"
   };
 
   /**
-   * @brief A type definition for the function used to pass sample data to.
+   * @brief Random augmentations applied to each sample of a batch. A field that is zero disables its augmentation.
    *
-   * @param callback_data User defined data passed from the calling environment.
-   *
-   * @param sample The sample data, in row major format.
-   *
-   * @param label The ground truth label for this sample.
+   * @details The samples are treated as images of shape[1] rows, shape[2] columns and shape[3] channels. Shifting,
+   *          flipping, the affine transform and the elastic distortion are combined into one resampling pass with
+   *          bilinear filtering, after which the noise is added.
+   * */
+  struct minst_augment
+  {
+    /**
+     * @brief The largest distance, in pixels, that a sample is moved along each axis. This is the same as padding the
+     *        sample by this many pixels on each side and cropping it at a random position.
+     * */
+    uint32_t max_shift;
+
+    /**
+     * @brief The probability that a sample is mirrored horizontally.
+     * */
+    float flip_probability;
+
+    /**
+     * @brief The largest rotation, in radians, in either direction.
+     * */
+    float max_rotation;
+
+    /**
+     * @brief The largest relative change in size. For example, 0.1 scales the samples by a factor between 0.9 and 1.1.
+     *        Must be less than one.
+     * */
+    float max_scale;
+
+    /**
+     * @brief The largest horizontal shear factor, in either direction.
+     * */
+    float max_shear;
+
+    /**
+     * @brief The largest displacement, in pixels, of the elastic distortion. The displacements are chosen at random on
+     *        a coarse grid and interpolated smoothly across the sample.
+     * */
+    float elastic_alpha;
+
+    /**
+     * @brief The standard deviation of the approximately normal noise added to each value.
+     * */
+    float noise_std;
+
+    /**
+     * @brief The value of pixels that are moved in from outside of the sample. This is compared to the converted
+     *        values, so with a non-zero mean the background is usually -sample_mean / sample_std.
+     * */
+    float fill;
+  };
+
+  /**
+   * @brief Describes how the samples of a batch are laid out in memory, so that they can be passed to compute kernels
+   *        without another copy. By default, the samples are packed one after another in the order of the file.
    *
-   * @return The predicted class index by the callback, or negative one if an
-   * error occurred.
+   * @details The samples are treated as images of shape[1] rows, shape[2] columns and shape[3] channels. Padding is
+   *          added around the values of each sample, the rows and the samples are spaced to the requested alignments,
+   *          and the batch memory is aligned to the largest of them. The padding and the spacing are written once when
+   *          the batch memory is allocated, so they cost nothing per batch.
    * */
-  typedef int (*minst_callback)(void* callback_data, const void* sample, const void* label);
+  struct minst_layout
+  {
+    /**
+     * @brief The order of the values of each sample. The default is @ref MINST_CHANNELS_LAST.
+     * */
+    enum minst_channel_order channel_order;
+
+    /**
+     * @brief The number of values added before the values of each dimension, indexed like the shape of the format.
+     *        The first entry, and the entries past the rank of the samples, must be zero.
+     * */
+    uint32_t pad_before[MINST_MAX_RANK];
+
+    /**
+     * @brief The number of values added after the values of each dimension, indexed like the shape of the format. The
+     *        first entry, and the entries past the rank of the samples, must be zero.
+     * */
+    uint32_t pad_after[MINST_MAX_RANK];
+
+    /**
+     * @brief The value of the padding when the samples are converted to floats. Otherwise, the padding is zero.
+     * */
+    float pad_value;
+
+    /**
+     * @brief The alignment, in bytes, of the distance between two rows of an image. Must be zero or a power of two.
+     *        This only applies to samples of rank three or more. The default is zero, which packs the rows.
+     * */
+    uint32_t row_alignment;
+
+    /**
+     * @brief The alignment, in bytes, of the distance between two samples. Must be zero or a power of two. The default
+     *        is zero, which packs the samples.
+     * */
+    uint32_t sample_alignment;
+  };
 
   /**
-   * @brief Chooses a sample from the dataset.
+   * @brief Chooses all of the elements of a batch in one call.
    *
-   * @param callback_data The user defined sampler data passed from the calling environment.
+   * @param sampler_data The user defined sampler data passed from the calling environment.
    *
    * @param num_elements The number of elements in the dataset.
    *
-   * @param element_idx The index of the chosen element.
+   * @param count The number of elements to choose.
+   *
+   * @param element_indices Receives the indices of the chosen elements, which must each be less than the number of
+   *                        elements in the dataset.
    *
    * @return Zero on success, negative one on failure.
    * */
-  typedef int (*minst_sampler)(void* sampler_data, uint32_t num_elements, uint32_t* element_idx);
+  typedef int (*minst_batch_sampler)(void* sampler_data,
+                                     uint32_t num_elements,
+                                     uint32_t count,
+                                     uint32_t* element_indices);
 
   /**
-   * @brief Converts an error enum to a human-readable string.
-   *
-   * @param err The error to convert to a string.
-   *
-   * @return The human-readable error string.
+   * @brief Counters that show where the time of loading a dataset goes. The times are the sums over all threads, in
+   *        seconds, so with several threads they may add up to more than the time that has passed.
    * */
-  const char* minst_strerror(enum minst_error err);
+  struct minst_stats
+  {
+    /**
+     * @brief The time spent opening the dataset, which covers checking the headers, mapping or preloading the files and
+     *        building the indices of the class samplers.
+     * */
+    double open_seconds;
 
-  /**
-   * @brief Computes the size, in bytes, of one element in a given format.
-   *
-   * @param fmt The format to compute the element size of.
-   *
-   * @return The number of bytes that one element consists of.
-   * */
-  uint32_t minst_element_size(const struct minst_format* fmt);
+    /**
+     * @brief The time spent in the sampler, choosing the elements of each batch.
+     * */
+    double sampler_seconds;
+
+    /**
+     * @brief The time spent reading elements from the files, or copying them out of memory.
+     * */
+    double io_seconds;
+
+    /**
+     * @brief The time spent converting, augmenting and laying out the elements.
+     * */
+    double convert_seconds;
+
+    /**
+     * @brief The time spent in the callback of @ref minst_eval_ex or @ref minst_evaluate.
+     * */
+    double callback_seconds;
+
+    /**
+     * @brief The number of bytes read from the files or from memory, including the whole file for each preloaded file
+     *        and the batches that are passed on directly from a mapping.
+     * */
+    uint64_t bytes_read;
+
+    /**
+     * @brief The number of calls that read from a file, such as fread, pread or gzread. Buffered standard I/O makes
+     *        fewer system calls than this.
+     * */
+    uint64_t num_reads;
+
+    /**
+     * @brief The number of calls that moved a file position, such as fseek or gzseek.
+     * */
+    uint64_t num_seeks;
+
+    /**
+     * @brief The number of batches that were handed to the caller.
+     * */
+    uint64_t num_batches;
+
+    /**
+     * @brief How long the caller waited for each batch. Bucket zero counts the batches that took less than one
+     *        microsecond, bucket i counts those that took from 2^(i - 1) up to 2^i microseconds, and the last bucket
+     *        also counts all slower batches.
+     * */
+    uint64_t latency_histogram[MINST_STATS_BUCKETS];
+  };
 
   /**
-   * @brief Loops through the dataset.
-   *
-   * @param samples_path The path to the samples file.
-   *
-   * @param labels_path The path to the labels file.
-   *
-   * @param callback_data Optional user-defined data to pass to the callback
-   *                      functions.
-   *
-   * @param callback The function to pass the sample and label data to.
-   *
-   * @param sampler An optional user-defined sampler (the default is random
-   *                sampling via Fisher–Yates shuffle).
+   * @brief Additional options for iterating a dataset.
    *
-   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * @note Always initialize this structure with @ref minst_options_init before changing any of its fields, so that
+   *       fields added in later versions get a sensible default.
    * */
-  enum minst_error minst_eval(const char* samples_path,
-                              const char* labels_path,
-                              const struct minst_format* sample_format,
-                              const struct minst_format* label_format,
-                              uint32_t batch_size,
-                              void* callback_data,
-                              const minst_callback callback,
-                              void* sampler_data,
-                              minst_sampler sampler);
+  struct minst_options
+  {
+    /**
+     * @brief How the dataset files are accessed. The default is @ref MINST_IO_STDIO.
+     * */
+    enum minst_io_mode io_mode;
+
+    /**
+     * @brief Whether or not the default sampler shuffles the elements. When this is zero, the elements are visited in
+     *        the order they appear in the file. This has no effect when a user-defined sampler is passed. The default
+     *        is one.
+     * */
+    int shuffle;
+
+    /**
+     * @brief The number of threads used to assemble a batch, including the calling thread. Each thread reads its own
+     *        disjoint range of the batch, and the batch is passed on once all of them have finished. The sampler is
+     *        called from one thread before the batch is split up, so the batch contents do not depend on the number of
+     *        threads. On platforms without thread support, this is treated as one. The default is one.
+     * */
+    uint32_t num_threads;
+
+    /**
+     * @brief The number of batches prepared ahead of time on a background thread, while the caller is still working on
+     *        the current batch. When this is zero, batches are prepared on the calling thread when they are requested.
+     *        When prefetching, the sampler is called from the background thread. A batch handed to the caller is only
+     *        recycled when the next batch is requested, so it stays valid until then. On platforms without thread
+     *        support, this is treated as zero. The default is zero.
+     * */
+    uint32_t prefetch_depth;
+
+    /**
+     * @brief The form in which samples are passed on. When converting to floats, each value becomes
+     *        (x * sample_scale - sample_mean) / sample_std. The default is @ref MINST_OUTPUT_RAW.
+     * */
+    enum minst_output sample_output;
+
+    /**
+     * @brief The scale applied to each sample value before normalization. When this is zero, the scale maps the range
+     *        of integer types onto [0, 1] for unsigned types and [-1, 1) for signed types, and is one for floating point
+     *        types. The default is zero.
+     * */
+    float sample_scale;
+
+    /**
+     * @brief The mean subtracted from each scaled sample value. The default is zero.
+     * */
+    float sample_mean;
+
+    /**
+     * @brief The standard deviation that each scaled sample value is divided by. Must not be zero. The default is one.
+     * */
+    float sample_std;
+
+    /**
+     * @brief The form in which labels are passed on. Labels converted to floats are not scaled or normalized. The
+     *        default is @ref MINST_OUTPUT_RAW.
+     * */
+    enum minst_output label_output;
+
+    /**
+     * @brief The number of classes of one-hot labels and class samplers. Labels must be in [0, num_classes), otherwise
+     *        getting the batch fails with @ref MINST_ERR_LABEL_RANGE. Class samplers take the number of classes from
+     *        the largest label when this is zero. The default is zero.
+     * */
+    uint32_t num_classes;
+
+    /**
+     * @brief The amount of label smoothing applied to one-hot labels, in [0, 1). Each entry becomes
+     *        (1 - label_smoothing) * one_hot + label_smoothing / num_classes. The default is zero.
+     * */
+    float label_smoothing;
+
+    /**
+     * @brief The seed of the default sampler. The order of the elements in each epoch only depends on the seed and the
+     *        epoch number. The default is zero.
+     * */
+    uint64_t seed;
+
+    /**
+     * @brief How the default sampler shuffles the elements. The default is @ref MINST_SHUFFLE_TABLE.
+     * */
+    enum minst_shuffle_mode shuffle_mode;
+
+    /**
+     * @brief How the elements are chosen by their class. This has no effect when a user-defined sampler is passed. The
+     *        class samplers are seeded with the seed and choose from the elements of the shard. The default is
+     *        @ref MINST_SAMPLING_UNIFORM.
+     * */
+    enum minst_sampling sampling;
+
+    /**
+     * @brief The weight of each class for @ref MINST_SAMPLING_WEIGHTED, with one entry per class, which requires the
+     *        number of classes to be set. The weights are copied when the dataset is opened. When this is null, all
+     *        elements have the same weight. The default is null.
+     * */
+    const float* class_weights;
+
+    /**
+     * @brief Optional user-defined data to pass to the batch sampler. The default is null.
+     * */
+    void* batch_sampler_data;
+
+    /**
+     * @brief An optional user-defined sampler that chooses a whole batch at once. This saves one indirect call per
+     *        element compared to a sampler passed as a function argument, and takes precedence over it. The default is
+     *        null.
+     * */
+    minst_batch_sampler batch_sampler;
+
+    /**
+     * @brief The number of shards that the dataset is split into, such as the number of processes in data-parallel
+     *        training. The default is one.
+     *
+     * @details Every shard derives the same global order of the elements for each epoch from the seed, and takes its
+     *          own contiguous range of it, so that the shards are disjoint without having to communicate. When shuffling
+     *          with the default sampler, the global order is always computed with @ref minst_permute, so that each
+     *          shard only needs memory for its own elements. User-defined samplers choose from the elements of the shard
+     *          and are passed the size of the shard as the number of elements.
+     * */
+    uint32_t world_size;
+
+    /**
+     * @brief The shard to iterate. Must be less than the number of shards. The default is zero.
+     * */
+    uint32_t rank;
+
+    /**
+     * @brief How the shards are made the same size, so that each of them has the same number of batches. The default is
+     *        @ref MINST_SHARD_PAD.
+     * */
+    enum minst_shard_mode shard_mode;
+
+    /**
+     * @brief What happens to the last batch of an epoch. The default is @ref MINST_TAIL_WRAP. With sharding, this
+     *        applies to the elements of the shard.
+     * */
+    enum minst_tail_mode tail_mode;
+
+    /**
+     * @brief An optional path to a packed cache file, which holds the elements already in their output form. The
+     *        default is null.
+     *
+     * @details When this is set, the cache is memory mapped instead of reading the dataset files, so that opening the
+     *          dataset and getting the first batch cost next to nothing. If the cache does not exist, was built with
+     *          different formats or output options, or the dataset files have changed since, it is rebuilt first with
+     *          @ref minst_cache_build. The I/O mode is not used when reading from a cache.
+     * */
+    const char* cache_path;
+
+    /**
+     * @brief The augmentations applied to the samples. These require @ref MINST_OUTPUT_F32 samples of rank three or
+     *        more. The random values of each sample come from its own generator, which is seeded from the seed, the
+     *        epoch number and the position of the sample in the global order of the epoch, so the results can be
+     *        reproduced, do not depend on the number of threads, and differ between the shards of each rank. By
+     *        default, no augmentations are applied.
+     * */
+    struct minst_augment augment;
+
+    /**
+     * @brief The layout of the samples of each batch. This is applied after the samples have been converted and
+     *        augmented, and disables passing batches directly from memory mapped files. By default, the samples are
+     *        packed.
+     * */
+    struct minst_layout sample_layout;
+
+    /**
+     * @brief Where to store the statistics of the dataset, or null to not collect any. The default is null.
+     *
+     * @details Collecting statistics reads the clock a few times for each element, which is why it is off by default.
+     *          When it is off, the loader only checks this pointer. The totals are stored here when the dataset is
+     *          closed, and can be read while it is open with @ref minst_dataset_stats.
+     * */
+    struct minst_stats* stats;
+  };
+
+  /**
+   * @brief The state of a small and fast pseudo-random number generator (PCG32). Each generator is independent, so it
+   *        can be used from any thread without locking, as long as it is not shared between threads.
+   * */
+  struct minst_rng
+  {
+    uint64_t state;
+
+    uint64_t inc;
+  };
+
+  /**
+   * @brief A pseudo-random permutation of the indices [0, num_elements), which is computed one index at a time instead
+   *        of being stored in a table.
+   * */
+  struct minst_permutation
+  {
+    uint32_t num_elements;
+
+    uint32_t half_bits;
+
+    uint32_t keys[4];
+  };
+
+  /**
+   * @brief An opened dataset, which can be iterated over many epochs.
+   *
+   * @details The dataset keeps the files (or their mappings), the checked formats, the batch buffers and the sampler
+   *          state between epochs, so that starting a new epoch only costs a reshuffle.
+   * */
+  struct minst_dataset;
+
+  /**
+   * @brief An IDX file that is being written.
+   *
+   * @details Elements are either appended in order through a large staging buffer, or written at their position in
+   *          the file. Writing at a position goes straight to the file and can be done from several threads at once,
+   *          as long as the threads write disjoint elements.
+   * */
+  struct minst_writer;
+
+  /**
+   * @brief A logical dataset made of elements of one or more pairs of dataset files.
+   *
+   * @details A view is either a pair of files, a range or a selection of the elements of another view, or several
+   *          views one after another. Views that are made from other views share their opened files (or mappings)
+   *          instead of copying any elements, and the files stay open until the last view that refers to them is
+   *          closed. Creating and closing views is not thread safe, but a view can be read by several datasets at once.
+   * */
+  struct minst_view;
+
+  /**
+   * @brief A batch of elements taken from a dataset.
+   * */
+  struct minst_batch
+  {
+    /**
+     * @brief The sample data of the batch, laid out as described by the sample shape and strides.
+     * */
+    const void* samples;
+
+    /**
+     * @brief The label data of the batch, with the elements stored one after another.
+     * */
+    const void* labels;
+
+    /**
+     * @brief The number of elements in the batch. This is the batch size, except for the last batch of an epoch with
+     *        @ref MINST_TAIL_PARTIAL, and zero when the end of the epoch has been reached.
+     * */
+    uint32_t size;
+
+    /**
+     * @brief The number of dimensions of the sample data, including the batch dimension. This is the rank of the sample
+     *        format, or four when the channels are stored first.
+     * */
+    uint8_t sample_rank;
+
+    /**
+     * @brief The shape of the sample data in memory order, including the padding, starting with the batch size.
+     * */
+    uint32_t sample_shape[MINST_MAX_RANK];
+
+    /**
+     * @brief The distance, in bytes, between two consecutive indices of each dimension of the sample shape. The first
+     *        entry is the distance between two samples.
+     * */
+    size_t sample_strides[MINST_MAX_RANK];
+  };
+
+  /**
+   * @brief A type definition for the function used to pass sample data to.
+   *
+   * @param callback_data User defined data passed from the calling environment.
+   *
+   * @param sample The sample data of one batch, in row major format.
+   *
+   * @param label The ground truth labels of the batch.
+   *
+   * @return Zero on success, or any other value if an error occurred, which stops the loop with
+   *         @ref MINST_ERR_CALLBACK. Predictions are scored with @ref minst_evaluate instead.
+   * */
+  typedef int (*minst_callback)(void* callback_data, const void* sample, const void* label);
+
+  /**
+   * @brief Like @ref minst_callback, but also passed the number of elements in the batch, which is less than the batch
+   *        size for the last batch with @ref MINST_TAIL_PARTIAL.
+   * */
+  typedef int (*minst_batch_callback)(void* callback_data, const void* sample, const void* label, uint32_t count);
+
+  /**
+   * @brief A type definition for a model that predicts the class of each element of a batch.
+   *
+   * @param callback_data User defined data passed from the calling environment. This is shared by all threads.
+   *
+   * @param thread_idx The index of the calling thread, which is less than the number of threads. This can be used to
+   *                   keep separate model state for each thread.
+   *
+   * @param batch The batch to predict. The labels are 32-bit integers in native byte order. The size of the batch is
+   *              the number of elements to predict, which is less than the batch size at the end of a shard.
+   *
+   * @param predictions Receives the predicted class of each element of the batch.
+   *
+   * @return Zero on success, or any other value if an error occurred.
+   * */
+  typedef int (*minst_predict_callback)(void* callback_data,
+                                        uint32_t thread_idx,
+                                        const struct minst_batch* batch,
+                                        uint32_t* predictions);
+
+  /**
+   * @brief The scores of a model on a dataset, as computed by @ref minst_evaluate. The arrays are allocated by the
+   *        library and released with @ref minst_eval_result_free.
+   * */
+  struct minst_eval_result
+  {
+    /**
+     * @brief The number of classes.
+     * */
+    uint32_t num_classes;
+
+    /**
+     * @brief The number of elements that were predicted, which is every element of the dataset once.
+     * */
+    uint64_t num_elements;
+
+    /**
+     * @brief The number of elements whose predicted class is their label.
+     * */
+    uint64_t num_correct;
+
+    /**
+     * @brief The fraction of elements that were predicted correctly.
+     * */
+    double accuracy;
+
+    /**
+     * @brief The confusion matrix, with one row for each label and one column for each predicted class. The entry at
+     *        confusion[label * num_classes + prediction] counts the elements with that label and prediction.
+     * */
+    uint64_t* confusion;
+
+    /**
+     * @brief The precision of each class, which is the fraction of the elements predicted as the class that have it
+     *        as their label. This is zero for classes that were never predicted.
+     * */
+    double* precision;
+
+    /**
+     * @brief The recall of each class, which is the fraction of the elements labeled with the class that were
+     *        predicted as the class. This is zero for classes that do not occur.
+     * */
+    double* recall;
+  };
+
+  /**
+   * @brief The statistics of the values of a dataset, as computed by @ref minst_compute_stats. The values are in the
+   *        units of the file, before any scaling. To normalize with a sample scale s, use s * mean as the sample mean
+   *        and s * std as the sample standard deviation. The arrays are allocated by the library and released with
+   *        @ref minst_data_stats_free.
+   * */
+  struct minst_data_stats
+  {
+    /**
+     * @brief The number of elements in the dataset.
+     * */
+    uint64_t num_elements;
+
+    /**
+     * @brief The number of values in each sample, such as the number of pixels.
+     * */
+    uint32_t num_features;
+
+    /**
+     * @brief The mean of all values of all samples.
+     * */
+    double mean;
+
+    /**
+     * @brief The standard deviation of all values of all samples, over the whole population.
+     * */
+    double std;
+
+    /**
+     * @brief The smallest value of all samples.
+     * */
+    double min;
+
+    /**
+     * @brief The largest value of all samples.
+     * */
+    double max;
+
+    /**
+     * @brief The mean of each value position over all samples, with one entry per feature.
+     * */
+    double* feature_mean;
+
+    /**
+     * @brief The standard deviation of each value position over all samples, with one entry per feature.
+     * */
+    double* feature_std;
+
+    /**
+     * @brief The smallest value at each position, with one entry per feature.
+     * */
+    double* feature_min;
+
+    /**
+     * @brief The largest value at each position, with one entry per feature.
+     * */
+    double* feature_max;
+
+    /**
+     * @brief The number of classes, which is one more than the largest label, or zero without labels.
+     * */
+    uint32_t num_classes;
+
+    /**
+     * @brief The number of elements with each label, with one entry per class.
+     * */
+    uint64_t* label_counts;
+  };
+
+  /**
+   * @brief Chooses a sample from the dataset.
+   *
+   * @param callback_data The user defined sampler data passed from the calling environment.
+   *
+   * @param num_elements The number of elements in the dataset.
+   *
+   * @param element_idx The index of the chosen element.
+   *
+   * @return Zero on success, negative one on failure.
+   * */
+  typedef int (*minst_sampler)(void* sampler_data, uint32_t num_elements, uint32_t* element_idx);
+
+  /**
+   * @brief Converts an error enum to a human-readable string.
+   *
+   * @param err The error to convert to a string.
+   *
+   * @return The human-readable error string.
+   * */
+  const char* minst_strerror(enum minst_error err);
+
+  /**
+   * @brief Computes the size, in bytes, of one element in a given format.
+   *
+   * @param fmt The format to compute the element size of.
+   *
+   * @return The number of bytes that one element consists of.
+   * */
+  uint32_t minst_element_size(const struct minst_format* fmt);
+
+  /**
+   * @brief Describes the sample data that the batches of a dataset will have, without opening the dataset. This is
+   *        the same as the sample rank, shape and strides of each batch, so that buffers and kernels can be prepared in
+   *        advance.
+   *
+   * @param format The format of the samples.
+   *
+   * @param output The form in which the samples are passed on.
+   *
+   * @param layout The layout of the samples, or null for packed samples.
+   *
+   * @param batch_size The number of elements in each batch.
+   *
+   * @param batch Receives the sample rank, shape and strides. The other fields are cleared.
+   *
+   * @return If the layout does not fit the format, @ref MINST_ERR_INVALID_ARGUMENT is returned. Otherwise,
+   *         @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_layout_describe(const struct minst_format* format,
+                                         enum minst_output output,
+                                         const struct minst_layout* layout,
+                                         uint32_t batch_size,
+                                         struct minst_batch* batch);
+
+  /**
+   * @brief Reads the format of a dataset file from its header.
+   *
+   * @param path The path to the dataset file. When built with zlib, this may also be a gzip compressed file.
+   *
+   * @param format Receives the format of the file. Dimensions beyond the rank of the file are set to one.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_read_format(const char* path, struct minst_format* format);
+
+  /**
+   * @brief Loops through the dataset.
+   *
+   * @param samples_path The path to the samples file.
+   *
+   * @param labels_path The path to the labels file.
+   *
+   * @param callback_data Optional user-defined data to pass to the callback
+   *                      functions.
+   *
+   * @param callback The function to pass the sample and label data to.
+   *
+   * @param sampler An optional user-defined sampler (the default is random
+   *                sampling via Fisher–Yates shuffle).
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_eval(const char* samples_path,
+                              const char* labels_path,
+                              const struct minst_format* sample_format,
+                              const struct minst_format* label_format,
+                              uint32_t batch_size,
+                              void* callback_data,
+                              const minst_callback callback,
+                              void* sampler_data,
+                              minst_sampler sampler);
+
+  /**
+   * @brief Initializes the options structure with the default values.
+   *
+   * @param options The options structure to initialize.
+   * */
+  void minst_options_init(struct minst_options* options);
+
+  /**
+   * @brief Loops through the dataset, with additional options.
+   *
+   * @param options The options to iterate the dataset with. If this is null, the default options are used, which makes
+   *                this function equivalent to @ref minst_eval.
+   *
+   * @note When memory mapping is used, the sample and label pointers passed to the callback may point directly into the
+   *       mapped files. They are only valid until the callback returns and must not be written to.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   *
+   * @see minst_eval
+   * */
+  enum minst_error minst_eval_ex(const char* samples_path,
+                                 const char* labels_path,
+                                 const struct minst_format* sample_format,
+                                 const struct minst_format* label_format,
+                                 uint32_t batch_size,
+                                 void* callback_data,
+                                 const minst_callback callback,
+                                 void* sampler_data,
+                                 minst_sampler sampler,
+                                 const struct minst_options* options);
+
+  /**
+   * @brief Loops through the dataset like @ref minst_eval_ex, passing the number of elements of each batch to the
+   *        callback. Use this with @ref MINST_TAIL_PARTIAL, so that the callback knows the size of the last batch.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_eval_batches(const char* samples_path,
+                                      const char* labels_path,
+                                      const struct minst_format* sample_format,
+                                      const struct minst_format* label_format,
+                                      uint32_t batch_size,
+                                      void* callback_data,
+                                      minst_batch_callback callback,
+                                      void* sampler_data,
+                                      minst_sampler sampler,
+                                      const struct minst_options* options);
+
+  /**
+   * @brief Loops through the elements of a view like @ref minst_eval_batches.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   *
+   * @see minst_dataset_open_view
+   * */
+  enum minst_error minst_eval_view(const struct minst_view* view,
+                                   uint32_t batch_size,
+                                   void* callback_data,
+                                   minst_batch_callback callback,
+                                   void* sampler_data,
+                                   minst_sampler sampler,
+                                   const struct minst_options* options);
+
+  /**
+   * @brief Predicts every element of a dataset once and scores the predictions.
+   *
+   * @details The dataset is split into contiguous ranges, one for each thread. The files are opened once and each
+   *          thread reads its range of them, or with a cache, the cache is checked or built once and each thread maps
+   *          it. Each thread calls the model on its range in file order and counts the outcomes in its own confusion
+   *          matrix, and the matrices are added up once all threads have finished. The shuffling, sampling, sharding
+   *          and augmentation options are not used, and the labels are passed to the model as 32-bit integers.
+   *
+   * @param label_format The format of the labels, which must have one value per element.
+   *
+   * @param num_classes The number of classes. Labels and predictions must be less than this.
+   *
+   * @param num_threads The number of threads that call the model. On platforms without thread support, the ranges are
+   *                    evaluated one after another on the calling thread.
+   *
+   * @param options The options to open the dataset with, or null to use the default options.
+   *
+   * @param result Receives the scores. On failure, it is left empty.
+   *
+   * @return If the model fails, @ref MINST_ERR_CALLBACK is returned. If a label or a prediction is not a class,
+   *         @ref MINST_ERR_LABEL_RANGE is returned. If any other error occurs, it is returned by this function.
+   *         Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_evaluate(const char* samples_path,
+                                  const char* labels_path,
+                                  const struct minst_format* sample_format,
+                                  const struct minst_format* label_format,
+                                  uint32_t batch_size,
+                                  uint32_t num_classes,
+                                  uint32_t num_threads,
+                                  void* callback_data,
+                                  minst_predict_callback callback,
+                                  const struct minst_options* options,
+                                  struct minst_eval_result* result);
+
+  /**
+   * @brief Releases the arrays of an evaluation result.
+   * */
+  void minst_eval_result_free(struct minst_eval_result* result);
+
+  /**
+   * @brief Opens a dataset for iterating over one or more epochs.
+   *
+   * @param dataset Receives the opened dataset. On failure, this is set to null.
+   *
+   * @param samples_path The path to the samples file.
+   *
+   * @param labels_path The path to the labels file.
+   *
+   * @param batch_size The number of elements in each batch. Must not be zero.
+   *
+   * @param sampler_data Optional user-defined data to pass to the sampler.
+   *
+   * @param sampler An optional user-defined sampler. If this is null, the default sampler is chosen according to the
+   *                options.
+   *
+   * @param options The options to open the dataset with, or null to use the default options.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_dataset_open(struct minst_dataset** dataset,
+                                      const char* samples_path,
+                                      const char* labels_path,
+                                      const struct minst_format* sample_format,
+                                      const struct minst_format* label_format,
+                                      uint32_t batch_size,
+                                      void* sampler_data,
+                                      minst_sampler sampler,
+                                      const struct minst_options* options);
+
+  /**
+   * @brief Opens a dataset over the elements of a view, which is used like a pair of files.
+   *
+   * @param view The view to iterate. It must stay open until the dataset is closed.
+   *
+   * @param options The options to open the dataset with, or null to use the default options. Views can not be cached,
+   *                so the cache path must be null.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_dataset_open_view(struct minst_dataset** dataset,
+                                           const struct minst_view* view,
+                                           uint32_t batch_size,
+                                           void* sampler_data,
+                                           minst_sampler sampler,
+                                           const struct minst_options* options);
+
+  /**
+   * @brief Closes a dataset and releases all of its resources.
+   *
+   * @param dataset The dataset to close. May be null.
+   * */
+  void minst_dataset_close(struct minst_dataset* dataset);
+
+  /**
+   * @brief Gets the number of batches in one epoch of the dataset.
+   * */
+  uint32_t minst_dataset_num_batches(const struct minst_dataset* dataset);
+
+  /**
+   * @brief Starts a new epoch. The default sampler moves on to the permutation of the next epoch, and the batch count is
+   *        reset.
+   *
+   * @note A freshly opened dataset is already positioned at the start of its first epoch.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_dataset_next_epoch(struct minst_dataset* dataset);
+
+  /**
+   * @brief Gets the next batch of the current epoch.
+   *
+   * @param batch Receives the batch. When the epoch is complete, the size of the batch is set to zero.
+   *
+   * @note The batch data is owned by the dataset and is only valid until the next call to this function, or until the
+   *       dataset is closed.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_dataset_next_batch(struct minst_dataset* dataset, struct minst_batch* batch);
+
+  /**
+   * @brief Gets the statistics that a dataset has collected so far.
+   *
+   * @param stats Receives the totals. These are all zero unless the dataset was opened with @ref minst_options::stats.
+   *
+   * @note With prefetching, the work of the background thread is included up to the last batch it has finished.
+   * */
+  void minst_dataset_stats(struct minst_dataset* dataset, struct minst_stats* stats);
+
+  /**
+   * @brief Builds a packed cache file from a pair of dataset files.
+   *
+   * @details The cache starts with a page-sized header, which records the formats, the output options and a checksum
+   *          of the dataset files. It is followed by the samples and then the labels, each starting on a page boundary
+   *          and stored in their output form (such as normalized floats) in native byte order. The cache is written to
+   *          a temporary file first, which then replaces the cache, so that a cache is never seen half written.
+   *
+   * @param cache_path The path of the cache file to write.
+   *
+   * @param options The output options to convert the elements with, or null to use the default options. The sampling
+   *                options are not used.
+   *
+   * @return If an error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_cache_build(const char* cache_path,
+                                     const char* samples_path,
+                                     const char* labels_path,
+                                     const struct minst_format* sample_format,
+                                     const struct minst_format* label_format,
+                                     const struct minst_options* options);
+
+  /**
+   * @brief Computes the statistics of the samples and labels of a dataset with one pass over the files.
+   *
+   * @details The elements are split into contiguous ranges, one for each thread, and each thread adds up its own
+   *          partial sums, which are combined at the end. The values are read in double precision, and the sums are
+   *          taken around the values of the first element, so that a large mean does not cancel out the variance. The
+   *          labels must be of an integer type and are counted on the calling thread.
+   *
+   * @param labels_path The path to the labels file, or null to leave the labels out.
+   *
+   * @param num_threads The number of threads that read the samples, including the calling thread. On platforms
+   *                    without thread support, this is treated as one.
+   *
+   * @param stats_path An optional path to a file that keeps the statistics next to the dataset, or null. If the file
+   *                   was computed from dataset files with the same formats and contents, the statistics are read from
+   *                   it instead of the dataset. Otherwise, they are computed and the file is written.
+   *
+   * @param stats Receives the statistics. On failure, it is left empty.
+   *
+   * @return If a label is negative, @ref MINST_ERR_LABEL_RANGE is returned. If the stats file can not be written,
+   *         @ref MINST_ERR_WRITE is returned. If any other error occurs, it is returned by this function. Otherwise,
+   *         @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_compute_stats(const char* samples_path,
+                                       const char* labels_path,
+                                       const struct minst_format* sample_format,
+                                       const struct minst_format* label_format,
+                                       uint32_t num_threads,
+                                       const char* stats_path,
+                                       struct minst_data_stats* stats);
+
+  /**
+   * @brief Releases the arrays of dataset statistics.
+   * */
+  void minst_data_stats_free(struct minst_data_stats* stats);
+
+  /**
+   * @brief Creates an IDX file and writes its header.
+   *
+   * @param writer Receives the writer. On failure, this is set to null.
+   *
+   * @param path The path of the file to write. An existing file is replaced.
+   *
+   * @param format The format of the file. The first dimension is the number of elements that the file will hold.
+   *
+   * @param mode How the file is sized.
+   *
+   * @return If the file can not be created or its header can not be written, @ref MINST_ERR_WRITE is returned. If any
+   *         other error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_writer_open(struct minst_writer** writer,
+                                     const char* path,
+                                     const struct minst_format* format,
+                                     enum minst_write_mode mode);
+
+  /**
+   * @brief Appends elements after the last appended elements. The first call starts at the first element.
+   *
+   * @param data The values of the elements, in native byte order. They are converted to big-endian as they are
+   *             staged, so the data is not modified.
+   *
+   * @param count The number of elements to append.
+   *
+   * @note This must not be called at the same time as any other function of the same writer.
+   *
+   * @return If the elements would go past the number of elements of the format, @ref MINST_ERR_INVALID_ARGUMENT is
+   *         returned. If writing fails, @ref MINST_ERR_WRITE is returned. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_writer_append(struct minst_writer* writer, const void* data, uint32_t count);
+
+  /**
+   * @brief Writes elements at their position in the file, without going through the staging buffer.
+   *
+   * @param element_idx The index of the first element to write.
+   *
+   * @param data The values of the elements, in native byte order.
+   *
+   * @param count The number of elements to write.
+   *
+   * @note On platforms with thread support, this may be called from several threads at once for disjoint elements.
+   *       It must not be called at the same time as @ref minst_writer_append.
+   *
+   * @return If the elements would go past the number of elements of the format, @ref MINST_ERR_INVALID_ARGUMENT is
+   *         returned. If writing fails, @ref MINST_ERR_WRITE is returned. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_writer_write_at(struct minst_writer* writer,
+                                         uint32_t element_idx,
+                                         const void* data,
+                                         uint32_t count);
+
+  /**
+   * @brief Flushes the staged elements, closes the file and releases the writer.
+   *
+   * @param writer The writer to close. May be null.
+   *
+   * @return If flushing or closing the file fails, @ref MINST_ERR_WRITE is returned. Otherwise, @ref MINST_ERR_NONE is
+   *         returned.
+   * */
+  enum minst_error minst_writer_close(struct minst_writer* writer);
+
+  /**
+   * @brief Opens a pair of dataset files as a view of all of their elements.
+   *
+   * @param view Receives the view. On failure, this is set to null.
+   *
+   * @param io_mode How the files are accessed. Compressed files are always inflated into memory, since a view may be
+   *                read from anywhere by several datasets.
+   *
+   * @return If the formats do not have the same number of elements, @ref MINST_ERR_SHAPE is returned. If any other
+   *         error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_view_open(struct minst_view** view,
+                                   const char* samples_path,
+                                   const char* labels_path,
+                                   const struct minst_format* sample_format,
+                                   const struct minst_format* label_format,
+                                   enum minst_io_mode io_mode);
+
+  /**
+   * @brief Creates a view of a range of consecutive elements of another view.
+   *
+   * @param first The index of the first element of the range in the parent view.
+   *
+   * @param count The number of elements in the range.
+   *
+   * @return If the range goes past the end of the parent view, @ref MINST_ERR_INVALID_ARGUMENT is returned. If any
+   *         other error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_view_range(struct minst_view** view,
+                                    const struct minst_view* parent,
+                                    uint32_t first,
+                                    uint32_t count);
+
+  /**
+   * @brief Creates a view of a list of elements of another view, in the order of the list. An element may be listed
+   *        more than once.
+   *
+   * @param indices The indices of the elements in the parent view. The list is copied.
+   *
+   * @param count The number of indices.
+   *
+   * @return If an index is not less than the size of the parent view, @ref MINST_ERR_INVALID_ARGUMENT is returned. If
+   *         any other error occurs, it is returned by this function. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_view_select(struct minst_view** view,
+                                     const struct minst_view* parent,
+                                     const uint32_t* indices,
+                                     uint32_t count);
+
+  /**
+   * @brief Creates a view of the elements of several views, one view after another.
+   *
+   * @param parts The views to join. Their formats may only differ in the number of elements.
+   *
+   * @return If the types of the parts differ, @ref MINST_ERR_TYPE is returned. If the shapes of their elements differ,
+   *         @ref MINST_ERR_SHAPE is returned. If there are no parts or more than 2^32 - 1 elements in total,
+   *         @ref MINST_ERR_INVALID_ARGUMENT is returned. Otherwise, @ref MINST_ERR_NONE is returned.
+   * */
+  enum minst_error minst_view_concat(struct minst_view** view,
+                                     const struct minst_view* const* parts,
+                                     uint32_t num_parts);
+
+  /**
+   * @brief Gets the number of elements of a view.
+   * */
+  uint32_t minst_view_size(const struct minst_view* view);
+
+  /**
+   * @brief Gets the formats of the elements of a view. The first dimension of each format is the size of the view.
+   * */
+  void minst_view_formats(const struct minst_view* view,
+                          struct minst_format* sample_format,
+                          struct minst_format* label_format);
+
+  /**
+   * @brief Closes a view. The files of the view are closed once no other view refers to them.
+   *
+   * @param view The view to close. May be null.
+   * */
+  void minst_view_close(struct minst_view* view);
+
+  /**
+   * @brief Seeds a random number generator.
+   *
+   * @param rng The generator to seed.
+   *
+   * @param seed The starting point of the sequence.
+   *
+   * @param stream Selects one of many independent sequences, so that generators with the same seed but a different
+   *               stream do not produce correlated numbers.
+   * */
+  void minst_rng_seed(struct minst_rng* rng, uint64_t seed, uint64_t stream);
+
+  /**
+   * @brief Generates a uniformly distributed 32-bit number.
+   * */
+  uint32_t minst_rng_next(struct minst_rng* rng);
+
+  /**
+   * @brief Generates a uniformly distributed number in the range [0, bound), without modulo bias.
+   *
+   * @param bound The upper bound of the range. Must not be zero.
+   * */
+  uint32_t minst_rng_bounded(struct minst_rng* rng, uint32_t bound);
+
+  /**
+   * @brief Initializes a permutation of [0, num_elements). The same seed and epoch always result in the same
+   *        permutation, and this function takes constant time regardless of the number of elements.
+   *
+   * @param perm The permutation to initialize.
+   *
+   * @param num_elements The number of elements to permute.
+   *
+   * @param seed The seed of the permutation.
+   *
+   * @param epoch The epoch number, which selects a different permutation for the same seed.
+   * */
+  void minst_permutation_init(struct minst_permutation* perm, uint32_t num_elements, uint64_t seed, uint64_t epoch);
+
+  /**
+   * @brief Computes the element at a given position of a permutation. Each position maps to a distinct element, so
+   *        positions can be computed in any order and from several threads at once.
+   *
+   * @param perm The permutation, which is not modified.
+   *
+   * @param idx The position in the permutation. Must be less than the number of elements.
+   *
+   * @return The element at the position.
+   * */
+  uint32_t minst_permute(const struct minst_permutation* perm, uint32_t idx);
 
   extern const struct minst_format minst_fashion_train_sample_format;
 
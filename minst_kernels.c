@@ -0,0 +1,1410 @@
+#include "minst_kernels.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define MINST_HAVE_SSE2 1
+#define MINST_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MINST_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* All kernels compute the affine transform as a separate multiply and add, so that every code path rounds the same way
+ * and the output does not depend on which kernel was chosen at runtime. */
+
+static uint32_t
+minst_load_be16(const uint8_t* data)
+{
+  return (((uint32_t)data[0]) << 8) | ((uint32_t)data[1]);
+}
+
+static uint32_t
+minst_load_be32(const uint8_t* data)
+{
+  return (((uint32_t)data[0]) << 24) | (((uint32_t)data[1]) << 16) | (((uint32_t)data[2]) << 8) | ((uint32_t)data[3]);
+}
+
+/* scalar kernels */
+
+static void
+minst_convert_u8_scalar(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = ((float)in[i]) * scale + bias;
+  }
+}
+
+static void
+minst_convert_i8_scalar(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const int8_t* in = (const int8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = ((float)in[i]) * scale + bias;
+  }
+}
+
+static void
+minst_convert_i16_scalar(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = ((float)(int16_t)minst_load_be16(in + i * 2)) * scale + bias;
+  }
+}
+
+static void
+minst_convert_i32_scalar(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = ((float)(int32_t)minst_load_be32(in + i * 4)) * scale + bias;
+  }
+}
+
+static void
+minst_convert_f32_scalar(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint32_t bits;
+  float value;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    bits = minst_load_be32(in + i * 4);
+    memcpy(&value, &bits, sizeof(value));
+    dst[i] = value * scale + bias;
+  }
+}
+
+static void
+minst_convert_f64_scalar(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint64_t bits;
+  double value;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    bits = (((uint64_t)minst_load_be32(in + i * 8)) << 32) | ((uint64_t)minst_load_be32(in + i * 8 + 4));
+    memcpy(&value, &bits, sizeof(value));
+    dst[i] = ((float)value) * scale + bias;
+  }
+}
+
+static const minst_convert_f32_func minst_convert_f32_scalar_table[] = { minst_convert_u8_scalar,
+                                                                          minst_convert_i8_scalar,
+                                                                          minst_convert_i16_scalar,
+                                                                          minst_convert_i32_scalar,
+                                                                          minst_convert_f32_scalar,
+                                                                          minst_convert_f64_scalar };
+
+#ifdef MINST_HAVE_SSE2
+
+static __m128
+minst_affine_sse2(const __m128 x, const __m128 scale, const __m128 bias)
+{
+  return _mm_add_ps(_mm_mul_ps(x, scale), bias);
+}
+
+/* reverses the bytes of each 32-bit lane */
+static __m128i
+minst_bswap32_sse2(__m128i v)
+{
+  v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+}
+
+static void
+minst_convert_u8_sse2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 b = _mm_set1_ps(bias);
+  __m128i v;
+  __m128i lo;
+  __m128i hi;
+  size_t i;
+
+  for (i = 0; (i + 16) <= count; i += 16) {
+    v = _mm_loadu_si128((const __m128i*)(in + i));
+    lo = _mm_unpacklo_epi8(v, zero);
+    hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_ps(dst + i, minst_affine_sse2(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), s, b));
+    _mm_storeu_ps(dst + i + 4, minst_affine_sse2(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), s, b));
+    _mm_storeu_ps(dst + i + 8, minst_affine_sse2(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), s, b));
+    _mm_storeu_ps(dst + i + 12, minst_affine_sse2(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), s, b));
+  }
+
+  minst_convert_u8_scalar(in + i, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_i8_sse2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 b = _mm_set1_ps(bias);
+  __m128i v;
+  __m128i lo;
+  __m128i hi;
+  size_t i;
+
+  for (i = 0; (i + 16) <= count; i += 16) {
+    v = _mm_loadu_si128((const __m128i*)(in + i));
+    /* interleaving a byte with itself and shifting right arithmetically sign extends it */
+    lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+    hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+    _mm_storeu_ps(dst + i, minst_affine_sse2(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), s, b));
+    _mm_storeu_ps(dst + i + 4,
+                  minst_affine_sse2(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), s, b));
+    _mm_storeu_ps(dst + i + 8,
+                  minst_affine_sse2(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), s, b));
+    _mm_storeu_ps(dst + i + 12,
+                  minst_affine_sse2(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), s, b));
+  }
+
+  minst_convert_i8_scalar(in + i, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_i16_sse2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 b = _mm_set1_ps(bias);
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v = _mm_loadu_si128((const __m128i*)(in + i * 2));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_ps(dst + i, minst_affine_sse2(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), s, b));
+    _mm_storeu_ps(dst + i + 4, minst_affine_sse2(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), s, b));
+  }
+
+  minst_convert_i16_scalar(in + i * 2, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_i32_sse2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 b = _mm_set1_ps(bias);
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    v = minst_bswap32_sse2(_mm_loadu_si128((const __m128i*)(in + i * 4)));
+    _mm_storeu_ps(dst + i, minst_affine_sse2(_mm_cvtepi32_ps(v), s, b));
+  }
+
+  minst_convert_i32_scalar(in + i * 4, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_f32_sse2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 b = _mm_set1_ps(bias);
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    v = minst_bswap32_sse2(_mm_loadu_si128((const __m128i*)(in + i * 4)));
+    _mm_storeu_ps(dst + i, minst_affine_sse2(_mm_castsi128_ps(v), s, b));
+  }
+
+  minst_convert_f32_scalar(in + i * 4, dst + i, count - i, scale, bias);
+}
+
+static const minst_convert_f32_func minst_convert_f32_sse2_table[] = { minst_convert_u8_sse2,
+                                                                        minst_convert_i8_sse2,
+                                                                        minst_convert_i16_sse2,
+                                                                        minst_convert_i32_sse2,
+                                                                        minst_convert_f32_sse2,
+                                                                        minst_convert_f64_scalar };
+
+#endif /* MINST_HAVE_SSE2 */
+
+#ifdef MINST_HAVE_AVX2
+
+#define MINST_AVX2 __attribute__((target("avx2")))
+
+MINST_AVX2 static __m256
+minst_affine_avx2(const __m256 x, const __m256 scale, const __m256 bias)
+{
+  return _mm256_add_ps(_mm256_mul_ps(x, scale), bias);
+}
+
+MINST_AVX2 static __m256i
+minst_bswap32_avx2(const __m256i v)
+{
+  const __m256i mask =
+    _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  return _mm256_shuffle_epi8(v, mask);
+}
+
+MINST_AVX2 static void
+minst_convert_u8_avx2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 16) <= count; i += 16) {
+    v = _mm_loadu_si128((const __m128i*)(in + i));
+    _mm256_storeu_ps(dst + i, minst_affine_avx2(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), s, b));
+    _mm256_storeu_ps(dst + i + 8,
+                     minst_affine_avx2(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8))), s, b));
+  }
+
+  minst_convert_u8_scalar(in + i, dst + i, count - i, scale, bias);
+}
+
+MINST_AVX2 static void
+minst_convert_i8_avx2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 16) <= count; i += 16) {
+    v = _mm_loadu_si128((const __m128i*)(in + i));
+    _mm256_storeu_ps(dst + i, minst_affine_avx2(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)), s, b));
+    _mm256_storeu_ps(dst + i + 8,
+                     minst_affine_avx2(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(v, 8))), s, b));
+  }
+
+  minst_convert_i8_scalar(in + i, dst + i, count - i, scale, bias);
+}
+
+MINST_AVX2 static void
+minst_convert_i16_avx2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i * 2)), mask);
+    _mm256_storeu_ps(dst + i, minst_affine_avx2(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), s, b));
+  }
+
+  minst_convert_i16_scalar(in + i * 2, dst + i, count - i, scale, bias);
+}
+
+MINST_AVX2 static void
+minst_convert_i32_avx2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  __m256i v;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v = minst_bswap32_avx2(_mm256_loadu_si256((const __m256i*)(in + i * 4)));
+    _mm256_storeu_ps(dst + i, minst_affine_avx2(_mm256_cvtepi32_ps(v), s, b));
+  }
+
+  minst_convert_i32_scalar(in + i * 4, dst + i, count - i, scale, bias);
+}
+
+MINST_AVX2 static void
+minst_convert_f32_avx2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m256 s = _mm256_set1_ps(scale);
+  const __m256 b = _mm256_set1_ps(bias);
+  __m256i v;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v = minst_bswap32_avx2(_mm256_loadu_si256((const __m256i*)(in + i * 4)));
+    _mm256_storeu_ps(dst + i, minst_affine_avx2(_mm256_castsi256_ps(v), s, b));
+  }
+
+  minst_convert_f32_scalar(in + i * 4, dst + i, count - i, scale, bias);
+}
+
+MINST_AVX2 static void
+minst_convert_f64_avx2(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const __m256i mask =
+    _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const __m128 s = _mm_set1_ps(scale);
+  const __m128 b = _mm_set1_ps(bias);
+  __m256i v;
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + i * 8)), mask);
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm256_cvtpd_ps(_mm256_castsi256_pd(v)), s), b));
+  }
+
+  minst_convert_f64_scalar(in + i * 8, dst + i, count - i, scale, bias);
+}
+
+static const minst_convert_f32_func minst_convert_f32_avx2_table[] = { minst_convert_u8_avx2,
+                                                                        minst_convert_i8_avx2,
+                                                                        minst_convert_i16_avx2,
+                                                                        minst_convert_i32_avx2,
+                                                                        minst_convert_f32_avx2,
+                                                                        minst_convert_f64_avx2 };
+
+#endif /* MINST_HAVE_AVX2 */
+
+#ifdef MINST_HAVE_NEON
+
+static float32x4_t
+minst_affine_neon(const float32x4_t x, const float32x4_t scale, const float32x4_t bias)
+{
+  return vaddq_f32(vmulq_f32(x, scale), bias);
+}
+
+static void
+minst_convert_u8_neon(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  uint8x16_t v;
+  uint16x8_t lo;
+  uint16x8_t hi;
+  size_t i;
+
+  for (i = 0; (i + 16) <= count; i += 16) {
+    v = vld1q_u8(in + i);
+    lo = vmovl_u8(vget_low_u8(v));
+    hi = vmovl_u8(vget_high_u8(v));
+    vst1q_f32(dst + i, minst_affine_neon(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), s, b));
+    vst1q_f32(dst + i + 4, minst_affine_neon(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), s, b));
+    vst1q_f32(dst + i + 8, minst_affine_neon(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), s, b));
+    vst1q_f32(dst + i + 12, minst_affine_neon(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), s, b));
+  }
+
+  minst_convert_u8_scalar(in + i, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_i8_neon(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const int8_t* in = (const int8_t*)src;
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  int8x16_t v;
+  int16x8_t lo;
+  int16x8_t hi;
+  size_t i;
+
+  for (i = 0; (i + 16) <= count; i += 16) {
+    v = vld1q_s8(in + i);
+    lo = vmovl_s8(vget_low_s8(v));
+    hi = vmovl_s8(vget_high_s8(v));
+    vst1q_f32(dst + i, minst_affine_neon(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), s, b));
+    vst1q_f32(dst + i + 4, minst_affine_neon(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), s, b));
+    vst1q_f32(dst + i + 8, minst_affine_neon(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), s, b));
+    vst1q_f32(dst + i + 12, minst_affine_neon(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), s, b));
+  }
+
+  minst_convert_i8_scalar(in + i, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_i16_neon(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  int16x8_t v;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v = vreinterpretq_s16_u8(vrev16q_u8(vld1q_u8(in + i * 2)));
+    vst1q_f32(dst + i, minst_affine_neon(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), s, b));
+    vst1q_f32(dst + i + 4, minst_affine_neon(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), s, b));
+  }
+
+  minst_convert_i16_scalar(in + i * 2, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_i32_neon(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    vst1q_f32(dst + i,
+              minst_affine_neon(vcvtq_f32_s32(vreinterpretq_s32_u8(vrev32q_u8(vld1q_u8(in + i * 4)))), s, b));
+  }
+
+  minst_convert_i32_scalar(in + i * 4, dst + i, count - i, scale, bias);
+}
+
+static void
+minst_convert_f32_neon(const void* src, float* dst, const size_t count, const float scale, const float bias)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  const float32x4_t s = vdupq_n_f32(scale);
+  const float32x4_t b = vdupq_n_f32(bias);
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    vst1q_f32(dst + i, minst_affine_neon(vreinterpretq_f32_u8(vrev32q_u8(vld1q_u8(in + i * 4))), s, b));
+  }
+
+  minst_convert_f32_scalar(in + i * 4, dst + i, count - i, scale, bias);
+}
+
+static const minst_convert_f32_func minst_convert_f32_neon_table[] = { minst_convert_u8_neon,
+                                                                        minst_convert_i8_neon,
+                                                                        minst_convert_i16_neon,
+                                                                        minst_convert_i32_neon,
+                                                                        minst_convert_f32_neon,
+                                                                        minst_convert_f64_scalar };
+
+#endif /* MINST_HAVE_NEON */
+
+/* byte swapping kernels */
+
+static void
+minst_bswap16_scalar(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i * 2] = in[i * 2 + 1];
+    out[i * 2 + 1] = in[i * 2];
+  }
+}
+
+static void
+minst_bswap32_scalar(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i * 4] = in[i * 4 + 3];
+    out[i * 4 + 1] = in[i * 4 + 2];
+    out[i * 4 + 2] = in[i * 4 + 1];
+    out[i * 4 + 3] = in[i * 4];
+  }
+}
+
+static void
+minst_bswap64_scalar(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < count; i++) {
+    for (j = 0; j < 8; j++) {
+      out[i * 8 + j] = in[i * 8 + 7 - j];
+    }
+  }
+}
+
+#ifdef MINST_HAVE_SSE2
+
+static void
+minst_bswap16_sse2(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    v = _mm_loadu_si128((const __m128i*)(in + i * 2));
+    _mm_storeu_si128((__m128i*)(out + i * 2), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+  }
+
+  minst_bswap16_scalar(in + i * 2, out + i * 2, count - i);
+}
+
+static void
+minst_bswap32_sse2_kernel(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    _mm_storeu_si128((__m128i*)(out + i * 4), minst_bswap32_sse2(_mm_loadu_si128((const __m128i*)(in + i * 4))));
+  }
+
+  minst_bswap32_scalar(in + i * 4, out + i * 4, count - i);
+}
+
+static void
+minst_bswap64_sse2(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  __m128i v;
+  size_t i;
+
+  for (i = 0; (i + 2) <= count; i += 2) {
+    /* swap each 32-bit half, then swap the halves */
+    v = minst_bswap32_sse2(_mm_loadu_si128((const __m128i*)(in + i * 8)));
+    _mm_storeu_si128((__m128i*)(out + i * 8), _mm_shuffle_epi32(v, 0xB1));
+  }
+
+  minst_bswap64_scalar(in + i * 8, out + i * 8, count - i);
+}
+
+#endif /* MINST_HAVE_SSE2 */
+
+#ifdef MINST_HAVE_AVX2
+
+/* swaps the bytes of 32 bytes at a time with a byte shuffle (vpshufb), using a mask for the element size */
+MINST_AVX2 static size_t
+minst_bswap_avx2(const uint8_t* in, uint8_t* out, const size_t size, const __m256i mask)
+{
+  size_t i;
+
+  for (i = 0; (i + 32) <= size; i += 32) {
+    _mm256_storeu_si256((__m256i*)(out + i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + i)), mask));
+  }
+
+  return i;
+}
+
+MINST_AVX2 static void
+minst_bswap16_avx2(const void* src, void* dst, const size_t count)
+{
+  const __m256i mask =
+    _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+  const size_t done = minst_bswap_avx2((const uint8_t*)src, (uint8_t*)dst, count * 2, mask);
+  minst_bswap16_scalar((const uint8_t*)src + done, (uint8_t*)dst + done, count - done / 2);
+}
+
+MINST_AVX2 static void
+minst_bswap32_avx2_kernel(const void* src, void* dst, const size_t count)
+{
+  const __m256i mask =
+    _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const size_t done = minst_bswap_avx2((const uint8_t*)src, (uint8_t*)dst, count * 4, mask);
+  minst_bswap32_scalar((const uint8_t*)src + done, (uint8_t*)dst + done, count - done / 4);
+}
+
+MINST_AVX2 static void
+minst_bswap64_avx2(const void* src, void* dst, const size_t count)
+{
+  const __m256i mask =
+    _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  const size_t done = minst_bswap_avx2((const uint8_t*)src, (uint8_t*)dst, count * 8, mask);
+  minst_bswap64_scalar((const uint8_t*)src + done, (uint8_t*)dst + done, count - done / 8);
+}
+
+#endif /* MINST_HAVE_AVX2 */
+
+#ifdef MINST_HAVE_NEON
+
+static void
+minst_bswap16_neon(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+    vst1q_u8(out + i * 2, vrev16q_u8(vld1q_u8(in + i * 2)));
+  }
+
+  minst_bswap16_scalar(in + i * 2, out + i * 2, count - i);
+}
+
+static void
+minst_bswap32_neon(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+    vst1q_u8(out + i * 4, vrev32q_u8(vld1q_u8(in + i * 4)));
+  }
+
+  minst_bswap32_scalar(in + i * 4, out + i * 4, count - i);
+}
+
+static void
+minst_bswap64_neon(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint8_t* out = (uint8_t*)dst;
+  size_t i;
+
+  for (i = 0; (i + 2) <= count; i += 2) {
+    vst1q_u8(out + i * 8, vrev64q_u8(vld1q_u8(in + i * 8)));
+  }
+
+  minst_bswap64_scalar(in + i * 8, out + i * 8, count - i);
+}
+
+#endif /* MINST_HAVE_NEON */
+
+minst_bswap_func
+minst_get_bswap(const uint32_t type_size)
+{
+  if ((type_size != 2) && (type_size != 4) && (type_size != 8)) {
+    return NULL;
+  }
+
+#ifdef MINST_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return (type_size == 2) ? minst_bswap16_avx2 : ((type_size == 4) ? minst_bswap32_avx2_kernel : minst_bswap64_avx2);
+  }
+#endif
+
+#ifdef MINST_HAVE_SSE2
+  return (type_size == 2) ? minst_bswap16_sse2 : ((type_size == 4) ? minst_bswap32_sse2_kernel : minst_bswap64_sse2);
+#endif
+
+#ifdef MINST_HAVE_NEON
+  return (type_size == 2) ? minst_bswap16_neon : ((type_size == 4) ? minst_bswap32_neon : minst_bswap64_neon);
+#endif
+
+  return (type_size == 2) ? minst_bswap16_scalar : ((type_size == 4) ? minst_bswap32_scalar : minst_bswap64_scalar);
+}
+
+minst_convert_f32_func
+minst_get_convert_f32(const enum minst_type type)
+{
+  if (((int)type < (int)MINST_TYPE_U8) || ((int)type > (int)MINST_TYPE_F64)) {
+    return NULL;
+  }
+
+#ifdef MINST_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return minst_convert_f32_avx2_table[type];
+  }
+#endif
+
+#ifdef MINST_HAVE_SSE2
+  return minst_convert_f32_sse2_table[type];
+#endif
+
+#ifdef MINST_HAVE_NEON
+  return minst_convert_f32_neon_table[type];
+#endif
+
+  return minst_convert_f32_scalar_table[type];
+}
+
+/* widening kernels
+ *
+ * These are only used for labels and other small elements, so they are left to the compiler to vectorize. */
+
+static void
+minst_widen_u8_i32(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  int32_t* out = (int32_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int32_t)in[i];
+  }
+}
+
+static void
+minst_widen_i8_i32(const void* src, void* dst, const size_t count)
+{
+  const int8_t* in = (const int8_t*)src;
+  int32_t* out = (int32_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int32_t)in[i];
+  }
+}
+
+static void
+minst_widen_i16_i32(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  int32_t* out = (int32_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int32_t)(int16_t)minst_load_be16(in + i * 2);
+  }
+}
+
+static void
+minst_widen_i32_i32(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  int32_t* out = (int32_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int32_t)minst_load_be32(in + i * 4);
+  }
+}
+
+static void
+minst_widen_u8_i64(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  int64_t* out = (int64_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int64_t)in[i];
+  }
+}
+
+static void
+minst_widen_i8_i64(const void* src, void* dst, const size_t count)
+{
+  const int8_t* in = (const int8_t*)src;
+  int64_t* out = (int64_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int64_t)in[i];
+  }
+}
+
+static void
+minst_widen_i16_i64(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  int64_t* out = (int64_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int64_t)(int16_t)minst_load_be16(in + i * 2);
+  }
+}
+
+static void
+minst_widen_i32_i64(const void* src, void* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  int64_t* out = (int64_t*)dst;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    out[i] = (int64_t)(int32_t)minst_load_be32(in + i * 4);
+  }
+}
+
+static const minst_widen_func minst_widen_i32_table[] = {
+  minst_widen_u8_i32, minst_widen_i8_i32, minst_widen_i16_i32, minst_widen_i32_i32
+};
+
+static const minst_widen_func minst_widen_i64_table[] = {
+  minst_widen_u8_i64, minst_widen_i8_i64, minst_widen_i16_i64, minst_widen_i32_i64
+};
+
+minst_widen_func
+minst_get_widen(const enum minst_type type, const uint32_t dst_size)
+{
+  if (((int)type < (int)MINST_TYPE_U8) || ((int)type > (int)MINST_TYPE_I32)) {
+    return NULL;
+  }
+
+  if (dst_size == 4) {
+    return minst_widen_i32_table[type];
+  } else if (dst_size == 8) {
+    return minst_widen_i64_table[type];
+  }
+
+  return NULL;
+}
+
+/* double conversion kernels
+ *
+ * These are only used to compute dataset statistics, where reading the file is the bottleneck, so they are left to the
+ * compiler to vectorize. */
+
+static void
+minst_convert_f64_u8(const void* src, double* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = (double)in[i];
+  }
+}
+
+static void
+minst_convert_f64_i8(const void* src, double* dst, const size_t count)
+{
+  const int8_t* in = (const int8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = (double)in[i];
+  }
+}
+
+static void
+minst_convert_f64_i16(const void* src, double* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = (double)(int16_t)minst_load_be16(in + i * 2);
+  }
+}
+
+static void
+minst_convert_f64_i32(const void* src, double* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    dst[i] = (double)(int32_t)minst_load_be32(in + i * 4);
+  }
+}
+
+static void
+minst_convert_f64_f32(const void* src, double* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint32_t bits;
+  float value;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    bits = minst_load_be32(in + i * 4);
+    memcpy(&value, &bits, sizeof(value));
+    dst[i] = (double)value;
+  }
+}
+
+static void
+minst_convert_f64_f64(const void* src, double* dst, const size_t count)
+{
+  const uint8_t* in = (const uint8_t*)src;
+  uint64_t bits;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    bits = (((uint64_t)minst_load_be32(in + i * 8)) << 32) | ((uint64_t)minst_load_be32(in + i * 8 + 4));
+    memcpy(dst + i, &bits, sizeof(double));
+  }
+}
+
+static const minst_convert_f64_func minst_convert_f64_table[] = { minst_convert_f64_u8,
+                                                                  minst_convert_f64_i8,
+                                                                  minst_convert_f64_i16,
+                                                                  minst_convert_f64_i32,
+                                                                  minst_convert_f64_f32,
+                                                                  minst_convert_f64_f64 };
+
+minst_convert_f64_func
+minst_get_convert_f64(const enum minst_type type)
+{
+  if (((int)type < (int)MINST_TYPE_U8) || ((int)type > (int)MINST_TYPE_F64)) {
+    return NULL;
+  }
+
+  return minst_convert_f64_table[type];
+}
+
+/* augmentation kernels
+ *
+ * The warp resamples an image with bilinear filtering, where pixels outside of the image have the fill value. The noise
+ * is derived from a counter-based hash of the pixel index, so that it can be computed for many pixels at once. Each
+ * noise value is the sum of four 16-bit uniform values, scaled to unit variance, which is close to a normal
+ * distribution. SSE2 and NEON have no gather instructions, so those targets use the scalar kernels. */
+
+static uint32_t
+minst_noise_hash(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x7FEB352Du;
+  x ^= x >> 15;
+  x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return x;
+}
+
+static float
+minst_noise_value(const uint32_t key, const uint32_t idx)
+{
+  uint32_t a;
+  uint32_t b;
+  uint32_t sum;
+
+  a = minst_noise_hash(key ^ (idx * 2u));
+  b = minst_noise_hash(key ^ (idx * 2u + 1u));
+
+  sum = (a & 0xFFFFu) + (a >> 16) + (b & 0xFFFFu) + (b >> 16);
+
+  return (((float)sum) + 2.0f) * (1.0f / 65536.0f) - 2.0f;
+}
+
+static void
+minst_noise_scalar(float* data, const size_t count, const uint32_t key, const float std)
+{
+  const float scale = std * 1.7320508f;
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    data[i] = data[i] + minst_noise_value(key, (uint32_t)i) * scale;
+  }
+}
+
+static float
+minst_warp_fetch(const float* src,
+                 const int x,
+                 const int y,
+                 const uint32_t width,
+                 const uint32_t height,
+                 const uint32_t channels,
+                 const uint32_t channel,
+                 const float fill)
+{
+  if ((x < 0) || (y < 0) || (x >= (int)width) || (y >= (int)height)) {
+    return fill;
+  }
+
+  return src[(((size_t)y) * width + ((size_t)x)) * channels + channel];
+}
+
+/* Keeps the coordinates in a range where converting them to integers can not overflow, without changing the result. NaN
+ * is mapped to the lower bound, which is what the vector kernels do, so it samples the fill value. */
+static float
+minst_warp_clamp(const float v, const uint32_t size)
+{
+  const float upper = ((float)size) + 1.0f;
+
+  return !(v >= -2.0f) ? -2.0f : ((v > upper) ? upper : v);
+}
+
+static void
+minst_warp_pixel(const float* src,
+                 float* dst,
+                 float sx,
+                 float sy,
+                 const uint32_t width,
+                 const uint32_t height,
+                 const uint32_t channels,
+                 const float fill)
+{
+  float x0;
+  float y0;
+  float fx;
+  float fy;
+  float top;
+  float bottom;
+  int ix;
+  int iy;
+  uint32_t c;
+
+  sx = minst_warp_clamp(sx, width);
+  sy = minst_warp_clamp(sy, height);
+
+  x0 = (float)(int)sx;
+  x0 = (x0 > sx) ? (x0 - 1.0f) : x0;
+
+  y0 = (float)(int)sy;
+  y0 = (y0 > sy) ? (y0 - 1.0f) : y0;
+
+  fx = sx - x0;
+  fy = sy - y0;
+
+  ix = (int)x0;
+  iy = (int)y0;
+
+  for (c = 0; c < channels; c++) {
+
+    const float p00 = minst_warp_fetch(src, ix, iy, width, height, channels, c, fill);
+    const float p10 = minst_warp_fetch(src, ix + 1, iy, width, height, channels, c, fill);
+    const float p01 = minst_warp_fetch(src, ix, iy + 1, width, height, channels, c, fill);
+    const float p11 = minst_warp_fetch(src, ix + 1, iy + 1, width, height, channels, c, fill);
+
+    top = p00 + (p10 - p00) * fx;
+    bottom = p01 + (p11 - p01) * fx;
+
+    dst[c] = top + (bottom - top) * fy;
+  }
+}
+
+static void
+minst_warp_row_scalar(const float* src,
+                      float* dst,
+                      const uint32_t first,
+                      const uint32_t y,
+                      const uint32_t width,
+                      const uint32_t height,
+                      const uint32_t channels,
+                      const float* matrix,
+                      const float* displacement,
+                      const float fill)
+{
+  const float row_x = matrix[1] * ((float)y) + matrix[2];
+  const float row_y = matrix[4] * ((float)y) + matrix[5];
+  const size_t plane = ((size_t)width) * height;
+  size_t idx;
+  uint32_t x;
+  float sx;
+  float sy;
+
+  for (x = first; x < width; x++) {
+
+    idx = ((size_t)y) * width + x;
+
+    sx = matrix[0] * ((float)x) + row_x;
+    sy = matrix[3] * ((float)x) + row_y;
+
+    if (displacement) {
+      sx = sx + displacement[idx];
+      sy = sy + displacement[plane + idx];
+    }
+
+    minst_warp_pixel(src, dst + idx * channels, sx, sy, width, height, channels, fill);
+  }
+}
+
+static void
+minst_warp_scalar(const float* src,
+                  float* dst,
+                  const uint32_t width,
+                  const uint32_t height,
+                  const uint32_t channels,
+                  const float* matrix,
+                  const float* displacement,
+                  const float fill)
+{
+  uint32_t y;
+
+  for (y = 0; y < height; y++) {
+    minst_warp_row_scalar(src, dst, 0, y, width, height, channels, matrix, displacement, fill);
+  }
+}
+
+#ifdef MINST_HAVE_AVX2
+
+MINST_AVX2 static __m256i
+minst_noise_hash_avx2(__m256i x)
+{
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32(0x7FEB352D));
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+  x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x846CA68Bu));
+  x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+  return x;
+}
+
+MINST_AVX2 static void
+minst_noise_avx2(float* data, const size_t count, const uint32_t key, const float std)
+{
+  const float scale = std * 1.7320508f;
+  const __m256i keys = _mm256_set1_epi32((int)key);
+  const __m256i low_mask = _mm256_set1_epi32(0xFFFF);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  __m256i idx2 = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+  __m256i a;
+  __m256i b;
+  __m256i sum;
+  __m256 n;
+  size_t i;
+
+  for (i = 0; (i + 8) <= count; i += 8) {
+
+    a = minst_noise_hash_avx2(_mm256_xor_si256(keys, idx2));
+    b = minst_noise_hash_avx2(_mm256_xor_si256(keys, _mm256_add_epi32(idx2, one)));
+
+    sum = _mm256_add_epi32(_mm256_add_epi32(_mm256_and_si256(a, low_mask), _mm256_srli_epi32(a, 16)),
+                           _mm256_add_epi32(_mm256_and_si256(b, low_mask), _mm256_srli_epi32(b, 16)));
+
+    n = _mm256_add_ps(_mm256_cvtepi32_ps(sum), _mm256_set1_ps(2.0f));
+    n = _mm256_sub_ps(_mm256_mul_ps(n, _mm256_set1_ps(1.0f / 65536.0f)), _mm256_set1_ps(2.0f));
+
+    _mm256_storeu_ps(data + i, _mm256_add_ps(_mm256_loadu_ps(data + i), _mm256_mul_ps(n, scale_v)));
+
+    idx2 = _mm256_add_epi32(idx2, _mm256_set1_epi32(16));
+  }
+
+  for (; i < count; i++) {
+    data[i] = data[i] + minst_noise_value(key, (uint32_t)i) * scale;
+  }
+}
+
+/* Gets eight pixels of a single channel image, using the fill value for those outside of the image. */
+MINST_AVX2 static __m256
+minst_warp_gather_avx2(const float* src,
+                       const __m256i x,
+                       const __m256i y,
+                       const __m256i width,
+                       const __m256i height,
+                       const __m256 fill)
+{
+  const __m256i minus_one = _mm256_set1_epi32(-1);
+  __m256i inside;
+  __m256i idx;
+
+  inside = _mm256_and_si256(_mm256_cmpgt_epi32(x, minus_one), _mm256_cmpgt_epi32(width, x));
+  inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(y, minus_one), _mm256_cmpgt_epi32(height, y)));
+
+  idx = _mm256_add_epi32(_mm256_mullo_epi32(y, width), x);
+
+  return _mm256_mask_i32gather_ps(fill, src, idx, _mm256_castsi256_ps(inside), 4);
+}
+
+MINST_AVX2 static void
+minst_warp_avx2(const float* src,
+                float* dst,
+                const uint32_t width,
+                const uint32_t height,
+                const uint32_t channels,
+                const float* matrix,
+                const float* displacement,
+                const float fill)
+{
+  const size_t plane = ((size_t)width) * height;
+  const __m256i width_v = _mm256_set1_epi32((int)width);
+  const __m256i height_v = _mm256_set1_epi32((int)height);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256 fill_v = _mm256_set1_ps(fill);
+  const __m256 lower = _mm256_set1_ps(-2.0f);
+  const __m256 upper_x = _mm256_set1_ps(((float)width) + 1.0f);
+  const __m256 upper_y = _mm256_set1_ps(((float)height) + 1.0f);
+  const __m256 m0 = _mm256_set1_ps(matrix[0]);
+  const __m256 m3 = _mm256_set1_ps(matrix[3]);
+  __m256 row_x;
+  __m256 row_y;
+  __m256 xs;
+  __m256 sx;
+  __m256 sy;
+  __m256 x0;
+  __m256 y0;
+  __m256 fx;
+  __m256 fy;
+  __m256 top;
+  __m256 bottom;
+  __m256i ix;
+  __m256i iy;
+  __m256i ix1;
+  __m256i iy1;
+  size_t idx;
+  uint32_t x;
+  uint32_t y;
+
+  if (channels != 1) {
+    minst_warp_scalar(src, dst, width, height, channels, matrix, displacement, fill);
+    return;
+  }
+
+  for (y = 0; y < height; y++) {
+
+    row_x = _mm256_set1_ps(matrix[1] * ((float)y) + matrix[2]);
+    row_y = _mm256_set1_ps(matrix[4] * ((float)y) + matrix[5]);
+
+    for (x = 0; (x + 8) <= width; x += 8) {
+
+      idx = ((size_t)y) * width + x;
+
+      xs = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32((int)x), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+      sx = _mm256_add_ps(_mm256_mul_ps(m0, xs), row_x);
+      sy = _mm256_add_ps(_mm256_mul_ps(m3, xs), row_y);
+
+      if (displacement) {
+        sx = _mm256_add_ps(sx, _mm256_loadu_ps(displacement + idx));
+        sy = _mm256_add_ps(sy, _mm256_loadu_ps(displacement + plane + idx));
+      }
+
+      sx = _mm256_min_ps(_mm256_max_ps(sx, lower), upper_x);
+      sy = _mm256_min_ps(_mm256_max_ps(sy, lower), upper_y);
+
+      x0 = _mm256_floor_ps(sx);
+      y0 = _mm256_floor_ps(sy);
+
+      fx = _mm256_sub_ps(sx, x0);
+      fy = _mm256_sub_ps(sy, y0);
+
+      ix = _mm256_cvttps_epi32(x0);
+      iy = _mm256_cvttps_epi32(y0);
+      ix1 = _mm256_add_epi32(ix, one);
+      iy1 = _mm256_add_epi32(iy, one);
+
+      top = minst_warp_gather_avx2(src, ix, iy, width_v, height_v, fill_v);
+      top = _mm256_add_ps(
+        top, _mm256_mul_ps(_mm256_sub_ps(minst_warp_gather_avx2(src, ix1, iy, width_v, height_v, fill_v), top), fx));
+
+      bottom = minst_warp_gather_avx2(src, ix, iy1, width_v, height_v, fill_v);
+      bottom = _mm256_add_ps(
+        bottom,
+        _mm256_mul_ps(_mm256_sub_ps(minst_warp_gather_avx2(src, ix1, iy1, width_v, height_v, fill_v), bottom), fx));
+
+      _mm256_storeu_ps(dst + idx, _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), fy)));
+    }
+
+    minst_warp_row_scalar(src, dst, x, y, width, height, channels, matrix, displacement, fill);
+  }
+}
+
+#endif /* MINST_HAVE_AVX2 */
+
+minst_warp_func
+minst_get_warp(void)
+{
+#ifdef MINST_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return minst_warp_avx2;
+  }
+#endif
+
+  return minst_warp_scalar;
+}
+
+minst_noise_func
+minst_get_noise(void)
+{
+#ifdef MINST_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return minst_noise_avx2;
+  }
+#endif
+
+  return minst_noise_scalar;
+}
+
+/* moments kernels */
+
+static void
+minst_moments_scalar(const double* src,
+                     const double* shift,
+                     const size_t count,
+                     double* sum,
+                     double* sum_sq,
+                     double* min_v,
+                     double* max_v)
+{
+  size_t i;
+  double d;
+
+  for (i = 0; i < count; i++) {
+    d = src[i] - shift[i];
+    sum[i] += d;
+    sum_sq[i] += d * d;
+    min_v[i] = (src[i] < min_v[i]) ? src[i] : min_v[i];
+    max_v[i] = (src[i] > max_v[i]) ? src[i] : max_v[i];
+  }
+}
+
+#ifdef MINST_HAVE_SSE2
+
+static void
+minst_moments_sse2(const double* src,
+                   const double* shift,
+                   const size_t count,
+                   double* sum,
+                   double* sum_sq,
+                   double* min_v,
+                   double* max_v)
+{
+  size_t i;
+  __m128d x;
+  __m128d d;
+
+  for (i = 0; (i + 2) <= count; i += 2) {
+
+    x = _mm_loadu_pd(src + i);
+    d = _mm_sub_pd(x, _mm_loadu_pd(shift + i));
+
+    _mm_storeu_pd(sum + i, _mm_add_pd(_mm_loadu_pd(sum + i), d));
+    _mm_storeu_pd(sum_sq + i, _mm_add_pd(_mm_loadu_pd(sum_sq + i), _mm_mul_pd(d, d)));
+
+    _mm_storeu_pd(min_v + i, _mm_min_pd(x, _mm_loadu_pd(min_v + i)));
+    _mm_storeu_pd(max_v + i, _mm_max_pd(x, _mm_loadu_pd(max_v + i)));
+  }
+
+  minst_moments_scalar(src + i, shift + i, count - i, sum + i, sum_sq + i, min_v + i, max_v + i);
+}
+
+#endif /* MINST_HAVE_SSE2 */
+
+#ifdef MINST_HAVE_AVX2
+
+MINST_AVX2 static void
+minst_moments_avx2(const double* src,
+                   const double* shift,
+                   const size_t count,
+                   double* sum,
+                   double* sum_sq,
+                   double* min_v,
+                   double* max_v)
+{
+  size_t i;
+  __m256d x;
+  __m256d d;
+
+  for (i = 0; (i + 4) <= count; i += 4) {
+
+    x = _mm256_loadu_pd(src + i);
+    d = _mm256_sub_pd(x, _mm256_loadu_pd(shift + i));
+
+    _mm256_storeu_pd(sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), d));
+    _mm256_storeu_pd(sum_sq + i, _mm256_add_pd(_mm256_loadu_pd(sum_sq + i), _mm256_mul_pd(d, d)));
+
+    _mm256_storeu_pd(min_v + i, _mm256_min_pd(x, _mm256_loadu_pd(min_v + i)));
+    _mm256_storeu_pd(max_v + i, _mm256_max_pd(x, _mm256_loadu_pd(max_v + i)));
+  }
+
+  minst_moments_scalar(src + i, shift + i, count - i, sum + i, sum_sq + i, min_v + i, max_v + i);
+}
+
+#endif /* MINST_HAVE_AVX2 */
+
+minst_moments_func
+minst_get_moments(void)
+{
+#ifdef MINST_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return minst_moments_avx2;
+  }
+#endif
+
+#ifdef MINST_HAVE_SSE2
+  return minst_moments_sse2;
+#endif
+
+  return minst_moments_scalar;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+/* Internal batch processing kernels. These are not part of the public interface. */
+
+#include "minst.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /**
+   * @brief Converts elements of an IDX payload (big-endian for multi-byte types) to 32-bit floats, computing
+   *        dst[i] = src[i] * scale + bias.
+   * */
+  typedef void (*minst_convert_f32_func)(const void* src, float* dst, size_t count, float scale, float bias);
+
+  /**
+   * @brief Gets the fastest conversion kernel for a source type that is supported by the current CPU.
+   *
+   * @return The conversion kernel, or null if the type is not known.
+   * */
+  minst_convert_f32_func minst_get_convert_f32(enum minst_type type);
+
+  /**
+   * @brief Reverses the byte order of each element, converting between big-endian and native byte order.
+   * */
+  typedef void (*minst_bswap_func)(const void* src, void* dst, size_t count);
+
+  /**
+   * @brief Gets the fastest byte swapping kernel for an element size that is supported by the current CPU.
+   *
+   * @param type_size The size of one element, in bytes.
+   *
+   * @return The byte swapping kernel, or null if the element size is one or not supported.
+   * */
+  minst_bswap_func minst_get_bswap(uint32_t type_size);
+
+  /**
+   * @brief Converts integer elements of an IDX payload (big-endian for multi-byte types) to wider integers in native
+   *        byte order.
+   * */
+  typedef void (*minst_widen_func)(const void* src, void* dst, size_t count);
+
+  /**
+   * @brief Gets the kernel that widens a source type to native integers of the given size.
+   *
+   * @param dst_size The size of the native integers, which is either four or eight bytes.
+   *
+   * @return The widening kernel, or null if the source type is not an integer type or the size is not supported.
+   * */
+  minst_widen_func minst_get_widen(enum minst_type type, uint32_t dst_size);
+
+  /**
+   * @brief Resamples an image with bilinear filtering. The output pixel (x, y) is taken from the input at
+   *        (matrix[0] * x + matrix[1] * y + matrix[2], matrix[3] * x + matrix[4] * y + matrix[5]), plus the
+   *        displacement of the pixel if a displacement field is given. Pixels outside of the input have the fill value.
+   *
+   * @param displacement An optional displacement field, with one plane of x offsets followed by one plane of y offsets.
+   * */
+  typedef void (*minst_warp_func)(const float* src,
+                                  float* dst,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t channels,
+                                  const float* matrix,
+                                  const float* displacement,
+                                  float fill);
+
+  /**
+   * @brief Gets the fastest image warping kernel that is supported by the current CPU.
+   * */
+  minst_warp_func minst_get_warp(void);
+
+  /**
+   * @brief Adds approximately normal noise with the given standard deviation to each value. The noise only depends on
+   *        the key and the position of each value.
+   * */
+  typedef void (*minst_noise_func)(float* data, size_t count, uint32_t key, float std);
+
+  /**
+   * @brief Gets the fastest noise kernel that is supported by the current CPU.
+   * */
+  minst_noise_func minst_get_noise(void);
+
+  /**
+   * @brief Converts elements of an IDX payload (big-endian for multi-byte types) to doubles, which hold every value of
+   *        every source type exactly.
+   * */
+  typedef void (*minst_convert_f64_func)(const void* src, double* dst, size_t count);
+
+  /**
+   * @brief Gets the kernel that converts a source type to doubles.
+   *
+   * @return The conversion kernel, or null if the type is not known.
+   * */
+  minst_convert_f64_func minst_get_convert_f64(enum minst_type type);
+
+  /**
+   * @brief Adds the values of one element to running per-value statistics, taken around a shift that is close to the
+   *        mean so that large values do not cancel: sum[i] += x - shift[i], sum_sq[i] += (x - shift[i])^2, and the
+   *        minimum and maximum of each value.
+   * */
+  typedef void (*minst_moments_func)(const double* src,
+                                     const double* shift,
+                                     size_t count,
+                                     double* sum,
+                                     double* sum_sq,
+                                     double* min_v,
+                                     double* max_v);
+
+  /**
+   * @brief Gets the fastest moments kernel that is supported by the current CPU. Every kernel adds up the values in
+   *        the same order, so the results do not depend on which one is used.
+   * */
+  minst_moments_func minst_get_moments(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
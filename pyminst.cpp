@@ -1,11 +1,15 @@
 #include "minst.h"
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 
-#include <random>
+#include <algorithm>
+#include <exception>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace py = pybind11;
 
@@ -17,62 +21,78 @@ public:
   virtual ~sampler() = default;
 
   virtual auto sample(uint32_t num_elements) -> uint32_t = 0;
+
+  /// Chooses all of the elements of a batch. By default, this calls @ref sample once for each element.
+  virtual void sample_batch(const uint32_t num_elements, const uint32_t count, uint32_t* indices)
+  {
+    for (uint32_t i = 0; i < count; i++) {
+      indices[i] = sample(num_elements);
+    }
+  }
 };
 
 class random_sampler final : public sampler
 {
 public:
-  explicit random_sampler(const int seed)
-    : m_rng(seed)
+  explicit random_sampler(const uint64_t seed)
+    : m_seed(seed)
   {
   }
 
   auto sample(const uint32_t num_elements) -> uint32_t override
   {
     if (m_indices.size() != num_elements) {
-      initialize_indices(num_elements);
-      m_offset = 0;
+      m_indices.resize(num_elements);
+      m_epoch = 0;
+      shuffle_indices();
     }
 
     if (m_offset == m_indices.size()) {
+      m_epoch++;
       shuffle_indices();
-      m_offset = 0;
     }
 
-    const auto idx = m_indices.at(m_offset);
-
-    m_offset++;
+    return m_indices[m_offset++];
+  }
 
-    return idx;
+  void sample_batch(const uint32_t num_elements, const uint32_t count, uint32_t* indices) override
+  {
+    for (uint32_t i = 0; i < count; i++) {
+      indices[i] = random_sampler::sample(num_elements);
+    }
   }
 
 protected:
   using size_type = std::vector<uint32_t>::size_type;
 
-  void initialize_indices(const uint32_t num_elements)
+  /// Shuffles the indices with the same generator as the default sampler, so that each pass over the dataset only
+  /// depends on the seed and the number of passes made so far.
+  void shuffle_indices()
   {
-    m_indices.resize(num_elements);
+    const auto n = static_cast<uint32_t>(m_indices.size());
 
-    for (uint32_t i = 0; i < num_elements; i++) {
+    for (uint32_t i = 0; i < n; i++) {
       m_indices[i] = i;
     }
 
-    shuffle_indices();
-  }
+    minst_rng rng{};
 
-  void shuffle_indices()
-  {
-    for (uint32_t i = 1; i < m_indices.size(); i++) {
-      std::uniform_int_distribution<uint32_t> dist(0, i);
-      const auto idx = dist(m_rng);
-      const auto tmp = m_indices.at(i);
-      m_indices.at(i) = m_indices.at(idx);
-      m_indices.at(idx) = tmp;
+    minst_rng_seed(&rng, m_seed, m_epoch);
+
+    for (uint32_t i = n; i > 1; i--) {
+      const auto j = minst_rng_bounded(&rng, i);
+      const auto tmp = m_indices[i - 1];
+      m_indices[i - 1] = m_indices[j];
+      m_indices[j] = tmp;
     }
+
+    m_offset = 0;
   }
 
 private:
-  std::mt19937 m_rng;
+  uint64_t m_seed{};
+
+  uint64_t m_epoch{};
 
   std::vector<uint32_t> m_indices;
 
@@ -84,14 +104,88 @@ class py_sampler : public sampler
 public:
   auto sample(const uint32_t num_samples) -> uint32_t override
   {
+    // the library calls the sampler without holding the GIL
+    py::gil_scoped_acquire gil;
+
     PYBIND11_OVERRIDE_PURE(uint32_t, sampler, sample, num_samples);
   }
+
+  void sample_batch(const uint32_t num_elements, const uint32_t count, uint32_t* indices) override
+  {
+    // take the GIL once per batch instead of once per element
+    py::gil_scoped_acquire gil;
+
+    sampler::sample_batch(num_elements, count, indices);
+  }
+};
+
+/// @brief A sampler that chooses a whole batch of elements with one call into Python.
+class batch_sampler : public sampler
+{
+public:
+  virtual auto sample_indices(uint32_t num_elements, uint32_t batch_size) -> py::object = 0;
+
+  auto sample(const uint32_t num_elements) -> uint32_t override
+  {
+    uint32_t idx{};
+
+    sample_batch(num_elements, 1, &idx);
+
+    return idx;
+  }
+
+  void sample_batch(const uint32_t num_elements, const uint32_t count, uint32_t* indices) override
+  {
+    py::gil_scoped_acquire gil;
+
+    using index_array = py::array_t<uint32_t, py::array::c_style | py::array::forcecast>;
+
+    const auto result = index_array::ensure(sample_indices(num_elements, count));
+
+    if (!result || (result.ndim() != 1) || (result.size() != static_cast<py::ssize_t>(count))) {
+      throw std::invalid_argument("The batch sampler must return one index for each element of the batch.");
+    }
+
+    const auto* data = result.data();
+
+    for (uint32_t i = 0; i < count; i++) {
+      if (data[i] >= num_elements) {
+        throw py::index_error("The batch sampler returned an index that is out of range.");
+      }
+      indices[i] = data[i];
+    }
+  }
+};
+
+class py_batch_sampler : public batch_sampler
+{
+public:
+  auto sample_indices(const uint32_t num_elements, const uint32_t batch_size) -> py::object override
+  {
+    PYBIND11_OVERRIDE_PURE_NAME(py::object, batch_sampler, "sample", sample_indices, num_elements, batch_size);
+  }
+};
+
+struct sampler_data final
+{
+  sampler* s{ nullptr };
+
+  std::exception_ptr error;
 };
 
 int
-call_sampler(void* sampler_ptr, const uint32_t num_samples, uint32_t* sample_idx)
+call_sampler(void* sampler_ptr, const uint32_t num_samples, const uint32_t count, uint32_t* sample_indices)
 {
-  *sample_idx = static_cast<sampler*>(sampler_ptr)->sample(num_samples);
+  auto* s_data = static_cast<sampler_data*>(sampler_ptr);
+
+  // exceptions must not propagate through the C library
+  try {
+    s_data->s->sample_batch(num_samples, count, sample_indices);
+  } catch (...) {
+    s_data->error = std::current_exception();
+    return -1;
+  }
+
   return 0;
 }
 
@@ -100,15 +194,35 @@ class callback
 public:
   virtual ~callback() = default;
 
-  virtual void eval(const py::bytes& sample, const py::bytes& label) = 0;
+  virtual void eval(const py::array& samples, const py::array& labels) = 0;
 };
 
 class py_callback : public callback
 {
 public:
-  void eval(const py::bytes& sample, const py::bytes& label) override
+  void eval(const py::array& samples, const py::array& labels) override
+  {
+    PYBIND11_OVERRIDE_PURE(void, callback, eval, samples, labels);
+  }
+};
+
+class predictor
+{
+public:
+  virtual ~predictor() = default;
+
+  /// @brief Predicts the class of each sample in a batch.
+  ///
+  /// @return One class index for each sample.
+  virtual auto predict(const py::array& samples, const py::array& labels) -> py::object = 0;
+};
+
+class py_predictor : public predictor
+{
+public:
+  auto predict(const py::array& samples, const py::array& labels) -> py::object override
   {
-    PYBIND11_OVERRIDE_PURE(void, callback, eval, sample, label);
+    PYBIND11_OVERRIDE_PURE(py::object, predictor, predict, samples, labels);
   }
 };
 
@@ -119,26 +233,292 @@ struct format
   py::tuple shape;
 };
 
+/// @brief Gets the NumPy type of the elements passed on by the library.
+auto
+to_dtype(const minst_type type, const minst_output output) -> py::dtype
+{
+  switch (output) {
+    case MINST_OUTPUT_F32:
+    case MINST_OUTPUT_ONE_HOT:
+      return py::dtype::of<float>();
+    case MINST_OUTPUT_I32:
+      return py::dtype::of<int32_t>();
+    case MINST_OUTPUT_I64:
+      return py::dtype::of<int64_t>();
+    default:
+      break;
+  }
+
+  // multi-byte types are big-endian, unless they were converted to native byte order
+  const char* raw_names[]{ "u1", "i1", ">i2", ">i4", ">f4", ">f8" };
+
+  const char* native_names[]{ "u1", "i1", "=i2", "=i4", "=f4", "=f8" };
+
+  return py::dtype::from_args(py::str((output == MINST_OUTPUT_NATIVE) ? native_names[type] : raw_names[type]));
+}
+
+/// @brief Gets the shape of a batch of elements in the given format.
+auto
+to_batch_shape(const minst_format& fmt, const uint32_t batch_size) -> std::vector<py::ssize_t>
+{
+  std::vector<py::ssize_t> shape{ static_cast<py::ssize_t>(batch_size) };
+
+  for (uint8_t i = 1; i < fmt.rank; i++) {
+    shape.emplace_back(static_cast<py::ssize_t>(fmt.shape[i]));
+  }
+
+  return shape;
+}
+
+/// @brief Gets the shape of a batch of labels, where one-hot labels have an extra dimension for the classes.
+auto
+to_label_shape(const minst_format& fmt, const minst_options& options, const uint32_t batch_size)
+  -> std::vector<py::ssize_t>
+{
+  auto shape = to_batch_shape(fmt, batch_size);
+
+  if (options.label_output == MINST_OUTPUT_ONE_HOT) {
+    shape.emplace_back(static_cast<py::ssize_t>(options.num_classes));
+  }
+
+  return shape;
+}
+
+/// @brief The shape and byte strides of a batch of samples, as laid out by the library.
+struct sample_layout
+{
+  std::vector<py::ssize_t> shape;
+
+  std::vector<py::ssize_t> strides;
+};
+
+/// @brief Gets the layout of a batch of samples in the given format, including padding and aligned strides.
+auto
+to_sample_layout(const minst_format& fmt, const minst_options& options, const uint32_t batch_size) -> sample_layout
+{
+  minst_batch batch{};
+
+  const auto err = minst_layout_describe(&fmt, options.sample_output, &options.sample_layout, batch_size, &batch);
+  if (err != MINST_ERR_NONE) {
+    throw std::runtime_error(minst_strerror(err));
+  }
+
+  sample_layout layout;
+
+  for (uint8_t i = 0; i < batch.sample_rank; i++) {
+    layout.shape.emplace_back(static_cast<py::ssize_t>(batch.sample_shape[i]));
+    layout.strides.emplace_back(static_cast<py::ssize_t>(batch.sample_strides[i]));
+  }
+
+  return layout;
+}
+
+/// @brief Gets a batch shape with the number of elements of an actual batch, which is smaller for a partial last batch.
+auto
+with_batch_size(std::vector<py::ssize_t> shape, const uint32_t size) -> std::vector<py::ssize_t>
+{
+  shape[0] = static_cast<py::ssize_t>(size);
+  return shape;
+}
+
+/// @brief Creates a read-only array that refers to memory owned by the library, without copying it.
+///
+/// @param strides The byte strides of the array, or empty for a packed array.
+///
+/// @param base The object that owns the memory. The array keeps it alive. If this is null, the caller must make sure the
+///             memory outlives the array.
+auto
+make_view(const py::dtype& dtype,
+          const std::vector<py::ssize_t>& shape,
+          const std::vector<py::ssize_t>& strides,
+          const void* data,
+          py::handle base = {}) -> py::array
+{
+  // passing a base object keeps NumPy from copying the data
+  py::object owner;
+
+  if (base) {
+    owner = py::reinterpret_borrow<py::object>(base);
+  } else {
+    owner = py::capsule(data, [](void*) {});
+  }
+
+  py::array view(dtype, shape, strides, data, owner);
+
+  view.attr("setflags")(py::arg("write") = false);
+
+  return view;
+}
+
 struct callback_data final
 {
   callback* cb{ nullptr };
 
-  uint32_t sample_size{};
+  py::dtype sample_dtype;
 
-  uint32_t label_size{};
+  py::dtype label_dtype;
+
+  sample_layout samples;
+
+  std::vector<py::ssize_t> label_shape;
+
+  std::exception_ptr error;
 };
 
 int
-call(void* callback_ptr, const void* samples, const void* labels)
+call(void* callback_ptr, const void* samples, const void* labels, const uint32_t count)
 {
   auto* cb_data = static_cast<callback_data*>(callback_ptr);
 
-  cb_data->cb->eval(py::bytes(static_cast<const char*>(samples), cb_data->sample_size),
-                    py::bytes(static_cast<const char*>(labels), cb_data->label_size));
+  py::gil_scoped_acquire gil;
+
+  const auto sample_shape = with_batch_size(cb_data->samples.shape, count);
+  const auto label_shape = with_batch_size(cb_data->label_shape, count);
+
+  // exceptions must not propagate through the C library
+  try {
+    cb_data->cb->eval(make_view(cb_data->sample_dtype, sample_shape, cb_data->samples.strides, samples),
+                      make_view(cb_data->label_dtype, label_shape, {}, labels));
+  } catch (...) {
+    cb_data->error = std::current_exception();
+    return -1;
+  }
+
+  return 0;
+}
+
+struct predict_data final
+{
+  predictor* p{ nullptr };
+
+  py::dtype sample_dtype;
+
+  sample_layout samples;
+
+  std::exception_ptr error;
+};
+
+int
+call_predictor(void* predict_ptr, uint32_t, const minst_batch* batch, uint32_t* predictions)
+{
+  using prediction_array = py::array_t<uint32_t, py::array::c_style | py::array::forcecast>;
+
+  auto* p_data = static_cast<predict_data*>(predict_ptr);
+
+  py::gil_scoped_acquire gil;
+
+  // the last batch of each thread may be short
+  const auto shape = with_batch_size(p_data->samples.shape, batch->size);
+
+  const std::vector<py::ssize_t> label_shape{ static_cast<py::ssize_t>(batch->size) };
+
+  try {
+    const auto result = p_data->p
+                          ->predict(make_view(p_data->sample_dtype, shape, p_data->samples.strides, batch->samples),
+                                    make_view(py::dtype::of<int32_t>(), label_shape, {}, batch->labels))
+                          .cast<prediction_array>();
+
+    if (static_cast<size_t>(result.size()) != batch->size) {
+      throw std::invalid_argument("The predictor must return one class for each sample.");
+    }
+
+    std::copy(result.data(), result.data() + batch->size, predictions);
+  } catch (...) {
+    if (!p_data->error) {
+      p_data->error = std::current_exception();
+    }
+    return -1;
+  }
 
   return 0;
 }
 
+/// @brief Copies the padding of each dimension from Python, where it may be shorter than the maximum rank.
+void
+copy_padding(const py::sequence& pad, uint32_t* dst)
+{
+  if (pad.size() > MINST_MAX_RANK) {
+    throw std::invalid_argument("The padding has more dimensions than the maximum rank.");
+  }
+
+  for (size_t i = 0; i < MINST_MAX_RANK; i++) {
+    dst[i] = (i < pad.size()) ? pad[i].cast<uint32_t>() : 0;
+  }
+}
+
+/// @brief Gets the padding of each dimension as a tuple.
+auto
+padding_tuple(const uint32_t* pad) -> py::tuple
+{
+  return py::make_tuple(pad[0], pad[1], pad[2], pad[3]);
+}
+
+using weight_array = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+/// @brief Points the options at the class weights, which must have one entry per class.
+///
+/// @param weights The weights, or None. The array must stay alive until the dataset is opened.
+void
+set_class_weights(minst_options& options, const py::object& class_weights, weight_array& weights)
+{
+  if (class_weights.is_none()) {
+    return;
+  }
+
+  weights = class_weights.cast<weight_array>();
+
+  if ((weights.ndim() != 1) || (static_cast<size_t>(weights.size()) != options.num_classes)) {
+    throw std::invalid_argument("There must be one class weight for each class.");
+  }
+
+  options.class_weights = weights.data();
+}
+
+/// @brief Marks options that ask for statistics. The library never writes to it, because the functions that open a
+///        dataset point the options at their own statistics first.
+minst_stats stats_marker{};
+
+/// @brief Points options that ask for statistics at the given statistics.
+void
+redirect_stats(minst_options& options, minst_stats& stats)
+{
+  if (options.stats) {
+    options.stats = &stats;
+  }
+}
+
+/// @brief Converts statistics to a dictionary, with the latency histogram as a list.
+auto
+stats_dict(const minst_stats& stats) -> py::dict
+{
+  py::list histogram;
+
+  for (const auto count : stats.latency_histogram) {
+    histogram.append(count);
+  }
+
+  py::dict result;
+  result["open_seconds"] = stats.open_seconds;
+  result["sampler_seconds"] = stats.sampler_seconds;
+  result["io_seconds"] = stats.io_seconds;
+  result["convert_seconds"] = stats.convert_seconds;
+  result["callback_seconds"] = stats.callback_seconds;
+  result["bytes_read"] = stats.bytes_read;
+  result["num_reads"] = stats.num_reads;
+  result["num_seeks"] = stats.num_seeks;
+  result["num_batches"] = stats.num_batches;
+  result["latency_histogram"] = histogram;
+  return result;
+}
+
+auto
+default_options() -> minst_options
+{
+  minst_options options{};
+  minst_options_init(&options);
+  return options;
+}
+
 auto
 to_c_format(const format& f) -> minst_format
 {
@@ -167,28 +547,627 @@ to_c_format(const format& f) -> minst_format
   return fmt;
 }
 
-void
+auto
 eval(const std::string& samples_path,
      const std::string& labels_path,
      const format& sample_format,
      const format& label_format,
      const uint32_t batch_size,
      callback& cb,
-     sampler& s)
+     sampler& s,
+     const minst_options& options) -> py::object
+{
+  const auto s_format = to_c_format(sample_format);
+  const auto l_format = to_c_format(label_format);
+
+  callback_data cb_data;
+  cb_data.cb = &cb;
+  cb_data.sample_dtype = to_dtype(s_format.type, options.sample_output);
+  cb_data.label_dtype = to_dtype(l_format.type, options.label_output);
+  cb_data.samples = to_sample_layout(s_format, options, batch_size);
+  cb_data.label_shape = to_label_shape(l_format, options, batch_size);
+
+  sampler_data s_data;
+  s_data.s = &s;
+
+  auto s_options = options;
+  s_options.batch_sampler_data = &s_data;
+  s_options.batch_sampler = call_sampler;
+
+  minst_stats stats{};
+  redirect_stats(s_options, stats);
+
+  minst_error err{ MINST_ERR_NONE };
+
+  {
+    // the GIL is only taken back to call into Python
+    py::gil_scoped_release release;
+
+    err = minst_eval_batches(samples_path.c_str(),
+                             labels_path.c_str(),
+                             &s_format,
+                             &l_format,
+                             batch_size,
+                             &cb_data,
+                             call,
+                             nullptr,
+                             nullptr,
+                             &s_options);
+  }
+
+  if (cb_data.error) {
+    std::rethrow_exception(cb_data.error);
+  }
+
+  if (s_data.error) {
+    std::rethrow_exception(s_data.error);
+  }
+
+  if (err != MINST_ERR_NONE) {
+    throw std::runtime_error(minst_strerror(err));
+  }
+
+  return options.stats ? py::object(stats_dict(stats)) : py::none();
+}
+
+auto
+evaluate(const std::string& samples_path,
+         const std::string& labels_path,
+         const format& sample_format,
+         const format& label_format,
+         const uint32_t batch_size,
+         const uint32_t num_classes,
+         predictor& p,
+         const uint32_t num_threads,
+         const minst_options& options) -> py::dict
+{
+  const auto s_format = to_c_format(sample_format);
+  const auto l_format = to_c_format(label_format);
+
+  predict_data p_data;
+  p_data.p = &p;
+  p_data.sample_dtype = to_dtype(s_format.type, options.sample_output);
+  p_data.samples = to_sample_layout(s_format, options, batch_size);
+
+  auto e_options = options;
+
+  minst_stats stats{};
+  redirect_stats(e_options, stats);
+
+  minst_eval_result result{};
+
+  minst_error err{ MINST_ERR_NONE };
+
+  {
+    py::gil_scoped_release release;
+
+    err = minst_evaluate(samples_path.c_str(),
+                         labels_path.c_str(),
+                         &s_format,
+                         &l_format,
+                         batch_size,
+                         num_classes,
+                         num_threads,
+                         &p_data,
+                         call_predictor,
+                         &e_options,
+                         &result);
+  }
+
+  if (p_data.error) {
+    std::rethrow_exception(p_data.error);
+  }
+
+  if (err != MINST_ERR_NONE) {
+    throw std::runtime_error(minst_strerror(err));
+  }
+
+  py::array_t<uint64_t> confusion({ static_cast<py::ssize_t>(num_classes), static_cast<py::ssize_t>(num_classes) });
+  const auto confusion_size = static_cast<size_t>(num_classes) * num_classes;
+  std::copy(result.confusion, result.confusion + confusion_size, confusion.mutable_data());
+
+  py::array_t<double> precision(static_cast<py::ssize_t>(num_classes));
+  std::copy(result.precision, result.precision + num_classes, precision.mutable_data());
+
+  py::array_t<double> recall(static_cast<py::ssize_t>(num_classes));
+  std::copy(result.recall, result.recall + num_classes, recall.mutable_data());
+
+  py::dict summary;
+  summary["num_elements"] = result.num_elements;
+  summary["num_correct"] = result.num_correct;
+  summary["accuracy"] = result.accuracy;
+  summary["confusion"] = confusion;
+  summary["precision"] = precision;
+  summary["recall"] = recall;
+
+  if (options.stats) {
+    summary["stats"] = stats_dict(stats);
+  }
+
+  minst_eval_result_free(&result);
+
+  return summary;
+}
+
+void
+build_cache(const std::string& cache_path,
+            const std::string& samples_path,
+            const std::string& labels_path,
+            const format& sample_format,
+            const format& label_format,
+            const minst_options& options)
 {
   const auto s_format = to_c_format(sample_format);
   const auto l_format = to_c_format(label_format);
 
-  callback_data cb_data{ &cb, minst_element_size(&s_format) * batch_size, minst_element_size(&l_format) * batch_size };
+  minst_error err{ MINST_ERR_NONE };
+
+  {
+    py::gil_scoped_release release;
 
-  const auto err = minst_eval(
-    samples_path.c_str(), labels_path.c_str(), &s_format, &l_format, batch_size, &cb_data, call, &s, call_sampler);
+    err = minst_cache_build(
+      cache_path.c_str(), samples_path.c_str(), labels_path.c_str(), &s_format, &l_format, &options);
+  }
 
   if (err != MINST_ERR_NONE) {
     throw std::runtime_error(minst_strerror(err));
   }
 }
 
+/// @brief Copies per-feature statistics into an array with the shape of one element.
+auto
+feature_array(const double* values, const format& sample_format) -> py::array_t<double>
+{
+  std::vector<py::ssize_t> shape;
+
+  for (size_t i = 1; i < sample_format.shape.size(); i++) {
+    shape.emplace_back(sample_format.shape[i].cast<py::ssize_t>());
+  }
+
+  py::array_t<double> arr(shape);
+  std::copy(values, values + arr.size(), arr.mutable_data());
+  return arr;
+}
+
+auto
+compute_stats(const std::string& samples_path,
+              const std::string& labels_path,
+              const format& sample_format,
+              const format& label_format,
+              const uint32_t num_threads,
+              const std::string& stats_path) -> py::dict
+{
+  const auto s_format = to_c_format(sample_format);
+  const auto l_format = to_c_format(label_format);
+
+  minst_data_stats stats{};
+
+  minst_error err{ MINST_ERR_NONE };
+
+  {
+    py::gil_scoped_release release;
+
+    err = minst_compute_stats(samples_path.c_str(),
+                              labels_path.empty() ? nullptr : labels_path.c_str(),
+                              &s_format,
+                              &l_format,
+                              num_threads,
+                              stats_path.empty() ? nullptr : stats_path.c_str(),
+                              &stats);
+  }
+
+  if (err != MINST_ERR_NONE) {
+    throw std::runtime_error(minst_strerror(err));
+  }
+
+  py::array_t<uint64_t> label_counts(static_cast<py::ssize_t>(stats.num_classes));
+  std::copy(stats.label_counts, stats.label_counts + stats.num_classes, label_counts.mutable_data());
+
+  py::dict summary;
+  summary["num_elements"] = stats.num_elements;
+  summary["mean"] = stats.mean;
+  summary["std"] = stats.std;
+  summary["min"] = stats.min;
+  summary["max"] = stats.max;
+  summary["feature_mean"] = feature_array(stats.feature_mean, sample_format);
+  summary["feature_std"] = feature_array(stats.feature_std, sample_format);
+  summary["feature_min"] = feature_array(stats.feature_min, sample_format);
+  summary["feature_max"] = feature_array(stats.feature_max, sample_format);
+  summary["label_counts"] = label_counts;
+
+  minst_data_stats_free(&stats);
+
+  return summary;
+}
+
+/// @brief Owns a view of one or more pairs of dataset files. Views made from it share its files.
+class view final
+{
+public:
+  view(const std::string& samples_path,
+       const std::string& labels_path,
+       const format& sample_format,
+       const format& label_format,
+       const minst_io_mode io_mode)
+  {
+    const auto s_format = to_c_format(sample_format);
+    const auto l_format = to_c_format(label_format);
+
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      py::gil_scoped_release release;
+
+      err = minst_view_open(&m_view, samples_path.c_str(), labels_path.c_str(), &s_format, &l_format, io_mode);
+    }
+
+    check(err);
+  }
+
+  view(const view&) = delete;
+
+  auto operator=(const view&) -> view& = delete;
+
+  ~view() { minst_view_close(m_view); }
+
+  auto range(const uint32_t first, const uint32_t count) const -> std::unique_ptr<view>
+  {
+    std::unique_ptr<view> result(new view());
+    check(minst_view_range(&result->m_view, m_view, first, count));
+    return result;
+  }
+
+  auto select(const py::object& indices) const -> std::unique_ptr<view>
+  {
+    using index_array = py::array_t<uint32_t, py::array::c_style | py::array::forcecast>;
+
+    const auto arr = index_array::ensure(indices);
+
+    if (!arr || (arr.ndim() != 1)) {
+      throw std::invalid_argument("The indices must be a one-dimensional sequence of element indices.");
+    }
+
+    std::unique_ptr<view> result(new view());
+    check(minst_view_select(&result->m_view, m_view, arr.data(), static_cast<uint32_t>(arr.size())));
+    return result;
+  }
+
+  static auto concat(const py::sequence& parts) -> std::unique_ptr<view>
+  {
+    std::vector<const minst_view*> c_parts;
+
+    for (const auto& part : parts) {
+      c_parts.emplace_back(part.cast<const view&>().m_view);
+    }
+
+    std::unique_ptr<view> result(new view());
+    check(minst_view_concat(&result->m_view, c_parts.data(), static_cast<uint32_t>(c_parts.size())));
+    return result;
+  }
+
+  auto size() const -> uint32_t { return minst_view_size(m_view); }
+
+  auto get() const -> const minst_view* { return m_view; }
+
+private:
+  view() = default;
+
+  static void check(const minst_error err)
+  {
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+  }
+
+  minst_view* m_view{ nullptr };
+};
+
+/// @brief Iterates a dataset batch by batch, while the next batches are prepared on a native thread.
+class loader final
+{
+public:
+  loader(const std::string& samples_path,
+         const std::string& labels_path,
+         const format& sample_format,
+         const format& label_format,
+         const uint32_t batch_size,
+         sampler* s,
+         const minst_options& options,
+         const std::string& cache_path,
+         const py::object& class_weights)
+  {
+    open(samples_path.c_str(),
+         labels_path.c_str(),
+         nullptr,
+         to_c_format(sample_format),
+         to_c_format(label_format),
+         batch_size,
+         s,
+         options,
+         cache_path,
+         class_weights);
+  }
+
+  /// @brief Iterates the elements of a view, which must outlive the loader.
+  loader(const view& v,
+         const uint32_t batch_size,
+         sampler* s,
+         const minst_options& options,
+         const py::object& class_weights)
+  {
+    minst_format s_format{};
+    minst_format l_format{};
+    minst_view_formats(v.get(), &s_format, &l_format);
+
+    open(nullptr, nullptr, v.get(), s_format, l_format, batch_size, s, options, std::string(), class_weights);
+  }
+
+  loader(const loader&) = delete;
+
+  auto operator=(const loader&) -> loader& = delete;
+
+  ~loader()
+  {
+    // the producer thread may be waiting for the GIL to call a Python sampler
+    py::gil_scoped_release release;
+
+    minst_dataset_close(m_dataset);
+  }
+
+  /// @brief Starts a new epoch, unless the current one has not been started yet.
+  void begin_epoch()
+  {
+    if (!m_started) {
+      m_started = true;
+      return;
+    }
+
+    py::gil_scoped_release release;
+
+    minst_dataset_next_epoch(m_dataset);
+  }
+
+  /// @brief Gets the next batch, or throws @c py::stop_iteration at the end of the epoch.
+  ///
+  /// @param self The Python object of this loader, which the batch arrays keep alive.
+  auto next_batch(py::handle self) -> py::tuple
+  {
+    m_started = true;
+
+    minst_batch batch{};
+
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      py::gil_scoped_release release;
+
+      err = minst_dataset_next_batch(m_dataset, &batch);
+    }
+
+    if (m_sampler_data.error) {
+      auto error = m_sampler_data.error;
+      m_sampler_data.error = nullptr;
+      std::rethrow_exception(error);
+    }
+
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+
+    if (batch.size == 0) {
+      throw py::stop_iteration();
+    }
+
+    return py::make_tuple(
+      make_view(m_sample_dtype, with_batch_size(m_samples.shape, batch.size), m_samples.strides, batch.samples, self),
+      make_view(m_label_dtype, with_batch_size(m_label_shape, batch.size), {}, batch.labels, self));
+  }
+
+  auto size() const -> uint32_t { return minst_dataset_num_batches(m_dataset); }
+
+  auto stats() -> py::dict
+  {
+    minst_stats stats{};
+    minst_dataset_stats(m_dataset, &stats);
+    return stats_dict(stats);
+  }
+
+private:
+  /// @brief Opens the dataset over either a pair of files or a view. The paths are only used without a view.
+  void open(const char* samples_path,
+            const char* labels_path,
+            const minst_view* v,
+            const minst_format& s_format,
+            const minst_format& l_format,
+            const uint32_t batch_size,
+            sampler* s,
+            const minst_options& options,
+            const std::string& cache_path,
+            const py::object& class_weights)
+  {
+    m_sample_dtype = to_dtype(s_format.type, options.sample_output);
+    m_label_dtype = to_dtype(l_format.type, options.label_output);
+    m_samples = to_sample_layout(s_format, options, batch_size);
+    m_label_shape = to_label_shape(l_format, options, batch_size);
+
+    m_sampler_data.s = s;
+
+    auto s_options = options;
+    if (s) {
+      s_options.batch_sampler_data = &m_sampler_data;
+      s_options.batch_sampler = call_sampler;
+    }
+
+    // the path is only read while opening the dataset
+    if (!cache_path.empty()) {
+      s_options.cache_path = cache_path.c_str();
+    }
+
+    // the weights are copied while opening the dataset
+    weight_array weights;
+    set_class_weights(s_options, class_weights, weights);
+
+    redirect_stats(s_options, m_stats);
+
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      py::gil_scoped_release release;
+
+      if (v) {
+        err = minst_dataset_open_view(&m_dataset, v, batch_size, nullptr, nullptr, &s_options);
+      } else {
+        err = minst_dataset_open(
+          &m_dataset, samples_path, labels_path, &s_format, &l_format, batch_size, nullptr, nullptr, &s_options);
+      }
+    }
+
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+  }
+
+  minst_dataset* m_dataset{ nullptr };
+
+  /// @brief Where the dataset stores its statistics when it is closed.
+  minst_stats m_stats{};
+
+  sampler_data m_sampler_data;
+
+  py::dtype m_sample_dtype;
+
+  py::dtype m_label_dtype;
+
+  sample_layout m_samples;
+
+  std::vector<py::ssize_t> m_label_shape;
+
+  bool m_started{ false };
+};
+
+/// @brief Writes an IDX file from NumPy arrays, which hold one or more elements each.
+class writer final
+{
+public:
+  writer(const std::string& path, const format& f, const minst_write_mode mode)
+  {
+    const auto c_format = to_c_format(f);
+
+    m_dtype = to_dtype(c_format.type, MINST_OUTPUT_NATIVE);
+    m_element_values = c_format.shape[1] * c_format.shape[2] * c_format.shape[3];
+
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      py::gil_scoped_release release;
+
+      err = minst_writer_open(&m_writer, path.c_str(), &c_format, mode);
+    }
+
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+  }
+
+  writer(const writer&) = delete;
+
+  auto operator=(const writer&) -> writer& = delete;
+
+  ~writer() { minst_writer_close(m_writer); }
+
+  void append(const py::object& data)
+  {
+    const auto arr = to_elements(data);
+    const auto count = element_count(arr);
+
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      py::gil_scoped_release release;
+
+      err = minst_writer_append(m_writer, arr.data(), count);
+    }
+
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+  }
+
+  void write_at(const uint32_t element_idx, const py::object& data)
+  {
+    const auto arr = to_elements(data);
+    const auto count = element_count(arr);
+
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      // other Python threads may write other elements in the meantime
+      py::gil_scoped_release release;
+
+      err = minst_writer_write_at(m_writer, element_idx, arr.data(), count);
+    }
+
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+  }
+
+  void close()
+  {
+    minst_error err{ MINST_ERR_NONE };
+
+    {
+      py::gil_scoped_release release;
+
+      err = minst_writer_close(m_writer);
+    }
+
+    m_writer = nullptr;
+
+    if (err != MINST_ERR_NONE) {
+      throw std::runtime_error(minst_strerror(err));
+    }
+  }
+
+private:
+  /// @brief Gets the values of the elements as a packed array in the type of the file and native byte order, which
+  ///        only copies the data if it is not already in that form.
+  auto to_elements(const py::object& data) const -> py::array
+  {
+    if (!m_writer) {
+      throw std::runtime_error("The writer is closed.");
+    }
+
+    return py::module_::import("numpy").attr("ascontiguousarray")(data, m_dtype).cast<py::array>();
+  }
+
+  auto element_count(const py::array& arr) const -> uint32_t
+  {
+    if ((static_cast<size_t>(arr.size()) % m_element_values) != 0) {
+      std::ostringstream stream;
+      stream << "Array size of '" << arr.size() << "' is not a multiple of the element size '" << m_element_values
+             << "'.";
+      throw std::runtime_error(stream.str());
+    }
+
+    return static_cast<uint32_t>(static_cast<size_t>(arr.size()) / m_element_values);
+  }
+
+  minst_writer* m_writer{ nullptr };
+
+  py::dtype m_dtype;
+
+  size_t m_element_values{ 1 };
+};
+
+auto
+default_loader_options() -> minst_options
+{
+  auto options = default_options();
+  options.prefetch_depth = 2;
+  return options;
+}
+
 } // namespace
 
 PYBIND11_MODULE(pyminst, m)
@@ -203,6 +1182,103 @@ PYBIND11_MODULE(pyminst, m)
     .value("F32", MINST_TYPE_F32, "A 32-bit floating point number.")
     .value("F64", MINST_TYPE_F64, "A 64-bit floating point number.");
 
+  py::enum_<minst_io_mode>(m, "IOMode")
+    .value("STDIO", MINST_IO_STDIO, "Elements are read with buffered standard I/O.")
+    .value("MMAP", MINST_IO_MMAP, "The files are memory mapped.")
+    .value("PRELOAD", MINST_IO_PRELOAD, "The files are read into memory when opened.");
+
+  py::enum_<minst_output>(m, "Output")
+    .value("RAW", MINST_OUTPUT_RAW, "Elements are passed on as they appear in the file.")
+    .value("NATIVE", MINST_OUTPUT_NATIVE, "Elements are converted to native byte order.")
+    .value("F32", MINST_OUTPUT_F32, "Elements are converted to normalized 32-bit floats.")
+    .value("I32", MINST_OUTPUT_I32, "Integer elements are widened to 32-bit integers.")
+    .value("I64", MINST_OUTPUT_I64, "Integer elements are widened to 64-bit integers.")
+    .value("ONE_HOT", MINST_OUTPUT_ONE_HOT, "Integer labels are expanded to one-hot 32-bit float vectors.");
+
+  py::enum_<minst_shuffle_mode>(m, "ShuffleMode")
+    .value("TABLE", MINST_SHUFFLE_TABLE, "A table of indices is shuffled at the start of each epoch.")
+    .value("COUNTER", MINST_SHUFFLE_COUNTER, "Each shuffled index is computed on demand, without a table.");
+
+  py::enum_<minst_sampling>(m, "Sampling")
+    .value("UNIFORM", MINST_SAMPLING_UNIFORM, "Elements are chosen without regard to their class.")
+    .value("STRATIFIED", MINST_SAMPLING_STRATIFIED, "Each batch has the same mix of classes as the dataset.")
+    .value("BALANCED", MINST_SAMPLING_BALANCED, "Each batch has the same number of elements of every class.")
+    .value("WEIGHTED", MINST_SAMPLING_WEIGHTED, "Elements are chosen with replacement, weighted by their class.");
+
+  py::enum_<minst_shard_mode>(m, "ShardMode")
+    .value("PAD", MINST_SHARD_PAD, "Shards are padded with elements from the start of the global order.")
+    .value("DROP", MINST_SHARD_DROP, "Elements that do not fill a whole shard are left out.");
+
+  py::enum_<minst_tail_mode>(m, "TailMode")
+    .value("WRAP", MINST_TAIL_WRAP, "The last batch is filled up with elements from the start of the epoch.")
+    .value("DROP", MINST_TAIL_DROP, "Elements that do not fill a whole batch are left out.")
+    .value("PARTIAL", MINST_TAIL_PARTIAL, "The last batch only has the remaining elements.");
+
+  py::enum_<minst_write_mode>(m, "WriteMode")
+    .value("STREAM", MINST_WRITE_STREAM, "The file grows as elements are written.")
+    .value("SPARSE", MINST_WRITE_SPARSE, "The file is given its full size when it is opened.")
+    .value("PREALLOCATE", MINST_WRITE_PREALLOCATE, "The disk space of the whole file is reserved when it is opened.");
+
+  py::class_<minst_augment>(m, "Augment")
+    .def(py::init([]() -> minst_augment { return minst_augment{}; }))
+    .def_readwrite("max_shift", &minst_augment::max_shift, "The largest distance, in pixels, a sample is moved.")
+    .def_readwrite("flip_probability", &minst_augment::flip_probability, "The probability of a horizontal mirror.")
+    .def_readwrite("max_rotation", &minst_augment::max_rotation, "The largest rotation, in radians.")
+    .def_readwrite("max_scale", &minst_augment::max_scale, "The largest relative change in size.")
+    .def_readwrite("max_shear", &minst_augment::max_shear, "The largest horizontal shear factor.")
+    .def_readwrite("elastic_alpha", &minst_augment::elastic_alpha, "The largest elastic displacement, in pixels.")
+    .def_readwrite("noise_std", &minst_augment::noise_std, "The standard deviation of the added noise.")
+    .def_readwrite("fill", &minst_augment::fill, "The value of pixels moved in from outside of the sample.");
+
+  py::enum_<minst_channel_order>(m, "ChannelOrder")
+    .value("LAST", MINST_CHANNELS_LAST, "The channels of a pixel are stored next to each other (NHWC).")
+    .value("FIRST", MINST_CHANNELS_FIRST, "Each channel is stored as its own plane of rows (NCHW).");
+
+  py::class_<minst_layout>(m, "Layout")
+    .def(py::init([]() -> minst_layout { return minst_layout{}; }))
+    .def_property(
+      "pad_before",
+      [](const minst_layout& l) { return padding_tuple(l.pad_before); },
+      [](minst_layout& l, const py::sequence& pad) { copy_padding(pad, l.pad_before); },
+      "The number of values added before each dimension, indexed like the shape of the format.")
+    .def_property(
+      "pad_after",
+      [](const minst_layout& l) { return padding_tuple(l.pad_after); },
+      [](minst_layout& l, const py::sequence& pad) { copy_padding(pad, l.pad_after); },
+      "The number of values added after each dimension, indexed like the shape of the format.")
+    .def_readwrite("channel_order", &minst_layout::channel_order, "The order of the values of each sample.")
+    .def_readwrite("pad_value", &minst_layout::pad_value, "The value of the padding of float samples.")
+    .def_readwrite("row_alignment", &minst_layout::row_alignment, "The alignment, in bytes, of the row stride.")
+    .def_readwrite("sample_alignment", &minst_layout::sample_alignment, "The alignment, in bytes, of the samples.");
+
+  py::class_<minst_options>(m, "Options")
+    .def(py::init(&default_options))
+    .def_readwrite("io_mode", &minst_options::io_mode, "How the dataset files are accessed.")
+    .def_readwrite("shuffle", &minst_options::shuffle, "Whether or not the default sampler shuffles the elements.")
+    .def_readwrite("num_threads", &minst_options::num_threads, "The number of threads used to assemble a batch.")
+    .def_readwrite("prefetch_depth", &minst_options::prefetch_depth, "The number of batches prepared ahead of time.")
+    .def_readwrite("sample_output", &minst_options::sample_output, "The form in which samples are passed on.")
+    .def_readwrite("sample_scale", &minst_options::sample_scale, "The scale applied to converted sample values.")
+    .def_readwrite("sample_mean", &minst_options::sample_mean, "The mean subtracted from converted sample values.")
+    .def_readwrite("sample_std", &minst_options::sample_std, "The standard deviation of converted sample values.")
+    .def_readwrite("label_output", &minst_options::label_output, "The form in which labels are passed on.")
+    .def_readwrite("num_classes", &minst_options::num_classes, "The number of classes of one-hot labels.")
+    .def_readwrite("label_smoothing", &minst_options::label_smoothing, "The label smoothing of one-hot labels.")
+    .def_readwrite("seed", &minst_options::seed, "The seed of the default sampler.")
+    .def_readwrite("shuffle_mode", &minst_options::shuffle_mode, "How the default sampler shuffles the elements.")
+    .def_readwrite("sampling", &minst_options::sampling, "How the elements are chosen by their class.")
+    .def_readwrite("world_size", &minst_options::world_size, "The number of shards the dataset is split into.")
+    .def_readwrite("rank", &minst_options::rank, "The shard to iterate.")
+    .def_readwrite("shard_mode", &minst_options::shard_mode, "How the shards are made the same size.")
+    .def_readwrite("tail_mode", &minst_options::tail_mode, "What happens to the last batch of an epoch.")
+    .def_readwrite("augment", &minst_options::augment, "The random augmentations applied to each sample.")
+    .def_readwrite("sample_layout", &minst_options::sample_layout, "The layout of the samples of each batch.")
+    .def_property(
+      "collect_stats",
+      [](const minst_options& self) { return self.stats != nullptr; },
+      [](minst_options& self, const bool collect) { self.stats = collect ? &stats_marker : nullptr; },
+      "Whether or not to collect statistics of where the loading time goes.");
+
   py::class_<format>(m, "Format")
     .def(py::init<>())
     .def_readwrite("shape", &format::shape, "The shape of the tensor.")
@@ -212,20 +1288,151 @@ PYBIND11_MODULE(pyminst, m)
     .def(py::init<>())
     .def("sample", &sampler::sample, py::arg("num_samples"));
 
-  py::class_<random_sampler, sampler>(m, "RandomSampler").def(py::init<int>());
+  py::class_<batch_sampler, sampler, py_batch_sampler>(
+    m, "BatchSampler", "A sampler whose sample method returns an array with the indices of a whole batch.")
+    .def(py::init<>())
+    .def("sample", &batch_sampler::sample_indices, py::arg("num_elements"), py::arg("batch_size"));
+
+  py::class_<random_sampler, sampler>(m, "RandomSampler").def(py::init<uint64_t>(), py::arg("seed") = 0);
 
   py::class_<callback, py_callback>(m, "Callback")
     .def(py::init<>())
-    .def("eval", &callback::eval, py::arg("sample"), py::arg("label"));
+    .def("eval", &callback::eval, py::arg("samples"), py::arg("labels"));
+
+  py::class_<predictor, py_predictor>(m, "Predictor")
+    .def(py::init<>())
+    .def("predict", &predictor::predict, py::arg("samples"), py::arg("labels"));
+
+  py::class_<view>(m,
+                   "View",
+                   "A dataset made of elements of one or more pairs of files. Ranges, selections and concatenations of "
+                   "views share the opened files of their parts instead of copying any elements.")
+    .def(py::init<const std::string&, const std::string&, const format&, const format&, minst_io_mode>(),
+         py::arg("samples_path"),
+         py::arg("labels_path"),
+         py::arg("sample_format"),
+         py::arg("label_format"),
+         py::arg("io_mode") = MINST_IO_MMAP)
+    .def("range",
+         &view::range,
+         "Creates a view of a range of consecutive elements.",
+         py::arg("first"),
+         py::arg("count"))
+    .def("select", &view::select, "Creates a view of a list of elements, in the order of the list.", py::arg("indices"))
+    .def_static(
+      "concat", &view::concat, "Creates a view of the elements of several views, one after another.", py::arg("parts"))
+    .def("__len__", &view::size, "The number of elements in the view.");
+
+  py::class_<loader>(m,
+                     "Loader",
+                     "Iterates a dataset, yielding (samples, labels) arrays for each batch. Iterating the loader again "
+                     "starts a new epoch. The arrays are read-only views of the loader's buffers, which may be "
+                     "overwritten once the next batch is requested.")
+    .def(py::init<const std::string&,
+                  const std::string&,
+                  const format&,
+                  const format&,
+                  uint32_t,
+                  sampler*,
+                  const minst_options&,
+                  const std::string&,
+                  const py::object&>(),
+         py::arg("samples_path"),
+         py::arg("labels_path"),
+         py::arg("sample_format"),
+         py::arg("label_format"),
+         py::arg("batch_size"),
+         py::arg("sampler") = py::none(),
+         py::arg("options") = default_loader_options(),
+         py::arg("cache_path") = std::string(),
+         py::arg("class_weights") = py::none(),
+         py::keep_alive<1, 7>())
+    .def(py::init<const view&, uint32_t, sampler*, const minst_options&, const py::object&>(),
+         py::arg("view"),
+         py::arg("batch_size"),
+         py::arg("sampler") = py::none(),
+         py::arg("options") = default_loader_options(),
+         py::arg("class_weights") = py::none(),
+         py::keep_alive<1, 2>(),
+         py::keep_alive<1, 4>())
+    .def("__len__", &loader::size, "The number of batches in one epoch.")
+    .def("stats",
+         &loader::stats,
+         "The statistics collected so far as a dictionary, which are all zero unless the options collect them.")
+    .def("__iter__",
+         [](py::object self) {
+           self.cast<loader&>().begin_epoch();
+           return self;
+         })
+    .def("__next__", [](py::object self) { return self.cast<loader&>().next_batch(self); });
+
+  py::class_<writer>(m,
+                     "Writer",
+                     "Writes an IDX file. Elements are appended in order, or written at their index, which several "
+                     "threads may do at once for different elements. Arrays are converted to the type of the file.")
+    .def(py::init<const std::string&, const format&, minst_write_mode>(),
+         py::arg("path"),
+         py::arg("format"),
+         py::arg("mode") = MINST_WRITE_STREAM)
+    .def("append",
+         &writer::append,
+         "Appends the elements of an array after the last appended elements.",
+         py::arg("data"))
+    .def("write_at",
+         &writer::write_at,
+         "Writes the elements of an array, starting at the given element index.",
+         py::arg("element_idx"),
+         py::arg("data"))
+    .def("close", &writer::close, "Writes the remaining elements and closes the file.")
+    .def("__enter__", [](py::object self) { return self; })
+    .def("__exit__", [](writer& w, const py::args&) { w.close(); });
 
   m.def("eval",
         eval,
-        "Iterates a dataset.",
+        "Iterates a dataset. Returns the statistics as a dictionary if the options collect them, otherwise None.",
         py::arg("samples_path"),
         py::arg("labels_path"),
         py::arg("sample_format"),
         py::arg("label_format"),
         py::arg("batch_size"),
         py::arg("callback"),
-        py::arg("sampler"));
+        py::arg("sampler"),
+        py::arg("options") = default_options());
+
+  m.def("evaluate",
+        evaluate,
+        "Runs a predictor over every element of a dataset on several threads and returns the confusion matrix, the "
+        "accuracy and the precision and recall of each class, plus the statistics if the options collect them. The "
+        "predictor is called with the GIL held.",
+        py::arg("samples_path"),
+        py::arg("labels_path"),
+        py::arg("sample_format"),
+        py::arg("label_format"),
+        py::arg("batch_size"),
+        py::arg("num_classes"),
+        py::arg("predictor"),
+        py::arg("num_threads") = 1,
+        py::arg("options") = default_options());
+
+  m.def("build_cache",
+        build_cache,
+        "Builds a packed cache file, which holds the elements already converted according to the options.",
+        py::arg("cache_path"),
+        py::arg("samples_path"),
+        py::arg("labels_path"),
+        py::arg("sample_format"),
+        py::arg("label_format"),
+        py::arg("options") = default_options());
+
+  m.def("compute_stats",
+        compute_stats,
+        "Computes the mean, standard deviation, minimum and maximum of each feature and of the whole dataset in raw "
+        "units, and the number of elements of each class. The labels are skipped if the labels path is empty. If a "
+        "stats path is given, the statistics are stored there and read back while the dataset does not change.",
+        py::arg("samples_path"),
+        py::arg("labels_path"),
+        py::arg("sample_format"),
+        py::arg("label_format"),
+        py::arg("num_threads") = 1,
+        py::arg("stats_path") = "");
 }
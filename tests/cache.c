@@ -0,0 +1,168 @@
+/* Checks that a dataset read from a cache returns the same batches as the dataset files, and that the cache follows
+ * changes to the files and the output options. */
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WIDTH 6
+#define HEIGHT 5
+#define BATCH_SIZE 32
+
+/* Checks that a dataset opened with a cache returns the same batches as one opened without it, for two epochs. */
+static int
+check_cache(const struct minst_format* sample_format,
+            const struct minst_format* label_format,
+            const struct minst_options* options)
+{
+  struct minst_options cached_options;
+  struct minst_dataset* expected;
+  struct minst_dataset* actual;
+  struct minst_batch a;
+  struct minst_batch b;
+  size_t sample_size;
+  int epoch;
+
+  cached_options = *options;
+  cached_options.cache_path = "cache_dataset.cache";
+
+  sample_size = ((size_t)WIDTH) * HEIGHT * ((options->sample_output == MINST_OUTPUT_F32) ? sizeof(float) : 1);
+
+  CHECK_OK(minst_dataset_open(
+    &expected, "cache_samples.idx", "cache_labels.idx", sample_format, label_format, BATCH_SIZE, NULL, NULL, options));
+
+  CHECK_OK(minst_dataset_open(&actual,
+                              "cache_samples.idx",
+                              "cache_labels.idx",
+                              sample_format,
+                              label_format,
+                              BATCH_SIZE,
+                              NULL,
+                              NULL,
+                              &cached_options));
+
+  CHECK(minst_dataset_num_batches(expected) == minst_dataset_num_batches(actual));
+
+  for (epoch = 0; epoch < 2; epoch++) {
+
+    for (;;) {
+      CHECK_OK(minst_dataset_next_batch(expected, &a));
+      CHECK_OK(minst_dataset_next_batch(actual, &b));
+      CHECK(a.size == b.size);
+
+      if (a.size == 0) {
+        break;
+      }
+
+      CHECK(memcmp(a.samples, b.samples, a.size * sample_size) == 0);
+      CHECK(memcmp(a.labels, b.labels, a.size * 4) == 0);
+    }
+
+    CHECK_OK(minst_dataset_next_epoch(expected));
+    CHECK_OK(minst_dataset_next_epoch(actual));
+  }
+
+  minst_dataset_close(actual);
+  minst_dataset_close(expected);
+
+  return 0;
+}
+
+/* Reads a whole file into a buffer. Returns zero on failure. */
+static int
+read_file(const char* path, uint8_t* buffer, const size_t capacity, size_t* size)
+{
+  FILE* file;
+
+  file = fopen(path, "rb");
+  if (file == NULL) {
+    return 0;
+  }
+
+  *size = fread(buffer, 1, capacity, file);
+
+  return (fclose(file) == 0) && (*size < capacity);
+}
+
+int
+main(void)
+{
+  static const uint32_t sizes[] = { 300, 301, 300, 300 };
+  static uint8_t payload[300 * WIDTH * HEIGHT];
+  static uint8_t before[1 << 20];
+  static uint8_t after[1 << 20];
+  size_t before_size;
+  size_t after_size;
+  struct minst_format sample_format;
+  struct minst_format label_format;
+  struct minst_options options;
+  size_t s;
+  size_t i;
+  int reopen;
+  int shuffle;
+  int f32;
+  int k;
+
+  remove("cache_dataset.cache");
+
+  /* the files change size between the first rounds, and only their contents in the last one, so that a stale cache
+   * would return the wrong elements */
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+    CHECK(test_write_dataset(
+      "cache_samples.idx", "cache_labels.idx", &sample_format, &label_format, sizes[s], WIDTH, HEIGHT));
+
+    if (s == 3) {
+      for (i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 13);
+      }
+      CHECK(test_write_idx("cache_samples.idx", &sample_format, payload, sizeof(payload)));
+    }
+
+    /* each output change rebuilds the cache, and opening again with the same options reuses it. The rounds alternate
+     * the order of the outputs, so that each round starts with the cache the previous one left */
+    for (k = 0; k < 2; k++) {
+      f32 = (s % 2) ? 1 - k : k;
+      for (shuffle = 0; shuffle < 2; shuffle++) {
+        for (reopen = 0; reopen < 2; reopen++) {
+
+          minst_options_init(&options);
+          options.shuffle = shuffle;
+          options.num_threads = 2;
+          options.prefetch_depth = 1;
+          options.tail_mode = MINST_TAIL_PARTIAL;
+          options.sample_output = f32 ? MINST_OUTPUT_F32 : MINST_OUTPUT_RAW;
+          options.label_output = f32 ? MINST_OUTPUT_I32 : MINST_OUTPUT_RAW;
+
+          if (check_cache(&sample_format, &label_format, &options) != 0) {
+            fprintf(stderr, "mismatch: %u elements, f32 %d, shuffle %d, reopen %d\n", sizes[s], f32, shuffle, reopen);
+            return 1;
+          }
+        }
+      }
+    }
+  }
+
+  /* writing the files of the last round again only touches them, which must neither rebuild the cache nor rewrite it
+   * in place, since other processes may be reading it */
+  CHECK(read_file("cache_dataset.cache", before, sizeof(before), &before_size));
+
+  CHECK(test_write_dataset(
+    "cache_samples.idx", "cache_labels.idx", &sample_format, &label_format, sizes[3], WIDTH, HEIGHT));
+  CHECK(test_write_idx("cache_samples.idx", &sample_format, payload, sizeof(payload)));
+
+  minst_options_init(&options);
+  options.tail_mode = MINST_TAIL_PARTIAL;
+
+  CHECK(check_cache(&sample_format, &label_format, &options) == 0);
+
+  CHECK(read_file("cache_dataset.cache", after, sizeof(after), &after_size));
+  CHECK((before_size == after_size) && (memcmp(before, after, before_size) == 0));
+
+  remove("cache_samples.idx");
+  remove("cache_labels.idx");
+  remove("cache_dataset.cache");
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "common.h"
+
+#include <stdlib.h>
+
+int
+test_write_idx(const char* path, const struct minst_format* format, const void* payload, const size_t size)
+{
+  static const uint8_t type_codes[] = { 0x08, 0x09, 0x0B, 0x0C, 0x0D, 0x0E };
+  uint8_t header[4 + MINST_MAX_RANK * 4];
+  FILE* file;
+  uint32_t i;
+  int ok;
+
+  header[0] = 0;
+  header[1] = 0;
+  header[2] = type_codes[format->type];
+  header[3] = (uint8_t)format->rank;
+
+  for (i = 0; i < format->rank; i++) {
+    header[4 + i * 4 + 0] = (uint8_t)(format->shape[i] >> 24u);
+    header[4 + i * 4 + 1] = (uint8_t)(format->shape[i] >> 16u);
+    header[4 + i * 4 + 2] = (uint8_t)(format->shape[i] >> 8u);
+    header[4 + i * 4 + 3] = (uint8_t)format->shape[i];
+  }
+
+  file = fopen(path, "wb");
+  if (file == NULL) {
+    return 0;
+  }
+
+  ok = (fwrite(header, 4 + ((size_t)format->rank) * 4, 1, file) == 1) && (fwrite(payload, 1, size, file) == size);
+
+  return (fclose(file) == 0) && ok;
+}
+
+int
+test_write_dataset(const char* samples_path,
+                   const char* labels_path,
+                   struct minst_format* sample_format,
+                   struct minst_format* label_format,
+                   const uint32_t num_elements,
+                   const uint32_t width,
+                   const uint32_t height)
+{
+  const size_t num_values = ((size_t)num_elements) * width * height;
+  uint8_t* samples;
+  uint8_t* labels;
+  size_t i;
+  int ok;
+
+  sample_format->type = MINST_TYPE_U8;
+  sample_format->rank = 3;
+  sample_format->shape[0] = num_elements;
+  sample_format->shape[1] = height;
+  sample_format->shape[2] = width;
+  sample_format->shape[3] = 1;
+
+  label_format->type = MINST_TYPE_I32;
+  label_format->rank = 1;
+  label_format->shape[0] = num_elements;
+  label_format->shape[1] = 1;
+  label_format->shape[2] = 1;
+  label_format->shape[3] = 1;
+
+  samples = malloc(num_values + 1);
+  labels = malloc(((size_t)num_elements) * 4 + 1);
+  if ((samples == NULL) || (labels == NULL)) {
+    free(samples);
+    free(labels);
+    return 0;
+  }
+
+  for (i = 0; i < num_values; i++) {
+    samples[i] = (uint8_t)((i * 7u) ^ (i / (((size_t)width) * height)));
+  }
+
+  for (i = 0; i < num_elements; i++) {
+    labels[i * 4 + 0] = (uint8_t)(i >> 24u);
+    labels[i * 4 + 1] = (uint8_t)(i >> 16u);
+    labels[i * 4 + 2] = (uint8_t)(i >> 8u);
+    labels[i * 4 + 3] = (uint8_t)i;
+  }
+
+  ok = test_write_idx(samples_path, sample_format, samples, num_values) &&
+       test_write_idx(labels_path, label_format, labels, ((size_t)num_elements) * 4);
+
+  free(samples);
+  free(labels);
+
+  return ok;
+}
+
+int32_t
+test_load_be32(const void* data)
+{
+  const uint8_t* bytes = (const uint8_t*)data;
+
+  return (int32_t)((((uint32_t)bytes[0]) << 24) | (((uint32_t)bytes[1]) << 16) | (((uint32_t)bytes[2]) << 8) |
+                   ((uint32_t)bytes[3]));
+}
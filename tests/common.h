@@ -0,0 +1,41 @@
+#pragma once
+
+/* Helpers shared by the tests. Each test is its own program, which returns a non-zero exit code if a check fails. */
+
+#include "minst.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define CHECK(cond)                                                                                                    \
+  do {                                                                                                                 \
+    if (!(cond)) {                                                                                                     \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                                        \
+      return 1;                                                                                                        \
+    }                                                                                                                  \
+  } while (0)
+
+#define CHECK_OK(expr)                                                                                                 \
+  do {                                                                                                                 \
+    const enum minst_error check_err = (expr);                                                                         \
+    if (check_err != MINST_ERR_NONE) {                                                                                 \
+      fprintf(stderr, "%s:%d: %s failed: %s\n", __FILE__, __LINE__, #expr, minst_strerror(check_err));                 \
+      return 1;                                                                                                        \
+    }                                                                                                                  \
+  } while (0)
+
+/* Writes an IDX file with the given payload, which must already be in file byte order. Returns zero on failure. */
+int test_write_idx(const char* path, const struct minst_format* format, const void* payload, size_t size);
+
+/* Writes a dataset of U8 samples with a pattern that differs between elements, and I32 labels that are the index of
+ * each element, so that a test can tell which elements a batch holds. Returns zero on failure. */
+int test_write_dataset(const char* samples_path,
+                       const char* labels_path,
+                       struct minst_format* sample_format,
+                       struct minst_format* label_format,
+                       uint32_t num_elements,
+                       uint32_t width,
+                       uint32_t height);
+
+/* Reads a big-endian 32-bit integer, which is how the labels of a batch are stored unless they are converted. */
+int32_t test_load_be32(const void* data);
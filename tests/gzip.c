@@ -0,0 +1,149 @@
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define NUM_ELEMENTS 300
+#define WIDTH 6
+#define HEIGHT 5
+#define BATCH_SIZE 32
+
+/* Writes a gzip compressed copy of a file. */
+static int
+compress_file(const char* src_path, const char* dst_path)
+{
+  char buffer[4096];
+  FILE* src;
+  gzFile dst;
+  size_t size;
+  int ok;
+
+  src = fopen(src_path, "rb");
+  if (src == NULL) {
+    return 0;
+  }
+
+  dst = gzopen(dst_path, "wb");
+  if (dst == NULL) {
+    fclose(src);
+    return 0;
+  }
+
+  ok = 1;
+
+  while (ok && ((size = fread(buffer, 1, sizeof(buffer), src)) > 0)) {
+    ok = gzwrite(dst, buffer, (unsigned int)size) == (int)size;
+  }
+
+  fclose(src);
+
+  return (gzclose(dst) == Z_OK) && ok;
+}
+
+/* Checks that two datasets return the same batches for two epochs. */
+static int
+check_same_batches(struct minst_dataset* expected, struct minst_dataset* actual, const size_t sample_size)
+{
+  struct minst_batch a;
+  struct minst_batch b;
+  int epoch;
+
+  for (epoch = 0; epoch < 2; epoch++) {
+
+    for (;;) {
+      CHECK_OK(minst_dataset_next_batch(expected, &a));
+      CHECK_OK(minst_dataset_next_batch(actual, &b));
+      CHECK(a.size == b.size);
+
+      if (a.size == 0) {
+        break;
+      }
+
+      CHECK(memcmp(a.samples, b.samples, a.size * sample_size) == 0);
+      CHECK(memcmp(a.labels, b.labels, a.size * 4) == 0);
+    }
+
+    CHECK_OK(minst_dataset_next_epoch(expected));
+    CHECK_OK(minst_dataset_next_epoch(actual));
+  }
+
+  return 0;
+}
+
+int
+main(void)
+{
+  static const enum minst_io_mode io_modes[] = { MINST_IO_STDIO, MINST_IO_MMAP, MINST_IO_PRELOAD };
+  struct minst_format sample_format;
+  struct minst_format label_format;
+  struct minst_options options;
+  struct minst_dataset* expected;
+  struct minst_dataset* actual;
+  size_t sample_size;
+  int shuffle;
+  int f32;
+  int gz;
+  int m;
+
+  CHECK(test_write_dataset(
+    "gzip_samples.idx", "gzip_labels.idx", &sample_format, &label_format, NUM_ELEMENTS, WIDTH, HEIGHT));
+  CHECK(compress_file("gzip_samples.idx", "gzip_samples.idx.gz"));
+  CHECK(compress_file("gzip_labels.idx", "gzip_labels.idx.gz"));
+
+  for (f32 = 0; f32 < 2; f32++) {
+    for (shuffle = 0; shuffle < 2; shuffle++) {
+
+      minst_options_init(&options);
+      options.shuffle = shuffle;
+      options.num_threads = 2;
+      options.prefetch_depth = 1;
+      options.sample_output = f32 ? MINST_OUTPUT_F32 : MINST_OUTPUT_RAW;
+
+      sample_size = ((size_t)WIDTH) * HEIGHT * (f32 ? sizeof(float) : 1);
+
+      /* every I/O mode of the uncompressed and the compressed files is compared with the plain stdio reader */
+      for (gz = 0; gz < 2; gz++) {
+        for (m = gz ? 0 : 1; m < 3; m++) {
+
+          options.io_mode = MINST_IO_STDIO;
+          CHECK_OK(minst_dataset_open(&expected,
+                                      "gzip_samples.idx",
+                                      "gzip_labels.idx",
+                                      &sample_format,
+                                      &label_format,
+                                      BATCH_SIZE,
+                                      NULL,
+                                      NULL,
+                                      &options));
+
+          options.io_mode = io_modes[m];
+          CHECK_OK(minst_dataset_open(&actual,
+                                      gz ? "gzip_samples.idx.gz" : "gzip_samples.idx",
+                                      gz ? "gzip_labels.idx.gz" : "gzip_labels.idx",
+                                      &sample_format,
+                                      &label_format,
+                                      BATCH_SIZE,
+                                      NULL,
+                                      NULL,
+                                      &options));
+
+          if (check_same_batches(expected, actual, sample_size) != 0) {
+            fprintf(stderr, "mismatch: gz %d, io mode %d, shuffle %d, f32 %d\n", gz, m, shuffle, f32);
+            return 1;
+          }
+
+          minst_dataset_close(actual);
+          minst_dataset_close(expected);
+        }
+      }
+    }
+  }
+
+  remove("gzip_samples.idx");
+  remove("gzip_labels.idx");
+  remove("gzip_samples.idx.gz");
+  remove("gzip_labels.idx.gz");
+
+  return 0;
+}
@@ -0,0 +1,300 @@
+/* Checks that every vector kernel gives the same results as the scalar kernel it replaces. The kernels are static, so
+ * their source is compiled into this test instead of linking the library. */
+
+#include "common.h"
+
+#include <math.h>
+
+#include "../minst_kernels.c"
+
+#define MAX_COUNT 1000
+
+/* The element counts that are checked, which cover empty inputs, partial vectors and the scalar tails. */
+static const size_t test_counts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, MAX_COUNT };
+
+#define NUM_COUNTS (sizeof(test_counts) / sizeof(test_counts[0]))
+
+static uint32_t
+test_random(uint32_t* state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/* Fills a payload of the given type with values that cover the whole range of integer types, and finite values of both
+ * signs for floating point types. */
+static void
+fill_payload(uint8_t* data, const enum minst_type type, const size_t count, uint32_t seed)
+{
+  uint64_t bits64;
+  uint32_t bits;
+  double value;
+  float value32;
+  size_t i;
+  int b;
+
+  for (i = 0; i < count; i++) {
+
+    bits = test_random(&seed);
+    value = ((double)(int32_t)bits) / 4096.0;
+
+    switch (type) {
+      case MINST_TYPE_U8:
+      case MINST_TYPE_I8:
+        data[i] = (uint8_t)bits;
+        break;
+      case MINST_TYPE_I16:
+        data[i * 2 + 0] = (uint8_t)(bits >> 8u);
+        data[i * 2 + 1] = (uint8_t)bits;
+        break;
+      case MINST_TYPE_I32:
+        for (b = 0; b < 4; b++) {
+          data[i * 4 + (size_t)b] = (uint8_t)(bits >> (24u - 8u * (uint32_t)b));
+        }
+        break;
+      case MINST_TYPE_F32:
+        value32 = (float)value;
+        memcpy(&bits, &value32, sizeof(bits));
+        for (b = 0; b < 4; b++) {
+          data[i * 4 + (size_t)b] = (uint8_t)(bits >> (24u - 8u * (uint32_t)b));
+        }
+        break;
+      case MINST_TYPE_F64:
+        memcpy(&bits64, &value, sizeof(bits64));
+        for (b = 0; b < 8; b++) {
+          data[i * 8 + (size_t)b] = (uint8_t)(bits64 >> (56u - 8u * (uint32_t)b));
+        }
+        break;
+    }
+  }
+}
+
+static int
+check_convert(const char* name, const minst_convert_f32_func* table)
+{
+  static uint8_t payload[MAX_COUNT * 8 + 1];
+  static float expected[MAX_COUNT];
+  static float actual[MAX_COUNT];
+  int type;
+  size_t c;
+
+  for (type = (int)MINST_TYPE_U8; type <= (int)MINST_TYPE_F64; type++) {
+
+    /* the payload starts at an odd address, like the elements of a file whose header has an odd size */
+    fill_payload(payload + 1, (enum minst_type)type, MAX_COUNT, (uint32_t)type + 1u);
+
+    for (c = 0; c < NUM_COUNTS; c++) {
+
+      memset(actual, 0, sizeof(actual));
+
+      minst_convert_f32_scalar_table[type](payload + 1, expected, test_counts[c], 1.0f / 255.0f, -0.5f);
+      table[type](payload + 1, actual, test_counts[c], 1.0f / 255.0f, -0.5f);
+
+      if (memcmp(expected, actual, test_counts[c] * sizeof(float)) != 0) {
+        fprintf(stderr, "%s conversion of type %d differs for %u elements\n", name, type, (unsigned int)test_counts[c]);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Fills values in [-range / 2, range / 2), for images as well as displacement fields of a few pixels. */
+static void
+fill_image(float* data, const size_t count, const float range, uint32_t seed)
+{
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    data[i] = (((float)(test_random(&seed) & 0xFFFFu)) / 65536.0f - 0.5f) * range;
+  }
+}
+
+static int
+check_warp(const char* name, const minst_warp_func warp)
+{
+  static const uint32_t sizes[][3] = { { 28, 28, 1 }, { 13, 7, 1 }, { 8, 3, 1 }, { 5, 4, 1 }, { 9, 6, 3 } };
+  static const float matrices[][6] = { { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+                                       { 0.9f, -0.2f, 2.5f, 0.3f, 1.1f, -1.75f },
+                                       { -1.0f, 0.0f, 27.0f, 0.0f, 1.0f, 0.5f },
+                                       { 40.0f, 3.0f, -100.0f, -7.0f, 55.0f, 1e9f } };
+  static float src[28 * 28 * 3];
+  static float displacement[28 * 28 * 2];
+  static float expected[28 * 28 * 3];
+  static float actual[28 * 28 * 3];
+  size_t num_values;
+  size_t s;
+  size_t m;
+  size_t i;
+  int d;
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+    num_values = ((size_t)sizes[s][0]) * sizes[s][1] * sizes[s][2];
+
+    fill_image(src, num_values, 1.0f, 7u);
+    fill_image(displacement, ((size_t)sizes[s][0]) * sizes[s][1] * 2, 8.0f, 11u);
+
+    /* coordinates that are not numbers sample the fill value instead of converting them to integers */
+    displacement[3] = (float)HUGE_VAL - (float)HUGE_VAL;
+    displacement[((size_t)sizes[s][0]) * sizes[s][1] + 4] = displacement[3];
+
+    for (m = 0; m < sizeof(matrices) / sizeof(matrices[0]); m++) {
+      for (d = 0; d < 2; d++) {
+
+        minst_warp_scalar(
+          src, expected, sizes[s][0], sizes[s][1], sizes[s][2], matrices[m], d ? displacement : NULL, -1.0f);
+        warp(src, actual, sizes[s][0], sizes[s][1], sizes[s][2], matrices[m], d ? displacement : NULL, -1.0f);
+
+        if (memcmp(expected, actual, num_values * sizeof(float)) != 0) {
+          fprintf(stderr,
+                  "%s warp differs for size %u, matrix %u, displacement %d\n",
+                  name,
+                  (unsigned int)s,
+                  (unsigned int)m,
+                  d);
+          return 1;
+        }
+
+        if (d) {
+          for (i = 0; i < sizes[s][2]; i++) {
+            CHECK(expected[3 * sizes[s][2] + i] == -1.0f);
+            CHECK(expected[4 * sizes[s][2] + i] == -1.0f);
+          }
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+#ifdef MINST_HAVE_AVX2
+
+static int
+check_noise(const char* name, const minst_noise_func noise)
+{
+  static float expected[MAX_COUNT];
+  static float actual[MAX_COUNT];
+  uint32_t key;
+  size_t c;
+
+  for (key = 0; key < 3; key++) {
+    for (c = 0; c < NUM_COUNTS; c++) {
+
+      fill_image(expected, test_counts[c], 1.0f, key + 3u);
+      memcpy(actual, expected, test_counts[c] * sizeof(float));
+
+      minst_noise_scalar(expected, test_counts[c], key * 0x9E3779B9u, 0.25f);
+      noise(actual, test_counts[c], key * 0x9E3779B9u, 0.25f);
+
+      if (memcmp(expected, actual, test_counts[c] * sizeof(float)) != 0) {
+        fprintf(stderr, "%s noise differs for key %u and %u values\n", name, key, (unsigned int)test_counts[c]);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+#endif /* MINST_HAVE_AVX2 */
+
+/* Adds several elements with each kernel and compares the running sums, which must match exactly. */
+static int
+check_moments(const char* name, const minst_moments_func moments)
+{
+  static double src[MAX_COUNT];
+  static double shift[MAX_COUNT];
+  static double expected[4][MAX_COUNT];
+  static double actual[4][MAX_COUNT];
+  uint32_t seed;
+  size_t c;
+  size_t i;
+  int e;
+  int k;
+
+  for (c = 0; c < NUM_COUNTS; c++) {
+
+    seed = 5u;
+
+    for (i = 0; i < test_counts[c]; i++) {
+      shift[i] = 1e9 + (double)(test_random(&seed) & 0xFFu);
+      expected[0][i] = actual[0][i] = 0.0;
+      expected[1][i] = actual[1][i] = 0.0;
+      expected[2][i] = actual[2][i] = HUGE_VAL;
+      expected[3][i] = actual[3][i] = -HUGE_VAL;
+    }
+
+    for (e = 0; e < 5; e++) {
+
+      for (i = 0; i < test_counts[c]; i++) {
+        src[i] = 1e9 + ((double)(int32_t)test_random(&seed)) / 65536.0;
+      }
+
+      minst_moments_scalar(src, shift, test_counts[c], expected[0], expected[1], expected[2], expected[3]);
+      moments(src, shift, test_counts[c], actual[0], actual[1], actual[2], actual[3]);
+    }
+
+    for (k = 0; k < 4; k++) {
+      if (memcmp(expected[k], actual[k], test_counts[c] * sizeof(double)) != 0) {
+        fprintf(stderr, "%s moments differ for %u values\n", name, (unsigned int)test_counts[c]);
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Checks that values which do not fit in a float are converted to doubles exactly. */
+static int
+check_convert_f64(void)
+{
+  static const uint8_t i32[8] = { 0x7F, 0xFF, 0xFF, 0xFF, 0x80, 0x00, 0x00, 0x01 };
+  static const uint8_t f64[8] = { 0x41, 0xCD, 0xCD, 0x65, 0x00, 0x00, 0x00, 0x01 };
+  double values[2];
+
+  minst_get_convert_f64(MINST_TYPE_I32)(i32, values, 2);
+  CHECK(values[0] == 2147483647.0);
+  CHECK(values[1] == -2147483647.0);
+
+  minst_get_convert_f64(MINST_TYPE_F64)(f64, values, 1);
+  CHECK(values[0] == 1000000000.0000001);
+
+  return 0;
+}
+
+int
+main(void)
+{
+  /* the scalar warp is compared with itself, which still checks how it treats coordinates that are not numbers */
+  CHECK(check_warp("scalar", minst_warp_scalar) == 0);
+
+  CHECK(check_convert_f64() == 0);
+
+#ifdef MINST_HAVE_SSE2
+  CHECK(check_convert("sse2", minst_convert_f32_sse2_table) == 0);
+  CHECK(check_moments("sse2", minst_moments_sse2) == 0);
+#endif
+
+#ifdef MINST_HAVE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    CHECK(check_convert("avx2", minst_convert_f32_avx2_table) == 0);
+    CHECK(check_warp("avx2", minst_warp_avx2) == 0);
+    CHECK(check_noise("avx2", minst_noise_avx2) == 0);
+    CHECK(check_moments("avx2", minst_moments_avx2) == 0);
+  } else {
+    printf("avx2 is not supported, so its kernels are not checked\n");
+  }
+#endif
+
+#ifdef MINST_HAVE_NEON
+  CHECK(check_convert("neon", minst_convert_f32_neon_table) == 0);
+#endif
+
+  return 0;
+}
@@ -0,0 +1,451 @@
+/* Checks that the permutations, the shuffled epochs, the shards and the tail modes visit the elements they should, and
+ * that the shards are augmented differently. */
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_ELEMENTS 1003
+#define BATCH_SIZE 64
+#define WIDTH 4
+#define HEIGHT 3
+
+/* Reads one epoch and counts how often each element is returned. The order of the elements is kept if asked for. */
+static int
+read_epoch(struct minst_dataset* dataset, uint32_t* counts, uint32_t* order, uint32_t* total)
+{
+  struct minst_batch batch;
+  const int32_t* labels;
+  uint32_t i;
+
+  memset(counts, 0, NUM_ELEMENTS * sizeof(uint32_t));
+
+  *total = 0;
+
+  for (;;) {
+
+    CHECK_OK(minst_dataset_next_batch(dataset, &batch));
+
+    if (batch.size == 0) {
+      break;
+    }
+
+    labels = batch.labels;
+
+    for (i = 0; i < batch.size; i++) {
+      CHECK((labels[i] >= 0) && (labels[i] < NUM_ELEMENTS));
+      counts[labels[i]]++;
+      if (order && (*total < NUM_ELEMENTS)) {
+        order[*total] = (uint32_t)labels[i];
+      }
+      (*total)++;
+    }
+  }
+
+  CHECK_OK(minst_dataset_next_epoch(dataset));
+
+  return 0;
+}
+
+static int
+check_permutations(void)
+{
+  static const uint32_t sizes[] = { 1, 2, 3, 7, 64, 1000, 65537 };
+  static uint8_t seen[65537];
+  static uint32_t first[65537];
+  struct minst_permutation perm;
+  uint64_t seed;
+  uint64_t epoch;
+  uint32_t element;
+  uint32_t same;
+  size_t s;
+  uint32_t i;
+
+  for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    for (seed = 0; seed < 3; seed++) {
+      for (epoch = 0; epoch < 3; epoch++) {
+
+        memset(seen, 0, sizes[s]);
+
+        minst_permutation_init(&perm, sizes[s], seed * 12345u, epoch);
+
+        same = 0;
+
+        for (i = 0; i < sizes[s]; i++) {
+          element = minst_permute(&perm, i);
+          CHECK(element < sizes[s]);
+          CHECK(!seen[element]);
+          seen[element] = 1;
+          if (epoch == 0) {
+            first[i] = element;
+          } else {
+            same += (first[i] == element) ? 1u : 0u;
+          }
+        }
+
+        /* the epochs of larger permutations differ in most positions */
+        if ((epoch > 0) && (sizes[s] >= 64)) {
+          CHECK(same < sizes[s] / 4);
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* Every shuffled epoch returns each element once, in an order that changes between epochs and only depends on the
+ * seed, whatever the number of threads and the prefetch depth. */
+static int
+check_epochs(const struct minst_format* sample_format, const struct minst_format* label_format)
+{
+  static uint32_t counts[NUM_ELEMENTS];
+  static uint32_t orders[3][NUM_ELEMENTS];
+  static uint32_t order[NUM_ELEMENTS];
+  struct minst_options options;
+  struct minst_dataset* dataset;
+  uint32_t total;
+  uint32_t config;
+  uint32_t epoch;
+  uint32_t i;
+  int mode;
+
+  for (mode = (int)MINST_SHUFFLE_TABLE; mode <= (int)MINST_SHUFFLE_COUNTER; mode++) {
+    for (config = 0; config < 3; config++) {
+
+      minst_options_init(&options);
+      options.shuffle = 1;
+      options.shuffle_mode = (enum minst_shuffle_mode)mode;
+      options.seed = 42;
+      options.tail_mode = MINST_TAIL_PARTIAL;
+      options.label_output = MINST_OUTPUT_I32;
+      options.num_threads = 1 + config;
+      options.prefetch_depth = config;
+
+      CHECK_OK(minst_dataset_open(&dataset,
+                                  "sampling_samples.idx",
+                                  "sampling_labels.idx",
+                                  sample_format,
+                                  label_format,
+                                  BATCH_SIZE,
+                                  NULL,
+                                  NULL,
+                                  &options));
+
+      for (epoch = 0; epoch < 3; epoch++) {
+
+        CHECK(read_epoch(dataset, counts, (config == 0) ? orders[epoch] : order, &total) == 0);
+        CHECK(total == NUM_ELEMENTS);
+
+        for (i = 0; i < NUM_ELEMENTS; i++) {
+          CHECK(counts[i] == 1);
+        }
+
+        if (config > 0) {
+          CHECK(memcmp(order, orders[epoch], sizeof(order)) == 0);
+        }
+      }
+
+      minst_dataset_close(dataset);
+
+      CHECK(memcmp(orders[0], orders[1], sizeof(orders[0])) != 0);
+      CHECK(memcmp(orders[1], orders[2], sizeof(orders[1])) != 0);
+    }
+  }
+
+  return 0;
+}
+
+/* The shards of an epoch together return every element. Padded shards repeat as few elements as needed to have the
+ * same size, while dropping leaves out fewer elements than there are shards and repeats none. */
+static int
+check_shards(const struct minst_format* sample_format, const struct minst_format* label_format)
+{
+  static uint32_t counts[NUM_ELEMENTS];
+  static uint32_t totals[NUM_ELEMENTS];
+  struct minst_options options;
+  struct minst_dataset* dataset;
+  uint32_t world_size;
+  uint32_t shard_size;
+  uint32_t covered;
+  uint32_t total;
+  uint32_t rank;
+  uint32_t epoch;
+  uint32_t i;
+  int shuffle;
+  int mode;
+
+  for (world_size = 1; world_size <= 4; world_size++) {
+    for (mode = (int)MINST_SHARD_PAD; mode <= (int)MINST_SHARD_DROP; mode++) {
+      for (shuffle = 0; shuffle < 2; shuffle++) {
+
+        shard_size = NUM_ELEMENTS / world_size;
+
+        if ((mode == (int)MINST_SHARD_PAD) && (NUM_ELEMENTS % world_size)) {
+          shard_size++;
+        }
+
+        for (epoch = 0; epoch < 2; epoch++) {
+
+          memset(totals, 0, sizeof(totals));
+
+          for (rank = 0; rank < world_size; rank++) {
+
+            minst_options_init(&options);
+            options.shuffle = shuffle;
+            options.seed = 7;
+            options.world_size = world_size;
+            options.rank = rank;
+            options.shard_mode = (enum minst_shard_mode)mode;
+            options.tail_mode = MINST_TAIL_PARTIAL;
+            options.label_output = MINST_OUTPUT_I32;
+
+            CHECK_OK(minst_dataset_open(&dataset,
+                                        "sampling_samples.idx",
+                                        "sampling_labels.idx",
+                                        sample_format,
+                                        label_format,
+                                        BATCH_SIZE,
+                                        NULL,
+                                        NULL,
+                                        &options));
+
+            /* the second epoch is checked with datasets that have been through the first one */
+            if (epoch > 0) {
+              CHECK(read_epoch(dataset, counts, NULL, &total) == 0);
+            }
+
+            CHECK(read_epoch(dataset, counts, NULL, &total) == 0);
+            CHECK(total == shard_size);
+
+            minst_dataset_close(dataset);
+
+            for (i = 0; i < NUM_ELEMENTS; i++) {
+              CHECK(counts[i] <= 1);
+              totals[i] += counts[i];
+            }
+          }
+
+          covered = 0;
+
+          for (i = 0; i < NUM_ELEMENTS; i++) {
+            CHECK(totals[i] <= ((mode == (int)MINST_SHARD_PAD) ? 2u : 1u));
+            covered += (totals[i] > 0) ? 1u : 0u;
+          }
+
+          if (mode == (int)MINST_SHARD_PAD) {
+            CHECK(covered == NUM_ELEMENTS);
+          } else {
+            CHECK(covered == shard_size * world_size);
+          }
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* The tail modes give the expected number and size of batches. Wrapping fills the last batch with the first elements
+ * of the epoch, dropping leaves out the elements that do not fill a batch, and partial batches return each element
+ * once. With sharding, this applies to the elements of the shard. */
+static int
+check_tails(const struct minst_format* sample_format, const struct minst_format* label_format)
+{
+  static uint32_t order[NUM_ELEMENTS + BATCH_SIZE];
+  static uint8_t seen[NUM_ELEMENTS];
+  struct minst_options options;
+  struct minst_dataset* dataset;
+  struct minst_batch batch;
+  uint32_t world_size;
+  uint32_t shard_size;
+  uint32_t num_batches;
+  uint32_t expected;
+  uint32_t total;
+  uint32_t epoch;
+  uint32_t i;
+  int shuffle;
+  int mode;
+
+  for (world_size = 1; world_size <= 2; world_size++) {
+    for (mode = (int)MINST_TAIL_WRAP; mode <= (int)MINST_TAIL_PARTIAL; mode++) {
+      for (shuffle = 0; shuffle < 2; shuffle++) {
+
+        minst_options_init(&options);
+        options.shuffle = shuffle;
+        options.seed = 3;
+        options.world_size = world_size;
+        options.rank = world_size - 1;
+        options.tail_mode = (enum minst_tail_mode)mode;
+        options.label_output = MINST_OUTPUT_I32;
+        options.num_threads = 2;
+        options.prefetch_depth = 1;
+
+        CHECK_OK(minst_dataset_open(&dataset,
+                                    "sampling_samples.idx",
+                                    "sampling_labels.idx",
+                                    sample_format,
+                                    label_format,
+                                    BATCH_SIZE,
+                                    NULL,
+                                    NULL,
+                                    &options));
+
+        shard_size = (NUM_ELEMENTS + world_size - 1) / world_size;
+
+        if (mode == (int)MINST_TAIL_DROP) {
+          num_batches = shard_size / BATCH_SIZE;
+          expected = num_batches * BATCH_SIZE;
+        } else {
+          num_batches = (shard_size + BATCH_SIZE - 1) / BATCH_SIZE;
+          expected = (mode == (int)MINST_TAIL_WRAP) ? num_batches * BATCH_SIZE : shard_size;
+        }
+
+        CHECK(minst_dataset_num_batches(dataset) == num_batches);
+
+        for (epoch = 0; epoch < 2; epoch++) {
+
+          memset(seen, 0, sizeof(seen));
+
+          total = 0;
+
+          for (i = 0;; i++) {
+
+            CHECK_OK(minst_dataset_next_batch(dataset, &batch));
+
+            if (batch.size == 0) {
+              break;
+            }
+
+            /* only the last batch of a partial epoch may be smaller */
+            CHECK(batch.size == (((mode == (int)MINST_TAIL_PARTIAL) && (i + 1 == num_batches))
+                                   ? shard_size - (i * BATCH_SIZE)
+                                   : BATCH_SIZE));
+
+            CHECK(total + batch.size <= expected);
+
+            memcpy(&order[total], batch.labels, batch.size * sizeof(uint32_t));
+
+            total += batch.size;
+          }
+
+          CHECK(i == num_batches);
+          CHECK(total == expected);
+
+          for (i = 0; i < total; i++) {
+            CHECK(order[i] < NUM_ELEMENTS);
+            if (i < shard_size) {
+              CHECK(!seen[order[i]]);
+              seen[order[i]] = 1;
+            } else {
+              CHECK(order[i] == order[i - shard_size]);
+            }
+          }
+
+          CHECK_OK(minst_dataset_next_epoch(dataset));
+        }
+
+        minst_dataset_close(dataset);
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* The samples at the same position of the shards of two ranks get different augmentations, while opening a shard
+ * again repeats them. The augmentation is the noise added to the plain samples. */
+static int
+check_augment(const struct minst_format* sample_format, const struct minst_format* label_format)
+{
+  static float noise[3][BATCH_SIZE * WIDTH * HEIGHT];
+  struct minst_options options;
+  struct minst_dataset* plain;
+  struct minst_dataset* augmented;
+  struct minst_batch a;
+  struct minst_batch b;
+  const float* plain_values;
+  const float* augmented_values;
+  uint32_t same;
+  uint32_t run;
+  uint32_t i;
+
+  for (run = 0; run < 3; run++) {
+
+    minst_options_init(&options);
+    options.shuffle = 0;
+    options.world_size = 2;
+    options.rank = (run == 1) ? 1 : 0;
+    options.sample_output = MINST_OUTPUT_F32;
+
+    CHECK_OK(minst_dataset_open(&plain,
+                                "sampling_samples.idx",
+                                "sampling_labels.idx",
+                                sample_format,
+                                label_format,
+                                BATCH_SIZE,
+                                NULL,
+                                NULL,
+                                &options));
+
+    options.augment.noise_std = 0.5f;
+
+    CHECK_OK(minst_dataset_open(&augmented,
+                                "sampling_samples.idx",
+                                "sampling_labels.idx",
+                                sample_format,
+                                label_format,
+                                BATCH_SIZE,
+                                NULL,
+                                NULL,
+                                &options));
+
+    CHECK_OK(minst_dataset_next_batch(plain, &a));
+    CHECK_OK(minst_dataset_next_batch(augmented, &b));
+    CHECK((a.size == BATCH_SIZE) && (b.size == BATCH_SIZE));
+
+    plain_values = a.samples;
+    augmented_values = b.samples;
+
+    for (i = 0; i < BATCH_SIZE * WIDTH * HEIGHT; i++) {
+      noise[run][i] = augmented_values[i] - plain_values[i];
+    }
+
+    minst_dataset_close(augmented);
+    minst_dataset_close(plain);
+  }
+
+  CHECK(memcmp(noise[0], noise[2], sizeof(noise[0])) == 0);
+
+  same = 0;
+
+  for (i = 0; i < BATCH_SIZE * WIDTH * HEIGHT; i++) {
+    same += (noise[0][i] == noise[1][i]) ? 1u : 0u;
+  }
+
+  CHECK(same < BATCH_SIZE);
+
+  return 0;
+}
+
+int
+main(void)
+{
+  struct minst_format sample_format;
+  struct minst_format label_format;
+
+  CHECK(test_write_dataset(
+    "sampling_samples.idx", "sampling_labels.idx", &sample_format, &label_format, NUM_ELEMENTS, WIDTH, HEIGHT));
+
+  CHECK(check_permutations() == 0);
+  CHECK(check_epochs(&sample_format, &label_format) == 0);
+  CHECK(check_shards(&sample_format, &label_format) == 0);
+  CHECK(check_tails(&sample_format, &label_format) == 0);
+  CHECK(check_augment(&sample_format, &label_format) == 0);
+
+  remove("sampling_samples.idx");
+  remove("sampling_labels.idx");
+
+  return 0;
+}
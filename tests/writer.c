@@ -0,0 +1,239 @@
+/* Writes datasets of every type with each write mode and checks that they read back as written. */
+
+#include "common.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define TEST_HAVE_THREADS 1
+#endif
+
+#define NUM_THREADS 4
+
+static const uint32_t type_sizes[] = { 1, 1, 2, 4, 4, 8 };
+
+/* Fills elements with values that use every byte of the type, including negative values for signed types. */
+static void
+fill_values(void* data, const enum minst_type type, const size_t count)
+{
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    switch (type) {
+      case MINST_TYPE_U8:
+        ((uint8_t*)data)[i] = (uint8_t)(i * 31u);
+        break;
+      case MINST_TYPE_I8:
+        ((int8_t*)data)[i] = (int8_t)(int32_t)((i * 31u) % 256u - 128u);
+        break;
+      case MINST_TYPE_I16:
+        ((int16_t*)data)[i] = (int16_t)(int32_t)((i * 40503u) % 65536u - 32768u);
+        break;
+      case MINST_TYPE_I32:
+        ((int32_t*)data)[i] = (int32_t)(i * 2654435761u);
+        break;
+      case MINST_TYPE_F32:
+        ((float*)data)[i] = ((float)(int32_t)(i * 2654435761u)) / 1024.0f;
+        break;
+      case MINST_TYPE_F64:
+        ((double*)data)[i] = ((double)(int32_t)(i * 2654435761u)) / 3.0;
+        break;
+    }
+  }
+}
+
+#ifdef TEST_HAVE_THREADS
+
+struct write_job
+{
+  struct minst_writer* writer;
+
+  const uint8_t* data;
+
+  uint32_t element_size;
+
+  uint32_t first;
+
+  uint32_t count;
+
+  enum minst_error error;
+};
+
+static void*
+write_main(void* job_ptr)
+{
+  struct write_job* job = job_ptr;
+
+  job->error = minst_writer_write_at(
+    job->writer, job->first, job->data + ((size_t)job->first) * job->element_size, job->count);
+
+  return NULL;
+}
+
+#endif
+
+/* Writes the elements with the given mode. Appends go in pieces of different sizes, and positional writes go from the
+ * last piece to the first, or from several threads at once. The last elements are left out of sparse files. */
+static int
+write_elements(const char* path,
+               const struct minst_format* format,
+               const enum minst_write_mode mode,
+               const uint8_t* data,
+               const uint32_t num_written)
+{
+  const uint32_t element_size = type_sizes[format->type] * format->shape[1] * format->shape[2] * format->shape[3];
+  struct minst_writer* writer;
+  uint32_t first;
+  uint32_t count;
+#ifdef TEST_HAVE_THREADS
+  struct write_job jobs[NUM_THREADS];
+  pthread_t threads[NUM_THREADS];
+  uint32_t t;
+#endif
+
+  CHECK_OK(minst_writer_open(&writer, path, format, mode));
+
+  if (mode == MINST_WRITE_STREAM) {
+    for (first = 0, count = 1; first < num_written; first += count, count *= 3) {
+      count = ((num_written - first) < count) ? (num_written - first) : count;
+      CHECK_OK(minst_writer_append(writer, data + ((size_t)first) * element_size, count));
+    }
+  } else {
+#ifdef TEST_HAVE_THREADS
+    if (mode == MINST_WRITE_PREALLOCATE) {
+      for (t = 0; t < NUM_THREADS; t++) {
+        jobs[t].writer = writer;
+        jobs[t].data = data;
+        jobs[t].element_size = element_size;
+        jobs[t].first = (num_written * t) / NUM_THREADS;
+        jobs[t].count = (num_written * (t + 1)) / NUM_THREADS - jobs[t].first;
+        CHECK(pthread_create(&threads[t], NULL, write_main, &jobs[t]) == 0);
+      }
+      for (t = 0; t < NUM_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        CHECK_OK(jobs[t].error);
+      }
+      return (minst_writer_close(writer) == MINST_ERR_NONE) ? 0 : 1;
+    }
+#endif
+    for (first = num_written; first > 0; first -= count) {
+      count = (first < 100) ? first : 100;
+      CHECK_OK(minst_writer_write_at(writer, first - count, data + ((size_t)(first - count)) * element_size, count));
+    }
+  }
+
+  CHECK_OK(minst_writer_close(writer));
+
+  return 0;
+}
+
+/* Writes a dataset and reads it back in one batch of native values. */
+static int
+check_round_trip(const enum minst_type type, const enum minst_write_mode mode, const uint32_t num_elements)
+{
+  struct minst_format sample_format;
+  struct minst_format label_format;
+  struct minst_format read_format;
+  struct minst_options options;
+  struct minst_dataset* dataset;
+  struct minst_batch batch;
+  uint32_t element_size;
+  uint32_t num_written;
+  uint8_t* samples;
+  int32_t* labels;
+  uint32_t i;
+
+  sample_format.type = type;
+  sample_format.rank = 3;
+  sample_format.shape[0] = num_elements;
+  sample_format.shape[1] = 3;
+  sample_format.shape[2] = 5;
+  sample_format.shape[3] = 1;
+
+  label_format.type = MINST_TYPE_I32;
+  label_format.rank = 1;
+  label_format.shape[0] = num_elements;
+  label_format.shape[1] = 1;
+  label_format.shape[2] = 1;
+  label_format.shape[3] = 1;
+
+  element_size = type_sizes[type] * 15;
+
+  /* elements that are never written read back as zero */
+  num_written = (mode == MINST_WRITE_SPARSE) ? (num_elements - 10) : num_elements;
+
+  samples = calloc(num_elements, element_size);
+  labels = calloc(num_elements, sizeof(int32_t));
+  CHECK((samples != NULL) && (labels != NULL));
+
+  fill_values(samples, type, ((size_t)num_written) * 15);
+
+  for (i = 0; i < num_written; i++) {
+    labels[i] = (int32_t)i - 5;
+  }
+
+  if ((write_elements("writer_samples.idx", &sample_format, mode, samples, num_written) != 0) ||
+      (write_elements("writer_labels.idx", &label_format, mode, (const uint8_t*)labels, num_written) != 0)) {
+    fprintf(stderr, "writing type %d with mode %d failed\n", (int)type, (int)mode);
+    return 1;
+  }
+
+  CHECK_OK(minst_read_format("writer_samples.idx", &read_format));
+  CHECK(read_format.type == type);
+  CHECK(read_format.rank == 3);
+  CHECK(memcmp(read_format.shape, sample_format.shape, 3 * sizeof(uint32_t)) == 0);
+
+  minst_options_init(&options);
+  options.shuffle = 0;
+  options.sample_output = MINST_OUTPUT_NATIVE;
+  options.label_output = MINST_OUTPUT_I32;
+
+  CHECK_OK(minst_dataset_open(&dataset,
+                              "writer_samples.idx",
+                              "writer_labels.idx",
+                              &sample_format,
+                              &label_format,
+                              num_elements,
+                              NULL,
+                              NULL,
+                              &options));
+
+  CHECK_OK(minst_dataset_next_batch(dataset, &batch));
+  CHECK(batch.size == num_elements);
+
+  if ((memcmp(batch.samples, samples, ((size_t)num_elements) * element_size) != 0) ||
+      (memcmp(batch.labels, labels, ((size_t)num_elements) * sizeof(int32_t)) != 0)) {
+    fprintf(stderr, "type %d written with mode %d does not read back as written\n", (int)type, (int)mode);
+    return 1;
+  }
+
+  minst_dataset_close(dataset);
+
+  free(samples);
+  free(labels);
+
+  remove("writer_samples.idx");
+  remove("writer_labels.idx");
+
+  return 0;
+}
+
+int
+main(void)
+{
+  int type;
+  int mode;
+
+  for (type = (int)MINST_TYPE_U8; type <= (int)MINST_TYPE_F64; type++) {
+    for (mode = (int)MINST_WRITE_STREAM; mode <= (int)MINST_WRITE_PREALLOCATE; mode++) {
+      CHECK(check_round_trip((enum minst_type)type, (enum minst_write_mode)mode, 1000) == 0);
+    }
+  }
+
+  /* bytes need no swapping, so the last append, which is larger than the staging buffer, is partly written directly */
+  CHECK(check_round_trip(MINST_TYPE_U8, MINST_WRITE_STREAM, 600000) == 0);
+
+  return 0;
+}
@@ -0,0 +1,517 @@
+#if defined(__unix__) || defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L
+#define MINST_HAVE_CLOCK_GETTIME 1
+#endif
+
+#include "minst.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LIST 16
+
+/* The settings that are swept, each of them as a list of values. */
+struct sweep
+{
+  uint32_t io_modes[MAX_LIST];
+
+  uint32_t num_io_modes;
+
+  uint32_t batch_sizes[MAX_LIST];
+
+  uint32_t num_batch_sizes;
+
+  uint32_t thread_counts[MAX_LIST];
+
+  uint32_t num_thread_counts;
+
+  uint32_t shuffles[MAX_LIST];
+
+  uint32_t num_shuffles;
+};
+
+/* The measurements of one configuration. */
+struct result
+{
+  uint64_t num_samples;
+
+  uint64_t num_bytes;
+
+  double seconds;
+
+  double p50;
+
+  double p99;
+};
+
+static const char* io_mode_names[] = { "stdio", "mmap", "preload" };
+
+static const char* type_names[] = { "u8", "i8", "i16", "i32", "f32", "f64" };
+
+static const unsigned char type_codes[] = { 0x08, 0x09, 0x0B, 0x0C, 0x0D, 0x0E };
+
+static const uint32_t type_sizes[] = { 1, 1, 2, 4, 4, 8 };
+
+static void
+print_usage(const char* program)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "\n"
+          "Creates a synthetic dataset and measures how fast it is loaded, for each combination of the swept settings.\n"
+          "Results are printed as CSV, one row per combination.\n"
+          "\n"
+          "options:\n"
+          "  --elements <n>          The number of elements in the dataset. The default is 60000.\n"
+          "  --shape <d1xd2...>      The shape of one sample, up to three dimensions. The default is 28x28.\n"
+          "  --type <name>           The sample type: u8, i8, i16, i32, f32 or f64. The default is u8.\n"
+          "  --io <list>             The I/O modes: stdio, mmap and/or preload. The default is all three.\n"
+          "  --batch-sizes <list>    The batch sizes. The default is 1,32,256.\n"
+          "  --threads <list>        The numbers of threads that assemble a batch. The default is 1,4.\n"
+          "  --shuffle <list>        Whether or not to shuffle, as 0 and/or 1. The default is 0,1.\n"
+          "  --prefetch <n>          The number of batches prepared ahead of time. The default is 0.\n"
+          "  --f32                   Convert the samples to normalized 32-bit floats.\n"
+          "  --epochs <n>            The number of measured epochs, after one warm-up epoch. The default is 1.\n"
+          "  --dir <path>            The directory the synthetic files are written to. The default is the current one.\n"
+          "  --json                  Print one JSON object per line instead of CSV.\n"
+          "\n"
+          "Lists are separated by commas.\n",
+          program);
+}
+
+static double
+now(void)
+{
+#ifdef MINST_HAVE_CLOCK_GETTIME
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((double)t.tv_sec) + ((double)t.tv_nsec) * 1.0e-9;
+#else
+  return ((double)clock()) / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+static int
+parse_list(const char* text, const char* const* names, const uint32_t num_names, uint32_t* values, uint32_t* count)
+{
+  char buffer[256];
+  char* token;
+  uint32_t i;
+
+  if (strlen(text) >= sizeof(buffer)) {
+    return 0;
+  }
+
+  strcpy(buffer, text);
+
+  *count = 0;
+
+  for (token = strtok(buffer, ","); token != NULL; token = strtok(NULL, ",")) {
+
+    if (*count == MAX_LIST) {
+      return 0;
+    }
+
+    if (names == NULL) {
+      values[(*count)++] = (uint32_t)strtoul(token, NULL, 10);
+      continue;
+    }
+
+    for (i = 0; i < num_names; i++) {
+      if (strcmp(token, names[i]) == 0) {
+        break;
+      }
+    }
+
+    if (i == num_names) {
+      return 0;
+    }
+
+    values[(*count)++] = i;
+  }
+
+  return *count > 0;
+}
+
+static int
+parse_shape(const char* text, struct minst_format* format)
+{
+  const char* cursor;
+  char* end;
+
+  format->rank = 1;
+
+  for (cursor = text; format->rank < MINST_MAX_RANK; cursor = end + 1) {
+
+    format->shape[format->rank] = (uint32_t)strtoul(cursor, &end, 10);
+    if ((end == cursor) || (format->shape[format->rank] == 0)) {
+      return 0;
+    }
+
+    format->rank++;
+
+    if (*end == '\0') {
+      return 1;
+    }
+
+    if (*end != 'x') {
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+/* Joins a directory and a file name, failing instead of truncating the path. */
+static int
+make_path(char* path, const size_t size, const char* dir, const char* name)
+{
+  const int length = snprintf(path, size, "%s/%s", dir, name);
+
+  return (length >= 0) && (((size_t)length) < size);
+}
+
+/* Writes an IDX file with a big-endian header and a payload filled with a repeating pattern. */
+static int
+write_idx(const char* path, const struct minst_format* format, const uint32_t type_size)
+{
+  unsigned char header[4 + (4 * MINST_MAX_RANK)];
+  unsigned char block[65536];
+  uint64_t remaining;
+  uint64_t bits;
+  uint32_t bits32;
+  uint32_t value;
+  uint32_t b;
+  double f64;
+  float f32;
+  size_t size;
+  size_t i;
+  uint8_t r;
+  FILE* file;
+  int ok;
+
+  file = fopen(path, "wb");
+  if (file == NULL) {
+    return 0;
+  }
+
+  header[0] = 0;
+  header[1] = 0;
+  header[2] = type_codes[format->type];
+  header[3] = format->rank;
+
+  remaining = type_size;
+
+  for (r = 0; r < format->rank; r++) {
+    header[4 + (4 * r)] = (unsigned char)(format->shape[r] >> 24);
+    header[5 + (4 * r)] = (unsigned char)(format->shape[r] >> 16);
+    header[6 + (4 * r)] = (unsigned char)(format->shape[r] >> 8);
+    header[7 + (4 * r)] = (unsigned char)format->shape[r];
+    remaining *= format->shape[r];
+  }
+
+  /* small values keep every type valid, including labels of ten classes. They are encoded as big-endian values of the
+   * type, so that the floating point types hold normal numbers instead of subnormals that would slow down converting */
+  for (i = 0; i < sizeof(block); i += type_size) {
+
+    value = (uint32_t)((i / type_size) % 10);
+
+    if (format->type == MINST_TYPE_F32) {
+      f32 = (float)value;
+      memcpy(&bits32, &f32, sizeof(f32));
+      bits = bits32;
+    } else if (format->type == MINST_TYPE_F64) {
+      f64 = (double)value;
+      memcpy(&bits, &f64, sizeof(f64));
+    } else {
+      bits = value;
+    }
+
+    for (b = 0; b < type_size; b++) {
+      block[i + b] = (unsigned char)(bits >> (8 * (type_size - 1 - b)));
+    }
+  }
+
+  ok = fwrite(header, 1, 4 + (4 * (size_t)format->rank), file) == (4 + (4 * (size_t)format->rank));
+
+  while (ok && (remaining > 0)) {
+    /* keep whole elements in each block, so that the pattern stays aligned to the type */
+    size = (remaining < sizeof(block)) ? (size_t)remaining : sizeof(block) - (sizeof(block) % type_size);
+    ok = fwrite(block, 1, size, file) == size;
+    remaining -= size;
+  }
+
+  return (fclose(file) == 0) && ok;
+}
+
+static int
+compare_double(const void* a, const void* b)
+{
+  const double x = *(const double*)a;
+  const double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static enum minst_error
+run(const char* samples_path,
+    const char* labels_path,
+    const struct minst_format* sample_format,
+    const struct minst_format* label_format,
+    const uint32_t batch_size,
+    const uint32_t num_epochs,
+    const struct minst_options* options,
+    struct result* result)
+{
+  struct minst_dataset* dataset;
+  struct minst_batch batch;
+  enum minst_error err;
+  double* latencies;
+  size_t num_latencies;
+  size_t capacity;
+  uint64_t element_bytes;
+  uint32_t epoch;
+  double start;
+  double t;
+
+  err = minst_dataset_open(
+    &dataset, samples_path, labels_path, sample_format, label_format, batch_size, NULL, NULL, options);
+  if (err != MINST_ERR_NONE) {
+    return err;
+  }
+
+  capacity = (size_t)minst_dataset_num_batches(dataset) * num_epochs;
+
+  latencies = malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+  if (latencies == NULL) {
+    minst_dataset_close(dataset);
+    return MINST_ERR_OUT_OF_MEMORY;
+  }
+
+  element_bytes = ((uint64_t)sample_format->shape[1]) * sample_format->shape[2] * sample_format->shape[3] *
+                  type_sizes[sample_format->type];
+  element_bytes += type_sizes[label_format->type];
+
+  memset(result, 0, sizeof(*result));
+
+  num_latencies = 0;
+  start = now();
+
+  /* the first epoch warms up the page cache and the worker threads and is not measured */
+  for (epoch = 0; (epoch <= num_epochs) && (err == MINST_ERR_NONE); epoch++) {
+
+    if (epoch == 1) {
+      start = now();
+    }
+
+    for (;;) {
+
+      t = now();
+
+      err = minst_dataset_next_batch(dataset, &batch);
+      if ((err != MINST_ERR_NONE) || (batch.size == 0)) {
+        break;
+      }
+
+      if ((epoch > 0) && (num_latencies < capacity)) {
+        latencies[num_latencies++] = now() - t;
+        result->num_samples += batch.size;
+      }
+    }
+
+    if (err == MINST_ERR_NONE) {
+      err = minst_dataset_next_epoch(dataset);
+    }
+  }
+
+  if ((err == MINST_ERR_NONE) && (num_latencies > 0)) {
+    result->seconds = now() - start;
+    result->num_bytes = result->num_samples * element_bytes;
+    qsort(latencies, num_latencies, sizeof(double), compare_double);
+    result->p50 = latencies[(num_latencies - 1) / 2];
+    result->p99 = latencies[((num_latencies - 1) * 99) / 100];
+  }
+
+  free(latencies);
+
+  minst_dataset_close(dataset);
+
+  return err;
+}
+
+int
+main(int argc, char** argv)
+{
+  struct minst_options options;
+  struct minst_format sample_format;
+  struct minst_format label_format;
+  struct sweep sweep;
+  struct result result;
+  const char* dir;
+  char samples_path[1024];
+  char labels_path[1024];
+  uint32_t num_elements;
+  uint32_t num_epochs;
+  uint32_t prefetch_depth;
+  uint32_t type;
+  uint32_t count;
+  uint32_t m;
+  uint32_t b;
+  uint32_t n;
+  uint32_t s;
+  int json;
+  int ok;
+  int i;
+  enum minst_error err;
+  enum minst_output sample_output;
+
+  memset(&sample_format, 0, sizeof(sample_format));
+  memset(&label_format, 0, sizeof(label_format));
+
+  num_elements = 60000;
+  num_epochs = 1;
+  prefetch_depth = 0;
+  sample_output = MINST_OUTPUT_RAW;
+  type = MINST_TYPE_U8;
+  dir = ".";
+  json = 0;
+  ok = parse_shape("28x28", &sample_format);
+
+  sweep.io_modes[0] = MINST_IO_STDIO;
+  sweep.io_modes[1] = MINST_IO_MMAP;
+  sweep.io_modes[2] = MINST_IO_PRELOAD;
+  sweep.num_io_modes = 3;
+  sweep.batch_sizes[0] = 1;
+  sweep.batch_sizes[1] = 32;
+  sweep.batch_sizes[2] = 256;
+  sweep.num_batch_sizes = 3;
+  sweep.thread_counts[0] = 1;
+  sweep.thread_counts[1] = 4;
+  sweep.num_thread_counts = 2;
+  sweep.shuffles[0] = 0;
+  sweep.shuffles[1] = 1;
+  sweep.num_shuffles = 2;
+
+  for (i = 1; (i < argc) && ok; i++) {
+    if ((strcmp(argv[i], "--elements") == 0) && ((i + 1) < argc)) {
+      num_elements = (uint32_t)strtoul(argv[++i], NULL, 10);
+      ok = num_elements > 0;
+    } else if ((strcmp(argv[i], "--shape") == 0) && ((i + 1) < argc)) {
+      ok = parse_shape(argv[++i], &sample_format);
+    } else if ((strcmp(argv[i], "--type") == 0) && ((i + 1) < argc)) {
+      ok = parse_list(argv[++i], type_names, 6, &type, &count) && (count == 1);
+    } else if ((strcmp(argv[i], "--io") == 0) && ((i + 1) < argc)) {
+      ok = parse_list(argv[++i], io_mode_names, 3, sweep.io_modes, &sweep.num_io_modes);
+    } else if ((strcmp(argv[i], "--batch-sizes") == 0) && ((i + 1) < argc)) {
+      ok = parse_list(argv[++i], NULL, 0, sweep.batch_sizes, &sweep.num_batch_sizes);
+    } else if ((strcmp(argv[i], "--threads") == 0) && ((i + 1) < argc)) {
+      ok = parse_list(argv[++i], NULL, 0, sweep.thread_counts, &sweep.num_thread_counts);
+    } else if ((strcmp(argv[i], "--shuffle") == 0) && ((i + 1) < argc)) {
+      ok = parse_list(argv[++i], NULL, 0, sweep.shuffles, &sweep.num_shuffles);
+    } else if ((strcmp(argv[i], "--prefetch") == 0) && ((i + 1) < argc)) {
+      prefetch_depth = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--f32") == 0) {
+      sample_output = MINST_OUTPUT_F32;
+    } else if ((strcmp(argv[i], "--epochs") == 0) && ((i + 1) < argc)) {
+      num_epochs = (uint32_t)strtoul(argv[++i], NULL, 10);
+      ok = num_epochs > 0;
+    } else if ((strcmp(argv[i], "--dir") == 0) && ((i + 1) < argc)) {
+      dir = argv[++i];
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else {
+      ok = 0;
+    }
+  }
+
+  if (!ok) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  sample_format.type = (enum minst_type)type;
+  sample_format.shape[0] = num_elements;
+  for (i = sample_format.rank; i < MINST_MAX_RANK; i++) {
+    sample_format.shape[i] = 1;
+  }
+
+  label_format.type = MINST_TYPE_U8;
+  label_format.rank = 1;
+  label_format.shape[0] = num_elements;
+  label_format.shape[1] = 1;
+  label_format.shape[2] = 1;
+  label_format.shape[3] = 1;
+
+  if (!make_path(samples_path, sizeof(samples_path), dir, "minst_bench_samples.idx") ||
+      !make_path(labels_path, sizeof(labels_path), dir, "minst_bench_labels.idx")) {
+    fprintf(stderr, "the directory path is too long: %s\n", dir);
+    return EXIT_FAILURE;
+  }
+
+  if (!write_idx(samples_path, &sample_format, type_sizes[type]) || !write_idx(labels_path, &label_format, 1)) {
+    fprintf(stderr, "failed to write the synthetic dataset to %s\n", dir);
+    return EXIT_FAILURE;
+  }
+
+  if (!json) {
+    printf("io_mode,type,elements,batch_size,threads,shuffle,samples_per_sec,mb_per_sec,p50_ms,p99_ms\n");
+  }
+
+  err = MINST_ERR_NONE;
+
+  for (m = 0; (m < sweep.num_io_modes) && (err == MINST_ERR_NONE); m++) {
+    for (b = 0; (b < sweep.num_batch_sizes) && (err == MINST_ERR_NONE); b++) {
+      for (n = 0; (n < sweep.num_thread_counts) && (err == MINST_ERR_NONE); n++) {
+        for (s = 0; (s < sweep.num_shuffles) && (err == MINST_ERR_NONE); s++) {
+
+          minst_options_init(&options);
+          options.io_mode = (enum minst_io_mode)sweep.io_modes[m];
+          options.num_threads = sweep.thread_counts[n];
+          options.shuffle = (int)sweep.shuffles[s];
+          options.prefetch_depth = prefetch_depth;
+          options.sample_output = sample_output;
+
+          err = run(samples_path,
+                    labels_path,
+                    &sample_format,
+                    &label_format,
+                    sweep.batch_sizes[b],
+                    num_epochs,
+                    &options,
+                    &result);
+          if (err != MINST_ERR_NONE) {
+            break;
+          }
+
+          printf(json ? "{\"io_mode\": \"%s\", \"type\": \"%s\", \"elements\": %lu, \"batch_size\": %lu, "
+                        "\"threads\": %lu, \"shuffle\": %d, \"samples_per_sec\": %.1f, \"mb_per_sec\": %.2f, "
+                        "\"p50_ms\": %.4f, \"p99_ms\": %.4f}\n"
+                      : "%s,%s,%lu,%lu,%lu,%d,%.1f,%.2f,%.4f,%.4f\n",
+                 io_mode_names[sweep.io_modes[m]],
+                 type_names[type],
+                 (unsigned long)num_elements,
+                 (unsigned long)sweep.batch_sizes[b],
+                 (unsigned long)sweep.thread_counts[n],
+                 options.shuffle,
+                 ((double)result.num_samples) / result.seconds,
+                 ((double)result.num_bytes) / (result.seconds * 1.0e6),
+                 result.p50 * 1.0e3,
+                 result.p99 * 1.0e3);
+
+          fflush(stdout);
+        }
+      }
+    }
+  }
+
+  remove(samples_path);
+  remove(labels_path);
+
+  if (err != MINST_ERR_NONE) {
+    fprintf(stderr, "failure: %s\n", minst_strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  return 0;
+}
@@ -0,0 +1,90 @@
+#include "minst.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void
+print_usage(const char* program)
+{
+  fprintf(stderr,
+          "usage: %s [options] <cache> <samples> <labels>\n"
+          "\n"
+          "Builds a packed cache file from a pair of dataset files.\n"
+          "\n"
+          "options:\n"
+          "  --f32            Convert the samples to normalized 32-bit floats.\n"
+          "  --native         Convert the samples to native byte order.\n"
+          "  --scale <value>  The scale applied to the samples before normalizing them.\n"
+          "  --mean <value>   The mean subtracted from the scaled samples.\n"
+          "  --std <value>    The standard deviation the scaled samples are divided by.\n"
+          "  --label-f32      Convert the labels to 32-bit floats.\n"
+          "  --label-native   Convert the labels to native byte order.\n",
+          program);
+}
+
+int
+main(int argc, char** argv)
+{
+  struct minst_options options;
+  struct minst_format sample_format;
+  struct minst_format label_format;
+  const char* paths[3];
+  int num_paths;
+  int i;
+  enum minst_error err;
+
+  minst_options_init(&options);
+
+  num_paths = 0;
+
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--f32") == 0) {
+      options.sample_output = MINST_OUTPUT_F32;
+    } else if (strcmp(argv[i], "--native") == 0) {
+      options.sample_output = MINST_OUTPUT_NATIVE;
+    } else if ((strcmp(argv[i], "--scale") == 0) && ((i + 1) < argc)) {
+      options.sample_scale = (float)atof(argv[++i]);
+    } else if ((strcmp(argv[i], "--mean") == 0) && ((i + 1) < argc)) {
+      options.sample_mean = (float)atof(argv[++i]);
+    } else if ((strcmp(argv[i], "--std") == 0) && ((i + 1) < argc)) {
+      options.sample_std = (float)atof(argv[++i]);
+    } else if (strcmp(argv[i], "--label-f32") == 0) {
+      options.label_output = MINST_OUTPUT_F32;
+    } else if (strcmp(argv[i], "--label-native") == 0) {
+      options.label_output = MINST_OUTPUT_NATIVE;
+    } else if ((argv[i][0] != '-') && (num_paths < 3)) {
+      paths[num_paths++] = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (num_paths != 3) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  err = minst_read_format(paths[1], &sample_format);
+  if (err != MINST_ERR_NONE) {
+    fprintf(stderr, "%s: %s\n", paths[1], minst_strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  err = minst_read_format(paths[2], &label_format);
+  if (err != MINST_ERR_NONE) {
+    fprintf(stderr, "%s: %s\n", paths[2], minst_strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  err = minst_cache_build(paths[0], paths[1], paths[2], &sample_format, &label_format, &options);
+  if (err != MINST_ERR_NONE) {
+    fprintf(stderr, "failure: %s\n", minst_strerror(err));
+    return EXIT_FAILURE;
+  }
+
+  printf("wrote %s (%lu elements)\n", paths[0], (unsigned long)sample_format.shape[0]);
+
+  return 0;
+}